@@ -1,25 +1,118 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
+from esphome import automation
 from esphome.components import ble_client
-from esphome.const import CONF_ID
+from esphome.components.esp32 import add_idf_sdkconfig_option
+from esphome.const import CONF_ID, CONF_MODE, CONF_INTERVAL, CONF_SPEED
+from esphome.core import CORE
 
 AUTO_LOAD = ["light", "button", "text_sensor", "sensor", "binary_sensor"]
 
 sphero_bb8_ns = cg.esphome_ns.namespace("sphero_bb8")
 SpheroBB8 = sphero_bb8_ns.class_("SpheroBB8", cg.Component, ble_client.BLEClientNode)
+DriveAction = sphero_bb8_ns.class_("DriveAction", automation.Action)
+StopAction = sphero_bb8_ns.class_("StopAction", automation.Action)
+ConfigureCollisionAction = sphero_bb8_ns.class_("ConfigureCollisionAction", automation.Action)
+ResetOdometryAction = sphero_bb8_ns.class_("ResetOdometryAction", automation.Action)
+
+PacingMode = sphero_bb8_ns.enum("PacingMode")
+PACING_MODES = {
+    "FIXED": PacingMode.PACING_MODE_FIXED,
+    "ADAPTIVE": PacingMode.PACING_MODE_ADAPTIVE,
+}
 
 CONF_SPHERO_BB8_ID = "sphero_bb8_id"
 CONF_AUTO_CONNECT = "auto_connect"
+CONF_PACING = "pacing"
+CONF_MIN_INTERVAL = "min_interval"
+CONF_MAX_INTERVAL = "max_interval"
+CONF_BURST = "burst"
+CONF_TARGET_RTT = "target_rtt"
+CONF_MIN_RSSI = "min_rssi"
+CONF_PROBE_INTERVAL = "probe_interval"
+CONF_METRICS_INTERVAL = "metrics_interval"
+CONF_DRIVE_DEADMAN = "drive_deadman"
+CONF_AIRTIME_INTERVAL = "airtime_interval"
+CONF_CACHE_SERVICES = "cache_services"
+CONF_BATCHING = "batching"
+CONF_INACTIVITY_TIMEOUT = "inactivity_timeout"
+CONF_LIVENESS_INTERVAL = "liveness_interval"
+CONF_HEADING = "heading"
+CONF_COLLISION = "collision"
+CONF_X_THRESHOLD = "x_threshold"
+CONF_X_SPEED = "x_speed"
+CONF_Y_THRESHOLD = "y_threshold"
+CONF_Y_SPEED = "y_speed"
+CONF_DEAD_TIME = "dead_time"
+CONF_PUBLISH_INTERVAL = "publish_interval"
+
+PACING_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_MODE, default="FIXED"): cv.enum(PACING_MODES, upper=True),
+        cv.Optional(CONF_INTERVAL, default="50ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_MIN_INTERVAL, default="20ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_MAX_INTERVAL, default="200ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_BURST, default=3): cv.int_range(min=1, max=10),
+        cv.Optional(CONF_TARGET_RTT, default="150ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_MIN_RSSI, default=-85): cv.int_range(min=-127, max=0),
+        cv.Optional(CONF_PROBE_INTERVAL, default="5s"): cv.positive_time_period_milliseconds,
+    }
+)
+# Config Collision sends the dead time in 10ms units
+DEAD_TIME = cv.All(
+    cv.positive_time_period_milliseconds,
+    cv.Range(max=cv.TimePeriod(milliseconds=2550)),
+)
+
+COLLISION_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_X_THRESHOLD, default=100): cv.uint8_t,
+        cv.Optional(CONF_X_SPEED, default=100): cv.uint8_t,
+        cv.Optional(CONF_Y_THRESHOLD, default=100): cv.uint8_t,
+        cv.Optional(CONF_Y_SPEED, default=100): cv.uint8_t,
+        cv.Optional(CONF_DEAD_TIME, default="500ms"): DEAD_TIME,
+        cv.Optional(CONF_PUBLISH_INTERVAL, default="250ms"): cv.positive_time_period_milliseconds,
+    }
+)
+
+
+def validate_liveness_interval(config):
+    # Every ping restarts the droid's inactivity timer, so it has to arrive before the timer runs out
+    if config[CONF_LIVENESS_INTERVAL].total_milliseconds >= config[CONF_INACTIVITY_TIMEOUT].total_milliseconds:
+        raise cv.Invalid(f"{CONF_LIVENESS_INTERVAL} must be shorter than {CONF_INACTIVITY_TIMEOUT}")
+    return config
 
-CONFIG_SCHEMA = (
+
+def validate_cache_services(config):
+    # The flash GATT cache is an ESP-IDF Bluetooth option; Arduino builds use a prebuilt stack
+    if config[CONF_CACHE_SERVICES] and not CORE.using_esp_idf:
+        raise cv.Invalid(f"{CONF_CACHE_SERVICES} requires the esp-idf framework", path=[CONF_CACHE_SERVICES])
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(SpheroBB8),
             cv.Optional(CONF_AUTO_CONNECT, default=False): cv.boolean,
+            cv.Optional(CONF_PACING, default={}): PACING_SCHEMA,
+            cv.Optional(CONF_METRICS_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_DRIVE_DEADMAN, default="1s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_AIRTIME_INTERVAL, default="10ms"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_CACHE_SERVICES, default=False): cv.boolean,
+            cv.Optional(CONF_BATCHING, default=True): cv.boolean,
+            cv.Optional(CONF_INACTIVITY_TIMEOUT, default="600s"): cv.All(
+                cv.positive_time_period_seconds,
+                cv.Range(min=cv.TimePeriod(seconds=60), max=cv.TimePeriod(seconds=65535)),
+            ),
+            cv.Optional(CONF_LIVENESS_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_COLLISION, default={}): COLLISION_SCHEMA,
         }
     )
     .extend(ble_client.BLE_CLIENT_SCHEMA)
-    .extend(cv.COMPONENT_SCHEMA)
+    .extend(cv.COMPONENT_SCHEMA),
+    validate_liveness_interval,
+    validate_cache_services,
 )
 
 async def to_code(config):
@@ -27,3 +120,108 @@ async def to_code(config):
     await cg.register_component(var, config)
     await ble_client.register_ble_node(var, config)
     cg.add(var.set_auto_connect(config[CONF_AUTO_CONNECT]))
+    cg.add(var.set_metrics_interval(config[CONF_METRICS_INTERVAL]))
+    cg.add(var.set_drive_deadman(config[CONF_DRIVE_DEADMAN]))
+    cg.add(var.set_airtime_interval(config[CONF_AIRTIME_INTERVAL]))
+    cg.add(var.set_batching(config[CONF_BATCHING]))
+    cg.add(var.set_inactivity_timeout(config[CONF_INACTIVITY_TIMEOUT].total_seconds))
+    cg.add(var.set_liveness_interval(config[CONF_LIVENESS_INTERVAL]))
+    cg.add(var.set_cache_services(config[CONF_CACHE_SERVICES]))
+    if config[CONF_CACHE_SERVICES]:
+        # Lets the BLE stack restore the droid's services from flash instead of discovering them over the air
+        add_idf_sdkconfig_option("CONFIG_BT_GATTC_CACHE_NVS_FLASH", True)
+
+    collision = config[CONF_COLLISION]
+    cg.add(
+        var.set_collision_config(
+            collision[CONF_X_THRESHOLD],
+            collision[CONF_X_SPEED],
+            collision[CONF_Y_THRESHOLD],
+            collision[CONF_Y_SPEED],
+            collision[CONF_DEAD_TIME],
+        )
+    )
+    cg.add(var.set_collision_publish_interval(collision[CONF_PUBLISH_INTERVAL]))
+
+    pacing = config[CONF_PACING]
+    cg.add(var.set_pacing_mode(pacing[CONF_MODE]))
+    cg.add(var.set_pacing_interval(pacing[CONF_INTERVAL]))
+    cg.add(var.set_pacing_min_interval(pacing[CONF_MIN_INTERVAL]))
+    cg.add(var.set_pacing_max_interval(pacing[CONF_MAX_INTERVAL]))
+    cg.add(var.set_pacing_burst(pacing[CONF_BURST]))
+    cg.add(var.set_pacing_target_rtt(pacing[CONF_TARGET_RTT]))
+    cg.add(var.set_pacing_min_rssi(pacing[CONF_MIN_RSSI]))
+    cg.add(var.set_probe_interval(pacing[CONF_PROBE_INTERVAL]))
+
+
+@automation.register_action(
+    "sphero_bb8.drive",
+    DriveAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(SpheroBB8),
+            cv.Required(CONF_SPEED): cv.templatable(cv.int_range(min=0, max=255)),
+            cv.Required(CONF_HEADING): cv.templatable(cv.int_range(min=0, max=359)),
+        }
+    ),
+)
+async def drive_action_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    speed = await cg.templatable(config[CONF_SPEED], args, cg.uint8)
+    cg.add(var.set_speed(speed))
+    heading = await cg.templatable(config[CONF_HEADING], args, cg.uint16)
+    cg.add(var.set_heading(heading))
+    return var
+
+
+@automation.register_action(
+    "sphero_bb8.stop",
+    StopAction,
+    cv.Schema({cv.GenerateID(): cv.use_id(SpheroBB8)}),
+)
+async def stop_action_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+@automation.register_action(
+    "sphero_bb8.reset_odometry",
+    ResetOdometryAction,
+    cv.Schema({cv.GenerateID(): cv.use_id(SpheroBB8)}),
+)
+async def reset_odometry_action_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+@automation.register_action(
+    "sphero_bb8.configure_collision",
+    ConfigureCollisionAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(SpheroBB8),
+            cv.Optional(CONF_X_THRESHOLD): cv.templatable(cv.uint8_t),
+            cv.Optional(CONF_X_SPEED): cv.templatable(cv.uint8_t),
+            cv.Optional(CONF_Y_THRESHOLD): cv.templatable(cv.uint8_t),
+            cv.Optional(CONF_Y_SPEED): cv.templatable(cv.uint8_t),
+            cv.Optional(CONF_DEAD_TIME): cv.templatable(DEAD_TIME),
+        }
+    ),
+)
+async def configure_collision_action_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    for key, setter, type_ in (
+        (CONF_X_THRESHOLD, var.set_x_threshold, cg.uint8),
+        (CONF_X_SPEED, var.set_x_speed, cg.uint8),
+        (CONF_Y_THRESHOLD, var.set_y_threshold, cg.uint8),
+        (CONF_Y_SPEED, var.set_y_speed, cg.uint8),
+        (CONF_DEAD_TIME, var.set_dead_time, cg.uint32),
+    ):
+        if key in config:
+            value = await cg.templatable(config[key], args, type_)
+            cg.add(setter(value))
+    return var
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "esphome/core/automation.h"
+#include "sphero_bb8.h"
+
+namespace esphome {
+namespace sphero_bb8 {
+
+template<typename... Ts> class DriveAction : public Action<Ts...>, public Parented<SpheroBB8> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, speed)
+  TEMPLATABLE_VALUE(uint16_t, heading)
+
+  void play(Ts... x) override { this->parent_->drive(this->speed_.value(x...), this->heading_.value(x...)); }
+};
+
+template<typename... Ts> class StopAction : public Action<Ts...>, public Parented<SpheroBB8> {
+ public:
+  void play(Ts... x) override { this->parent_->stop(); }
+};
+
+template<typename... Ts> class ResetOdometryAction : public Action<Ts...>, public Parented<SpheroBB8> {
+ public:
+  void play(Ts... x) override { this->parent_->reset_odometry(); }
+};
+
+template<typename... Ts> class ConfigureCollisionAction : public Action<Ts...>, public Parented<SpheroBB8> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, x_threshold)
+  TEMPLATABLE_VALUE(uint8_t, x_speed)
+  TEMPLATABLE_VALUE(uint8_t, y_threshold)
+  TEMPLATABLE_VALUE(uint8_t, y_speed)
+  TEMPLATABLE_VALUE(uint32_t, dead_time)
+
+  void play(Ts... x) override {
+    // Options left out keep their current value
+    const CollisionConfig &config = this->parent_->get_collision_config();
+    this->parent_->set_collision_config(
+        this->x_threshold_.has_value() ? this->x_threshold_.value(x...) : config.x_threshold,
+        this->x_speed_.has_value() ? this->x_speed_.value(x...) : config.x_speed,
+        this->y_threshold_.has_value() ? this->y_threshold_.value(x...) : config.y_threshold,
+        this->y_speed_.has_value() ? this->y_speed_.value(x...) : config.y_speed,
+        this->dead_time_.has_value() ? this->dead_time_.value(x...) : config.dead_time * 10u);
+  }
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
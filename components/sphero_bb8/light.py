@@ -1,20 +1,44 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import light
-from esphome.const import CONF_OUTPUT_ID, CONF_ID, CONF_TYPE
+from esphome.components.light.effects import register_monochromatic_effect
+from esphome.const import (
+    CONF_OUTPUT_ID,
+    CONF_ID,
+    CONF_TYPE,
+    CONF_NAME,
+    CONF_RED,
+    CONF_GREEN,
+    CONF_BLUE,
+    CONF_BRIGHTNESS,
+    CONF_DURATION,
+    CONF_DELAY,
+    CONF_COUNT,
+    CONF_REPEAT,
+)
+from esphome.core import TimePeriod
 from . import sphero_bb8_ns, SpheroBB8
 
 DEPENDENCIES = ["sphero_bb8"]
 
 SpheroBB8Light = sphero_bb8_ns.class_("SpheroBB8Light", light.LightOutput, cg.Component)
+SpheroBB8MacroEffect = sphero_bb8_ns.class_("SpheroBB8MacroEffect", light.LightEffect)
+
+LightType = sphero_bb8_ns.enum("LightType")
+LIGHT_TYPES = {
+    "RGB": LightType.LIGHT_TYPE_RGB,
+    "TAILLIGHT": LightType.LIGHT_TYPE_TAILLIGHT,
+}
 
 CONF_SPHERO_BB8_ID = "sphero_bb8_id"
+CONF_MIN_DELTA = "min_delta"
 
 CONFIG_SCHEMA = light.RGB_LIGHT_SCHEMA.extend(
     {
         cv.GenerateID(CONF_OUTPUT_ID): cv.declare_id(SpheroBB8Light),
         cv.GenerateID(CONF_SPHERO_BB8_ID): cv.use_id(SpheroBB8),
-        cv.Required(CONF_TYPE): cv.one_of("RGB", "TAILLIGHT", upper=True),
+        cv.Required(CONF_TYPE): cv.enum(LIGHT_TYPES, upper=True),
+        cv.Optional(CONF_MIN_DELTA, default=3): cv.int_range(min=0, max=255),
         cv.Optional(light.CONF_DEFAULT_TRANSITION_LENGTH, default="1s"): cv.positive_time_period_milliseconds,
     }
 ).extend(cv.COMPONENT_SCHEMA)
@@ -26,5 +50,199 @@ async def to_code(config):
     parent = await cg.get_variable(config[CONF_SPHERO_BB8_ID])
     cg.add(var.set_parent(parent))
     cg.add(var.set_type(config[CONF_TYPE]))
+    cg.add(var.set_min_delta(config[CONF_MIN_DELTA]))
     
     await light.register_light(var, config)
+
+
+# Sphero macro commands
+MACRO_END = 0x00
+MACRO_SET_RGB = 0x07
+MACRO_SET_BACK_LED = 0x09
+MACRO_DELAY = 0x0B
+MACRO_FADE = 0x14
+MACRO_LOOP_START = 0x1E
+MACRO_LOOP_END = 0x1F
+
+TEMP_MACRO_ID = 0xFF
+# Save Temporary Macro payload limit, see MAX_PAYLOAD_SIZE in sphero_bb8_protocol.h
+MAX_MACRO_SIZE = 96
+# Set RGB and Set Back LED carry an 8-bit post-command delay
+MAX_POST_DELAY = 255
+
+CONF_STEPS = "steps"
+CONF_RGB = "rgb"
+CONF_FADE = "fade"
+CONF_BACK_LED = "back_led"
+CONF_LOOP = "loop"
+
+macro_time = cv.All(
+    cv.positive_time_period_milliseconds,
+    cv.Range(max=TimePeriod(milliseconds=65535)),
+)
+
+COLOR_SCHEMA = {
+    cv.Optional(CONF_RED, default="0%"): cv.percentage,
+    cv.Optional(CONF_GREEN, default="0%"): cv.percentage,
+    cv.Optional(CONF_BLUE, default="0%"): cv.percentage,
+}
+
+RGB_STEP_SCHEMA = cv.Schema(
+    {
+        **COLOR_SCHEMA,
+        cv.Optional(CONF_DELAY, default="0ms"): macro_time,
+    }
+)
+
+FADE_STEP_SCHEMA = cv.Schema(
+    {
+        **COLOR_SCHEMA,
+        cv.Required(CONF_DURATION): macro_time,
+    }
+)
+
+BACK_LED_STEP_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_BRIGHTNESS): cv.percentage,
+        cv.Optional(CONF_DELAY, default="0ms"): macro_time,
+    }
+)
+
+LED_STEPS = {
+    cv.Optional(CONF_RGB): RGB_STEP_SCHEMA,
+    cv.Optional(CONF_FADE): FADE_STEP_SCHEMA,
+    cv.Optional(CONF_BACK_LED): BACK_LED_STEP_SCHEMA,
+    cv.Optional(CONF_DELAY): macro_time,
+}
+
+LED_STEP_SCHEMA = cv.All(
+    cv.Schema(LED_STEPS),
+    cv.has_exactly_one_key(CONF_RGB, CONF_FADE, CONF_BACK_LED, CONF_DELAY),
+)
+
+# Loops are not nested, the whole sequence may already run inside one for `repeat`
+LOOP_STEP_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_COUNT): cv.int_range(min=1, max=255),
+        cv.Required(CONF_STEPS): cv.ensure_list(LED_STEP_SCHEMA),
+    }
+)
+
+MACRO_STEP_SCHEMA = cv.All(
+    cv.Schema({**LED_STEPS, cv.Optional(CONF_LOOP): LOOP_STEP_SCHEMA}),
+    cv.has_exactly_one_key(CONF_RGB, CONF_FADE, CONF_BACK_LED, CONF_DELAY, CONF_LOOP),
+)
+
+
+def validate_repeat(value):
+    if isinstance(value, str) and value.lower() == "forever":
+        return 0
+    return cv.int_range(min=1, max=255)(value)
+
+
+def to_byte(percentage):
+    return int(round(percentage * 255))
+
+
+def compile_delay(ms):
+    if ms == 0:
+        return []
+    return [MACRO_DELAY, ms >> 8, ms & 0xFF]
+
+
+def compile_post_delay(ms):
+    """Returns the post-command delay byte and any Delay command needed for the rest."""
+    if ms <= MAX_POST_DELAY:
+        return ms, []
+    return 0, compile_delay(ms)
+
+
+def compile_steps(steps):
+    """Compiles macro steps to bytes, returning them with their run time in milliseconds."""
+    data = []
+    duration = 0
+    for step in steps:
+        if CONF_RGB in step:
+            conf = step[CONF_RGB]
+            ms = conf[CONF_DELAY].total_milliseconds
+            pcd, extra = compile_post_delay(ms)
+            data += [MACRO_SET_RGB, to_byte(conf[CONF_RED]), to_byte(conf[CONF_GREEN]), to_byte(conf[CONF_BLUE]), pcd]
+            data += extra
+            duration += ms
+        elif CONF_FADE in step:
+            conf = step[CONF_FADE]
+            ms = conf[CONF_DURATION].total_milliseconds
+            data += [MACRO_FADE, to_byte(conf[CONF_RED]), to_byte(conf[CONF_GREEN]), to_byte(conf[CONF_BLUE])]
+            data += [ms >> 8, ms & 0xFF]
+            duration += ms
+        elif CONF_BACK_LED in step:
+            conf = step[CONF_BACK_LED]
+            ms = conf[CONF_DELAY].total_milliseconds
+            pcd, extra = compile_post_delay(ms)
+            data += [MACRO_SET_BACK_LED, to_byte(conf[CONF_BRIGHTNESS]), pcd]
+            data += extra
+            duration += ms
+        elif CONF_DELAY in step:
+            ms = step[CONF_DELAY].total_milliseconds
+            data += compile_delay(ms)
+            duration += ms
+        elif CONF_LOOP in step:
+            conf = step[CONF_LOOP]
+            inner, inner_duration = compile_steps(conf[CONF_STEPS])
+            data += [MACRO_LOOP_START, conf[CONF_COUNT]] + inner + [MACRO_LOOP_END]
+            duration += conf[CONF_COUNT] * inner_duration
+    return data, duration
+
+
+def compile_macro(config):
+    """Compiles the effect into a Save Temporary Macro payload, its run time and how many times
+    the effect starts it (0 for forever)."""
+    steps = config[CONF_STEPS]
+    data, duration = compile_steps(steps)
+    repeat = config[CONF_REPEAT]
+    if any(CONF_LOOP in step for step in steps):
+        # Loops do not nest on the droid, so the effect starts the macro once per pass
+        return [TEMP_MACRO_ID, 0x00] + data + [MACRO_END], duration, repeat
+    # Repeat with a loop on the droid; `forever` restarts it after 255 passes
+    count = repeat or 255
+    if count > 1:
+        data = [MACRO_LOOP_START, count] + data + [MACRO_LOOP_END]
+        duration *= count
+    return [TEMP_MACRO_ID, 0x00] + data + [MACRO_END], duration, 0 if repeat == 0 else 1
+
+
+def validate_steps(steps):
+    _, duration = compile_steps(steps)
+    if duration == 0:
+        raise cv.Invalid("Macro needs at least one delay or fade")
+    return steps
+
+
+def validate_macro_size(config):
+    # Measured on the payload itself, so the repeat loop around the steps is counted when there is one
+    size = len(compile_macro(config)[0])
+    if size > MAX_MACRO_SIZE:
+        raise cv.Invalid(
+            f"Macro compiles to {size} bytes, the limit is {MAX_MACRO_SIZE}; use fewer steps or a loop",
+            path=[CONF_STEPS],
+        )
+    return config
+
+
+@register_monochromatic_effect(
+    "sphero_bb8.macro",
+    SpheroBB8MacroEffect,
+    "Macro",
+    {
+        cv.Optional(CONF_REPEAT, default="forever"): validate_repeat,
+        cv.Required(CONF_STEPS): cv.All(cv.ensure_list(MACRO_STEP_SCHEMA), validate_steps),
+    },
+    validate_macro_size,
+)
+async def macro_effect_to_code(config, effect_id):
+    data, duration, runs = compile_macro(config)
+    var = cg.new_Pvariable(effect_id, config[CONF_NAME])
+    cg.add(var.set_macro(data))
+    cg.add(var.set_duration(duration))
+    cg.add(var.set_runs(runs))
+    return var
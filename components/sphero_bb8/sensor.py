@@ -9,11 +9,118 @@ from esphome.const import (
     STATE_CLASS_MEASUREMENT,
     CONF_ENTITY_CATEGORY,
     ENTITY_CATEGORY_DIAGNOSTIC,
+    UNIT_MILLISECOND,
+    UNIT_DECIBEL_MILLIWATT,
+    DEVICE_CLASS_SIGNAL_STRENGTH,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_BYTES,
+    UNIT_DEGREES,
+    UNIT_DEGREE_PER_SECOND,
+    UNIT_G,
+    UNIT_CENTIMETER,
+    UNIT_MINUTE,
+    DEVICE_CLASS_DURATION,
+    CONF_UPDATE_INTERVAL,
 )
 from . import sphero_bb8_ns, SpheroBB8, CONF_SPHERO_BB8_ID
 
 DEPENDENCIES = ["sphero_bb8"]
 
+MetricSensor = sphero_bb8_ns.enum("MetricSensor")
+
+# Traffic counters: config key -> (metric, unit, icon)
+METRIC_SENSORS = {
+    "packets_sent": (MetricSensor.METRIC_PACKETS_SENT, None, "mdi:upload"),
+    "bytes_sent": (MetricSensor.METRIC_BYTES_SENT, UNIT_BYTES, "mdi:upload"),
+    "notifications_received": (MetricSensor.METRIC_NOTIFICATIONS_RECEIVED, None, "mdi:download"),
+    "bytes_received": (MetricSensor.METRIC_BYTES_RECEIVED, UNIT_BYTES, "mdi:download"),
+    "frames_parsed": (MetricSensor.METRIC_FRAMES_PARSED, None, "mdi:package-variant"),
+    "resync_bytes": (MetricSensor.METRIC_RESYNC_BYTES, UNIT_BYTES, "mdi:sync-alert"),
+    "checksum_failures": (MetricSensor.METRIC_CHECKSUM_FAILURES, None, "mdi:alert-circle-outline"),
+    "write_failures": (MetricSensor.METRIC_WRITE_FAILURES, None, "mdi:alert-circle-outline"),
+    "write_timeouts": (MetricSensor.METRIC_WRITE_TIMEOUTS, None, "mdi:timer-alert-outline"),
+    "keepalive_pings": (MetricSensor.METRIC_KEEPALIVE_PINGS, None, "mdi:heart-pulse"),
+    "led_updates_coalesced": (MetricSensor.METRIC_LED_UPDATES_COALESCED, None, "mdi:merge"),
+    "batched_writes": (MetricSensor.METRIC_BATCHED_WRITES, None, "mdi:package-variant-closed"),
+    "async_unknown": (MetricSensor.METRIC_ASYNC_UNKNOWN, None, "mdi:help-network-outline"),
+    "led_targets_overwritten": (MetricSensor.METRIC_LED_TARGETS_OVERWRITTEN, None, "mdi:layers-remove"),
+}
+
+LatencySensor = sphero_bb8_ns.enum("LatencySensor")
+
+# End-to-end LED latency: config key -> statistic
+LATENCY_SENSORS = {
+    "led_latency_p50": LatencySensor.LATENCY_SENSOR_P50,
+    "led_latency_p95": LatencySensor.LATENCY_SENSOR_P95,
+    "led_latency_max": LatencySensor.LATENCY_SENSOR_MAX,
+}
+
+StreamChannel = sphero_bb8_ns.enum("StreamChannel")
+
+CONF_DATA_STREAM = "data_stream"
+CONF_SAMPLE_RATE = "sample_rate"
+CONF_ODOMETRY = "odometry"
+CONF_MIN_DISTANCE = "min_distance"
+CONF_MIN_HEADING = "min_heading"
+
+# Streamed channels: config key -> (channel, unit, icon, accuracy)
+STREAM_SENSORS = {
+    "pitch": (StreamChannel.STREAM_PITCH, UNIT_DEGREES, "mdi:angle-acute", 0),
+    "roll": (StreamChannel.STREAM_ROLL, UNIT_DEGREES, "mdi:angle-acute", 0),
+    "yaw": (StreamChannel.STREAM_YAW, UNIT_DEGREES, "mdi:compass-outline", 0),
+    "accel_x": (StreamChannel.STREAM_ACCEL_X, UNIT_G, "mdi:axis-x-arrow", 2),
+    "accel_y": (StreamChannel.STREAM_ACCEL_Y, UNIT_G, "mdi:axis-y-arrow", 2),
+    "accel_z": (StreamChannel.STREAM_ACCEL_Z, UNIT_G, "mdi:axis-z-arrow", 2),
+    "gyro_x": (StreamChannel.STREAM_GYRO_X, UNIT_DEGREE_PER_SECOND, "mdi:rotate-orbit", 1),
+    "gyro_y": (StreamChannel.STREAM_GYRO_Y, UNIT_DEGREE_PER_SECOND, "mdi:rotate-orbit", 1),
+    "gyro_z": (StreamChannel.STREAM_GYRO_Z, UNIT_DEGREE_PER_SECOND, "mdi:rotate-orbit", 1),
+    "odometer_x": (StreamChannel.STREAM_ODOMETER_X, UNIT_CENTIMETER, "mdi:map-marker-distance", 0),
+    "odometer_y": (StreamChannel.STREAM_ODOMETER_Y, UNIT_CENTIMETER, "mdi:map-marker-distance", 0),
+    "velocity_x": (StreamChannel.STREAM_VELOCITY_X, "mm/s", "mdi:speedometer", 0),
+    "velocity_y": (StreamChannel.STREAM_VELOCITY_Y, "mm/s", "mdi:speedometer", 0),
+}
+
+# Dead-reckoning pose: config key -> (setter, unit, icon)
+ODOMETRY_SENSORS = {
+    "x": ("set_odometry_x_sensor", UNIT_CENTIMETER, "mdi:axis-x-arrow"),
+    "y": ("set_odometry_y_sensor", UNIT_CENTIMETER, "mdi:axis-y-arrow"),
+    "heading": ("set_odometry_heading_sensor", UNIT_DEGREES, "mdi:compass-outline"),
+    "distance": ("set_odometry_distance_sensor", UNIT_CENTIMETER, "mdi:map-marker-path"),
+}
+
+ODOMETRY_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_MIN_DISTANCE, default=5.0): cv.positive_float,
+        cv.Optional(CONF_MIN_HEADING, default=5.0): cv.float_range(min=0, max=180),
+        **{
+            cv.Optional(key): sensor.sensor_schema(
+                unit_of_measurement=unit,
+                icon=icon,
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_MEASUREMENT,
+            )
+            for key, (_, unit, icon) in ODOMETRY_SENSORS.items()
+        },
+    }
+)
+
+DATA_STREAM_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_SAMPLE_RATE, default=20): cv.int_range(min=1, max=400),
+        cv.Optional(CONF_UPDATE_INTERVAL, default="1s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_ODOMETRY): ODOMETRY_SCHEMA,
+        **{
+            cv.Optional(key): sensor.sensor_schema(
+                unit_of_measurement=unit,
+                icon=icon,
+                accuracy_decimals=accuracy,
+                state_class=STATE_CLASS_MEASUREMENT,
+            )
+            for key, (_, unit, icon, accuracy) in STREAM_SENSORS.items()
+        },
+    }
+)
+
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(CONF_SPHERO_BB8_ID): cv.use_id(SpheroBB8),
@@ -23,6 +130,20 @@ CONFIG_SCHEMA = cv.Schema(
             state_class=STATE_CLASS_MEASUREMENT,
             entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
         ),
+        cv.Optional("battery_discharge_rate"): sensor.sensor_schema(
+            unit_of_measurement="%/h",
+            icon="mdi:battery-arrow-down",
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("battery_time_remaining"): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MINUTE,
+            device_class=DEVICE_CLASS_DURATION,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
         cv.Optional("collision_speed"): sensor.sensor_schema(
             icon="mdi:speedometer",
             state_class=STATE_CLASS_MEASUREMENT,
@@ -31,6 +152,59 @@ CONFIG_SCHEMA = cv.Schema(
             icon="mdi:pulse",
             state_class=STATE_CLASS_MEASUREMENT,
         ),
+        cv.Optional("pacing_interval"): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon="mdi:timer-outline",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("link_rtt"): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon="mdi:timer-sync-outline",
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("handshake_time"): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon="mdi:timer-check-outline",
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("loop_time"): sensor.sensor_schema(
+            unit_of_measurement="µs",
+            icon="mdi:timer-cog-outline",
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("rssi"): sensor.sensor_schema(
+            unit_of_measurement=UNIT_DECIBEL_MILLIWATT,
+            device_class=DEVICE_CLASS_SIGNAL_STRENGTH,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        **{
+            cv.Optional(key): sensor.sensor_schema(
+                unit_of_measurement=unit,
+                icon=icon,
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_TOTAL_INCREASING,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            )
+            for key, (_, unit, icon) in METRIC_SENSORS.items()
+        },
+        **{
+            cv.Optional(key): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLISECOND,
+                icon="mdi:timer-sand",
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            )
+            for key in LATENCY_SENSORS
+        },
+        cv.Optional(CONF_DATA_STREAM): DATA_STREAM_SCHEMA,
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
@@ -40,6 +214,14 @@ async def to_code(config):
     if CONF_BATTERY_LEVEL in config:
         sens = await sensor.new_sensor(config[CONF_BATTERY_LEVEL])
         cg.add(parent.set_battery_sensor(sens))
+
+    if "battery_discharge_rate" in config:
+        sens = await sensor.new_sensor(config["battery_discharge_rate"])
+        cg.add(parent.set_discharge_rate_sensor(sens))
+
+    if "battery_time_remaining" in config:
+        sens = await sensor.new_sensor(config["battery_time_remaining"])
+        cg.add(parent.set_time_remaining_sensor(sens))
         
     if "collision_speed" in config:
         sens = await sensor.new_sensor(config["collision_speed"])
@@ -48,3 +230,50 @@ async def to_code(config):
     if "collision_magnitude" in config:
         sens = await sensor.new_sensor(config["collision_magnitude"])
         cg.add(parent.set_collision_magnitude_sensor(sens))
+
+    if "pacing_interval" in config:
+        sens = await sensor.new_sensor(config["pacing_interval"])
+        cg.add(parent.set_pacing_interval_sensor(sens))
+
+    if "link_rtt" in config:
+        sens = await sensor.new_sensor(config["link_rtt"])
+        cg.add(parent.set_link_rtt_sensor(sens))
+
+    if "handshake_time" in config:
+        sens = await sensor.new_sensor(config["handshake_time"])
+        cg.add(parent.set_handshake_time_sensor(sens))
+
+    if "loop_time" in config:
+        sens = await sensor.new_sensor(config["loop_time"])
+        cg.add(parent.set_loop_time_sensor(sens))
+
+    if "rssi" in config:
+        sens = await sensor.new_sensor(config["rssi"])
+        cg.add(parent.set_rssi_sensor(sens))
+
+    for key, (metric, _, _) in METRIC_SENSORS.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(parent.set_metric_sensor(metric, sens))
+
+    for key, statistic in LATENCY_SENSORS.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(parent.set_latency_sensor(statistic, sens))
+
+    if CONF_DATA_STREAM in config:
+        stream = config[CONF_DATA_STREAM]
+        cg.add(parent.set_stream_sample_rate(stream[CONF_SAMPLE_RATE]))
+        cg.add(parent.set_stream_publish_interval(stream[CONF_UPDATE_INTERVAL]))
+        for key, (channel, _, _, _) in STREAM_SENSORS.items():
+            if key in stream:
+                sens = await sensor.new_sensor(stream[key])
+                cg.add(parent.set_stream_sensor(channel, sens))
+        if CONF_ODOMETRY in stream:
+            odometry = stream[CONF_ODOMETRY]
+            cg.add(parent.set_odometry_min_distance(odometry[CONF_MIN_DISTANCE]))
+            cg.add(parent.set_odometry_min_heading(odometry[CONF_MIN_HEADING]))
+            for key, (setter, _, _) in ODOMETRY_SENSORS.items():
+                if key in odometry:
+                    sens = await sensor.new_sensor(odometry[key])
+                    cg.add(getattr(parent, setter)(sens))
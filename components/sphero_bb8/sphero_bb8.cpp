@@ -1,7 +1,11 @@
 #include "sphero_bb8.h"
 #include "sphero_bb8_light.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace esphome {
 namespace sphero_bb8 {
 
@@ -16,22 +20,103 @@ static const char *const CHAR_WAKE_UUID = "22bb746f-2bbf-7554-2d6f-726568705327"
 static const char *const CHAR_COMMANDS_UUID = "22bb746f-2ba1-7554-2d6f-726568705327";
 static const char *const CHAR_RESPONSES_UUID = "22bb746f-2ba6-7554-2d6f-726568705327";
 
-static const uint8_t DID_CORE = 0x00;
-static const uint8_t DID_SPHERO = 0x02;
-static const uint8_t CID_VERSION = 0x02;
-static const uint8_t CID_GET_POWER_STATE = 0x20;
-static const uint8_t CID_SET_POWER_NOTIFY = 0x21;
-static const uint8_t CID_CONFIG_COLLISION = 0x12;
-static const uint8_t CID_SET_SELF_LEVEL = 0x09;
+struct SpheroUUIDs {
+  espbt::ESPBTUUID ble_service;
+  espbt::ESPBTUUID control_service;
+  espbt::ESPBTUUID anti_dos;
+  espbt::ESPBTUUID tx_power;
+  espbt::ESPBTUUID wake;
+  espbt::ESPBTUUID commands;
+  espbt::ESPBTUUID responses;
+};
+
+// Parsed on first use instead of on every connection
+static const SpheroUUIDs &get_sphero_uuids() {
+  static const SpheroUUIDs UUIDS{
+      espbt::ESPBTUUID::from_raw(SERVICE_BLE_UUID),    espbt::ESPBTUUID::from_raw(SERVICE_CONTROL_UUID),
+      espbt::ESPBTUUID::from_raw(CHAR_ANTI_DOS_UUID),  espbt::ESPBTUUID::from_raw(CHAR_TX_POWER_UUID),
+      espbt::ESPBTUUID::from_raw(CHAR_WAKE_UUID),      espbt::ESPBTUUID::from_raw(CHAR_COMMANDS_UUID),
+      espbt::ESPBTUUID::from_raw(CHAR_RESPONSES_UUID),
+  };
+  return UUIDS;
+}
+
+static const uint16_t DEFAULT_MTU = 23;
+static const size_t ATT_HEADER_SIZE = 3;
+// Ping interval that keeps the droid from sleeping with its default inactivity timeout
+static const uint32_t FAST_KEEPALIVE_INTERVAL = 2000;
+// Resolution of the timers checked while ready (polls, keepalive, request timeouts)
+static const uint32_t HOUSEKEEPING_INTERVAL = 20;
+
+static const char *const LATENCY_STAGE_NAMES[] = {"queued", "written", "acknowledged"};
+
+static const char *const STATUS_NAMES[] = {"Disconnected", "Connecting", "Connected",
+                                           "Initializing", "Ready",      "Disabling"};
+
+static const uint8_t ANTI_DOS_PAYLOAD[] = {'0', '1', '1', 'i', '3'};
+static const uint8_t TX_POWER_PAYLOAD[] = {7};
+static const uint8_t WAKE_PAYLOAD[] = {0x01};
+
+const SpheroBB8::HandshakeStep SpheroBB8::HANDSHAKE_STEPS[] = {
+    {SUBSCRIBE, "Subscribing to responses", &SpheroBB8::char_handle_responses_, nullptr, 0, false},
+    {ANTI_DOS, "Anti-DOS", &SpheroBB8::char_handle_anti_dos_, ANTI_DOS_PAYLOAD, sizeof(ANTI_DOS_PAYLOAD), false},
+    {TX_POWER, "TX Power", &SpheroBB8::char_handle_tx_power_, TX_POWER_PAYLOAD, sizeof(TX_POWER_PAYLOAD), true},
+    {WAKE, "Wake", &SpheroBB8::char_handle_wake_, WAKE_PAYLOAD, sizeof(WAKE_PAYLOAD), false},
+};
+const size_t SpheroBB8::HANDSHAKE_STEP_COUNT = sizeof(HANDSHAKE_STEPS) / sizeof(HANDSHAKE_STEPS[0]);
+
+AirtimeArbiter SpheroBB8::airtime_arbiter_;
 
 void SpheroBB8::setup() {
   this->current_r_ = 0xFE;
   this->current_g_ = 0xFE;
   this->current_b_ = 0xFE;
   this->current_back_brightness_ = 0xFE;
+  this->current_interval_ = this->pacing_interval_;
+  this->tx_scheduler_.set_pacing(this->current_interval_, this->pacing_burst_);
+  this->batching_ = this->batching_enabled_;
+  this->airtime_client_ = this->airtime_arbiter_.register_client();
+  this->airtime_stagger_ = this->airtime_arbiter_.get_stagger(this->airtime_client_);
+  this->airtime_arbiter_.set_interval(this->airtime_interval_);
+
   this->enabled_ = this->auto_connect_;
   this->parent()->set_enabled(this->enabled_);
   this->parent()->set_auto_connect(this->enabled_);
+  this->set_status_(this->enabled_ ? STATUS_CONNECTING : STATUS_DISCONNECTED);
+
+  bool has_metric_sensor = this->commands_sent_sensor_ != nullptr;
+  has_metric_sensor |= this->loop_time_sensor_ != nullptr;
+  for (auto *sensor : this->latency_sensors_) {
+    has_metric_sensor |= sensor != nullptr;
+  }
+  for (auto *sensor : this->metric_sensors_) {
+    has_metric_sensor |= sensor != nullptr;
+  }
+  if (has_metric_sensor) {
+    this->set_interval("metrics", this->metrics_interval_, [this]() { this->publish_metrics_(); });
+  }
+
+  this->async_dispatcher_.set_handler(ASYNC_POWER_NOTIFICATION, &SpheroBB8::handle_power_notification_);
+  this->async_dispatcher_.set_handler(ASYNC_LEVEL1_DIAGNOSTIC, &SpheroBB8::handle_diagnostic_);
+  this->async_dispatcher_.set_handler(ASYNC_SENSOR_DATA, &SpheroBB8::handle_sensor_data_);
+  this->async_dispatcher_.set_handler(ASYNC_PRE_SLEEP_WARNING, &SpheroBB8::handle_pre_sleep_warning_);
+  this->async_dispatcher_.set_handler(ASYNC_MACRO_MARKER, &SpheroBB8::handle_macro_marker_);
+  this->async_dispatcher_.set_handler(ASYNC_COLLISION, &SpheroBB8::handle_collision_);
+
+  if (this->odometry_.is_enabled()) {
+    this->data_stream_.require(STREAM_YAW);
+    this->data_stream_.require(STREAM_VELOCITY_X);
+    this->data_stream_.require(STREAM_VELOCITY_Y);
+    this->odometry_.set_sample_period(this->data_stream_.get_sample_period());
+  }
+  this->data_stream_.setup();
+  if (this->data_stream_.is_enabled()) {
+    this->set_interval("data_stream", this->data_stream_.get_publish_interval(), [this]() {
+      this->data_stream_.publish();
+      if (this->odometry_.is_enabled())
+        this->odometry_.publish();
+    });
+  }
 }
 
 void SpheroBB8::connect() {
@@ -39,6 +124,8 @@ void SpheroBB8::connect() {
   this->enabled_ = true;
   this->parent()->set_enabled(true);
   this->parent()->set_auto_connect(true);
+  if (this->state_ == DISCONNECTED)
+    this->set_status_(STATUS_CONNECTING);
 }
 
 void SpheroBB8::disconnect() {
@@ -48,210 +135,511 @@ void SpheroBB8::disconnect() {
   this->version_requested_ = false;
   this->power_notify_enabled_ = false;
   this->collision_config_sent_ = false;
+  this->stream_config_sent_ = false;
+  this->inactivity_timeout_sent_ = false;
+  this->inactivity_timeout_set_ = false;
+  this->start_disabling_();
 }
 
-void SpheroBB8::loop() {
-  uint32_t now = millis();
+void SpheroBB8::start_disabling_() {
+  if (this->state_ == DISABLING)
+    return;
 
-  if (this->write_in_progress_ && now - this->last_write_request_ > 1000) {
-    ESP_LOGW(TAG, "Write timeout, resetting write_in_progress_");
-    this->write_in_progress_ = false;
+  if (this->state_ == DISCONNECTED || !this->parent()->connected()) {
+    this->state_ = DISCONNECTED;
+    this->parent()->set_enabled(false);
+    this->set_status_(STATUS_DISCONNECTED);
+    return;
   }
 
-  // Handle disabling sequence
-  if (!this->enabled_) {
-    if (this->state_ != DISCONNECTED && this->state_ != DISABLING && this->parent()->connected()) {
-      ESP_LOGI(TAG, "Sending Sleep command before disconnect...");
-      this->state_ = DISABLING;
-      this->last_state_change_ = now;
-      this->send_packet(0x00, 0x22, {0x00, 0x00, 0x00, 0x00, 0x00}, false);
-      this->force_lights_off_();
-    }
+  ESP_LOGI(TAG, "Sending Sleep command before disconnect...");
+  this->state_ = DISABLING;
+  this->last_state_change_ = millis();
+  // In-flight requests, pacing and RSSI are reset by ESP_GATTC_DISCONNECT_EVT once the link is down
+  this->tx_scheduler_.clear();
+  this->tx_scheduler_.enqueue<CmdSleep>(TX_PRIORITY_CONTROL, {0x00, 0x00, 0x00, 0x00, 0x00});
+  this->force_lights_off_();
+  this->set_status_(STATUS_DISABLING);
+  this->enable_loop();
 
-    if (this->state_ == DISABLING && now - this->last_state_change_ > 500) {
-      ESP_LOGI(TAG, "Disconnecting from Sphero BB8...");
-      this->parent()->set_enabled(false);
-      this->state_ = DISCONNECTED;
+  // loop() flushes the Sleep command in the meantime
+  this->set_timeout("disable", 500, [this]() {
+    ESP_LOGI(TAG, "Disconnecting from Sphero BB8...");
+    this->parent()->set_enabled(false);
+    this->state_ = DISCONNECTED;
+    if (this->enabled_) {
+      // Connect was pressed while the droid was going to sleep
+      this->parent()->set_enabled(true);
+      this->set_status_(STATUS_CONNECTING);
+    } else {
+      this->set_status_(STATUS_DISCONNECTED);
     }
+  });
+}
 
-    if (this->state_ == DISCONNECTED && this->parent()->enabled) {
-      this->parent()->set_enabled(false);
-    }
+void SpheroBB8::start_handshake_() {
+  this->handshake_step_ = 0;
+  this->set_status_(STATUS_INITIALIZING);
+  this->run_handshake_step_();
+}
+
+void SpheroBB8::run_handshake_step_() {
+  const HandshakeStep &step = HANDSHAKE_STEPS[this->handshake_step_];
+  this->state_ = step.state;
+  this->last_state_change_ = millis();
 
-    if (this->state_ == DISABLING) {
-      this->update_status_sensor_("Disabling");
+  uint16_t handle = this->*step.handle;
+  if (handle == 0) {
+    if (step.optional) {
+      ESP_LOGD(TAG, "Initialization State: %s not available, skipping", step.name);
+      this->next_handshake_step_();
     } else {
-      this->update_status_sensor_("Disconnected");
+      ESP_LOGE(TAG, "Initialization State: %s has no characteristic handle", step.name);
     }
     return;
   }
 
-  if (!this->parent()->connected()) {
-    this->state_ = DISCONNECTED;
-    this->update_status_sensor_("Connecting");
-    this->version_requested_ = false;
-    this->power_notify_enabled_ = false;
-    this->collision_config_sent_ = false;
+  ESP_LOGD(TAG, "Initialization State: %s", step.name);
+  // The stack copies the value, so the constant payload is never written to
+  auto status = step.payload == nullptr
+                    ? this->register_for_notify_(handle)
+                    : this->write_char_(handle, const_cast<uint8_t *>(step.payload), step.len, true);
+  if (status != ESP_OK) {
+    // No completion event will follow, so carry on as before and let the droid sort it out
+    ESP_LOGE(TAG, "Initialization State: %s failed: %d", step.name, status);
+    this->next_handshake_step_();
+  }
+}
+
+void SpheroBB8::next_handshake_step_() {
+  // Each step starts as soon as the previous one is confirmed
+  this->handshake_step_++;
+  if (this->handshake_step_ < HANDSHAKE_STEP_COUNT) {
+    this->run_handshake_step_();
     return;
   }
-  
-  if (this->write_in_progress_) {
+
+  this->state_ = READY_STABILIZE;
+  this->last_state_change_ = millis();
+  this->send_readiness_probe_();
+}
+
+void SpheroBB8::send_readiness_probe_() {
+  // The droid is ready once it answers a command, instead of after a fixed wait
+  ESP_LOGD(TAG, "Initialization State: Waiting for the droid to answer a Ping");
+  TxRequest probe{};
+  probe.did = CmdPing::DEVICE_ID;
+  probe.cid = CmdPing::COMMAND_ID;
+  probe.priority = TX_PRIORITY_CONTROL;
+  probe.on_response = &SpheroBB8::handle_readiness_probe_;
+  probe.on_timeout = &SpheroBB8::handle_readiness_probe_timeout_;
+  probe.retries = TxScheduler::DEFAULT_RETRIES;
+  this->tx_scheduler_.enqueue(probe);
+}
+
+void SpheroBB8::handle_readiness_probe_(const FrameView &frame) {
+  if (this->state_ == READY_STABILIZE)
+    this->enter_ready_();
+}
+
+void SpheroBB8::handle_readiness_probe_timeout_(const TxRequest &request) {
+  if (this->state_ != READY_STABILIZE)
     return;
+  ESP_LOGW(TAG, "Droid did not acknowledge the readiness probe, continuing anyway");
+  this->enter_ready_();
+}
+
+void SpheroBB8::enter_ready_() {
+  uint32_t now = millis();
+  this->state_ = READY;
+  this->last_state_change_ = now;
+  // Droids sharing this controller get their periodic traffic out of phase by their stagger, so
+  // pings and polls do not line up: the keepalive comes that much earlier, the first poll later
+  this->last_packet_sent_ = now - this->airtime_stagger_;
+  this->last_power_check_ = now - this->battery_.get_poll_interval() + this->airtime_stagger_;
+  this->last_housekeeping_ = now - HOUSEKEEPING_INTERVAL;
+  // The first pass through loop_ready_() queues every LED and configuration update that differs from the droid
+  this->restore_pending_ = true;
+  ESP_LOGI(TAG, "Sphero BB8 is Ready! (handshake took %ums)", (unsigned) (now - this->connected_at_));
+  if (this->handshake_time_sensor_ != nullptr) {
+    this->handshake_time_sensor_->publish_state(now - this->connected_at_);
   }
+  this->set_status_(STATUS_READY);
+}
 
-  if (this->state_ == SUBSCRIBE && this->char_handle_responses_ != 0) {
-    this->update_status_sensor_("Initializing");
-    ESP_LOGD(TAG, "Initialization State: Subscribing to responses");
-    auto status = esp_ble_gattc_register_for_notify(this->parent()->get_gattc_if(), 
-                                                    this->parent()->get_remote_bda(), 
-                                                    this->char_handle_responses_);
-    if (status != ESP_OK) {
-      ESP_LOGE(TAG, "Failed to register for notify: %d", status);
-    }
-    this->state_ = ANTI_DOS;
-    this->last_state_change_ = now;
-  } 
-  else if (this->state_ == ANTI_DOS && this->char_handle_anti_dos_ != 0) {
-    if (now - this->last_state_change_ < 200) return;
-
-    this->update_status_sensor_("Initializing");
-    ESP_LOGD(TAG, "Initialization State: Anti-DOS");
-    uint8_t anti_dos_payload[] = {'0', '1', '1', 'i', '3'};
-    this->write_in_progress_ = true;
-    this->last_write_request_ = now;
-    auto status = esp_ble_gattc_write_char(this->parent()->get_gattc_if(), this->parent()->get_conn_id(),
-                                          this->char_handle_anti_dos_, sizeof(anti_dos_payload), anti_dos_payload,
-                                          ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
-    if (status != ESP_OK) {
-      ESP_LOGE(TAG, "Failed to write Anti-DOS: %d", status);
-      this->write_in_progress_ = false;
-    }
-    this->state_ = TX_POWER;
-    this->last_state_change_ = now;
+void SpheroBB8::loop() {
+  uint32_t start = this->loop_time_sensor_ != nullptr ? micros() : 0;
+  uint32_t now = millis();
+
+  if (this->write_in_progress_ && now - this->last_write_request_ > 1000) {
+    ESP_LOGW(TAG, "Write timeout, resetting write_in_progress_");
+    this->metrics_.write_timeouts++;
+    this->write_in_progress_ = false;
+    this->unconfirmed_writes_ = 0;
+    if (this->batch_in_flight_)
+      this->disable_batching_();
+    // A handshake write that never completes must not stall the handshake
+    if (this->state_ >= ANTI_DOS && this->state_ <= WAKE)
+      this->next_handshake_step_();
   }
-  else if (this->state_ == TX_POWER && this->char_handle_tx_power_ != 0) {
-    this->update_status_sensor_("Initializing");
-    ESP_LOGD(TAG, "Initialization State: TX Power");
-    uint8_t tx_power_payload[] = {7};
-    this->write_in_progress_ = true;
-    this->last_write_request_ = now;
-    auto status = esp_ble_gattc_write_char(this->parent()->get_gattc_if(), this->parent()->get_conn_id(),
-                                          this->char_handle_tx_power_, sizeof(tx_power_payload), tx_power_payload,
-                                          ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
-    if (status != ESP_OK) {
-      ESP_LOGE(TAG, "Failed to write TX Power: %d", status);
-      this->write_in_progress_ = false;
-    }
-    this->state_ = WAKE;
-    this->last_state_change_ = now;
+
+  switch (this->state_) {
+    case READY:
+      this->loop_ready_(now);
+      break;
+    case READY_STABILIZE:
+      this->expire_requests_(now);
+      this->flush_tx_queue_(now);
+      break;
+    case DISABLING:
+      this->flush_tx_queue_(now);
+      break;
+    case DISCONNECTED:
+      // Nothing to do until a GATT event or a button press wakes the loop up again
+      this->disable_loop();
+      break;
+    default:
+      // The handshake is driven by GATT events and timeouts
+      break;
   }
-  else if (this->state_ == WAKE && this->char_handle_wake_ != 0) {
-    this->update_status_sensor_("Initializing");
-    ESP_LOGD(TAG, "Initialization State: Wake");
-    uint8_t wake_payload[] = {0x01};
-    this->write_in_progress_ = true;
-    this->last_write_request_ = now;
-    auto status = esp_ble_gattc_write_char(this->parent()->get_gattc_if(), this->parent()->get_conn_id(),
-                                          this->char_handle_wake_, sizeof(wake_payload), wake_payload,
-                                          ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
-    if (status != ESP_OK) {
-      ESP_LOGE(TAG, "Failed to write Wake: %d", status);
-      this->write_in_progress_ = false;
-    }
-    this->state_ = READY_STABILIZE;
-    this->last_state_change_ = now;
-  } 
-  else if (this->state_ == READY_STABILIZE) {
-    this->update_status_sensor_("Initializing");
-    if (now - this->last_state_change_ >= 2000) {
-      this->state_ = READY;
-      this->last_state_change_ = now;
-      this->last_packet_sent_ = now;
-      this->last_power_check_ = now - 60000; // Force immediate check
-      ESP_LOGI(TAG, "Sphero BB8 is Ready!");
+
+  if (this->loop_time_sensor_ != nullptr)
+    this->metrics_.count_loop(micros() - start);
+}
+
+void SpheroBB8::loop_ready_(uint32_t now) {
+  // Timers and one-off configuration only need coarse resolution, so they run on a tick
+  if (now - this->last_housekeeping_ >= HOUSEKEEPING_INTERVAL) {
+    this->last_housekeeping_ = now;
+    this->housekeeping_(now);
+  }
+
+  this->sync_drive_(now);
+
+  // Pending LED updates are replaced in the queue, so only the latest target is sent.
+  // While a macro runs the droid drives the LEDs itself.
+  if (!this->macro_running_ && (this->target_r_ != this->current_r_ || this->target_g_ != this->current_g_ ||
+                                this->target_b_ != this->current_b_)) {
+    ESP_LOGV(TAG, "Syncing RGB: %d, %d, %d", this->target_r_, this->target_g_, this->target_b_);
+    this->tx_scheduler_.enqueue<CmdSetRGB>(TX_PRIORITY_LED, {this->target_r_, this->target_g_, this->target_b_, 0x00},
+                                           nullptr, this->trace_led_sync_(this->rgb_set_at_, now));
+    this->current_r_ = this->target_r_;
+    this->current_g_ = this->target_g_;
+    this->current_b_ = this->target_b_;
+  }
+  if (!this->macro_running_ && this->target_back_brightness_ != this->current_back_brightness_) {
+    ESP_LOGV(TAG, "Syncing Back LED: %d", this->target_back_brightness_);
+    this->tx_scheduler_.enqueue<CmdSetBackLED>(TX_PRIORITY_LED, {this->target_back_brightness_}, nullptr,
+                                               this->trace_led_sync_(this->back_led_set_at_, now));
+    this->current_back_brightness_ = this->target_back_brightness_;
+  }
+
+  if (this->tx_scheduler_.has_pending())
+    this->flush_tx_queue_(now);
+}
+
+void SpheroBB8::housekeeping_(uint32_t now) {
+  // Enable Power Notifications Once
+  if (!this->power_notify_enabled_) {
+    ESP_LOGD(TAG, "Enabling Power Notifications");
+    this->tx_scheduler_.enqueue<CmdSetPowerNotify>(TX_PRIORITY_CONTROL, {0x01});
+    this->power_notify_enabled_ = true;
+  }
+
+  // Configure Collision Detection Once
+  if (!this->collision_config_sent_) {
+    this->configure_collision_detection_();
+    this->collision_config_sent_ = true;
+  }
+
+  // Let the droid stay awake on its own instead of pinging it every few seconds
+  if (!this->inactivity_timeout_sent_) {
+    ESP_LOGD(TAG, "Setting Inactivity Timeout to %us", this->inactivity_timeout_);
+    this->tx_scheduler_.enqueue<CmdSetInactivityTimeout>(
+        TX_PRIORITY_CONTROL, {(uint8_t) (this->inactivity_timeout_ >> 8), (uint8_t) (this->inactivity_timeout_ & 0xFF)},
+        &SpheroBB8::handle_inactivity_timeout_);
+    this->inactivity_timeout_sent_ = true;
+  }
+
+  // Start Sensor Data Streaming Once
+  if (!this->stream_config_sent_ && this->data_stream_.is_enabled()) {
+    ESP_LOGD(TAG, "Enabling Data Streaming at %dHz", this->data_stream_.get_sample_rate());
+    CmdSetDataStreaming::Payload payload;
+    this->data_stream_.build_config(payload.data());
+    this->tx_scheduler_.enqueue<CmdSetDataStreaming>(TX_PRIORITY_CONTROL, payload);
+    this->stream_config_sent_ = true;
+  }
+
+  // Auto-reset collision sensor
+  if (this->collision_sensor_ != nullptr && this->collision_sensor_->state && now - this->last_collision_time_ > 500) {
+    this->collision_sensor_->publish_state(false);
+  }
+  this->publish_collision_(now);
+
+  // Poll Battery
+  if (now - this->last_power_check_ > this->battery_.get_poll_interval()) {
+    ESP_LOGD(TAG, "Polling Battery");
+    this->tx_scheduler_.enqueue<CmdGetPowerState>(TX_PRIORITY_TELEMETRY, {}, &SpheroBB8::handle_power_state_);
+    this->last_power_check_ = now;
+  }
+
+  // Get Version Once
+  if (!this->version_requested_ && now - this->last_state_change_ > 3000) {
+    ESP_LOGD(TAG, "Requesting Firmware Version");
+    this->tx_scheduler_.enqueue<CmdGetVersion>(TX_PRIORITY_TELEMETRY, {}, &SpheroBB8::handle_version_);
+    this->version_requested_ = true;
+  }
+
+  if (this->pacing_mode_ == PACING_MODE_ADAPTIVE && now - this->last_probe_ > this->probe_interval_) {
+    this->send_link_probe_(now);
+  }
+
+  // Until the droid has accepted the inactivity timeout it would sleep after a few idle seconds,
+  // so the fast keepalive stays in place; afterwards the ping only checks that the link is alive.
+  uint32_t keepalive = this->inactivity_timeout_set_ ? this->liveness_interval_ : FAST_KEEPALIVE_INTERVAL;
+  if (now - this->last_packet_sent_ > keepalive && !this->tx_scheduler_.has_pending()) {
+    ESP_LOGV(TAG, "Sending Keep Alive Ping");
+    this->metrics_.keepalive_pings++;
+    this->tx_scheduler_.enqueue<CmdPing>(TX_PRIORITY_KEEPALIVE);
+  }
+
+  this->expire_requests_(now);
+}
+
+void SpheroBB8::flush_tx_queue_(uint32_t now) {
+  TxRequest request;
+  while (!this->write_in_progress_ &&
+         this->airtime_arbiter_.request(this->airtime_client_, this->tx_scheduler_.ready(now), now) &&
+         this->tx_scheduler_.pop(now, request)) {
+    size_t limit = this->batching_ ? std::min<size_t>(this->mtu_ - ATT_HEADER_SIZE, MAX_BATCH_SIZE) : 0;
+    if (request.len + PACKET_OVERHEAD > limit) {
+      this->send_request_(now, request);
     } else {
-      ESP_LOGV(TAG, "Initialization State: Stabilizing (%dms remaining)", 2000 - (now - this->last_state_change_));
+      this->send_batch_(now, request, limit);
     }
   }
-  else if (this->state_ == READY) {
-    this->update_status_sensor_("Ready");
-    
-    // Enable Power Notifications Once
-    if (!this->power_notify_enabled_) {
-        ESP_LOGD(TAG, "Enabling Power Notifications");
-        this->send_packet(DID_CORE, CID_SET_POWER_NOTIFY, {0x01});
-        this->power_notify_enabled_ = true;
-    }
+}
 
-    // Configure Collision Detection Once
-    if (!this->collision_config_sent_) {
-        this->configure_collision_detection_();
-        this->collision_config_sent_ = true;
-    }
+void SpheroBB8::send_request_(uint32_t now, const TxRequest &request) {
+  if (this->char_handle_commands_ == 0) return;
 
-    // Auto-reset collision sensor
-    if (this->collision_sensor_ != nullptr && this->collision_sensor_->state && now - this->last_collision_time_ > 500) {
-        this->collision_sensor_->publish_state(false);
-    }
+  uint8_t seq = this->sequence_number_++;
+  uint8_t packet[MAX_PACKET_SIZE];
+  size_t packet_len = encode_packet(packet, request.did, request.cid, seq, request.payload, request.len);
+  auto status = this->write_packet_(request.did, request.cid, seq, packet, packet_len, false);
+  this->track_request_(seq, request, now);
+  // Taken once the stack has the packet, so a slow or failed write does not count as written
+  if (status == ESP_OK && request.traced_at != 0)
+    this->latency_[LATENCY_WRITE].add(millis() - request.traced_at);
+}
 
-    // Poll Battery
-    if (now - this->last_power_check_ > 60000) {
-      ESP_LOGD(TAG, "Polling Battery");
-      this->power_req_seq_ = this->send_packet(DID_CORE, CID_GET_POWER_STATE, {});
-      this->last_power_check_ = now;
-    }
+void SpheroBB8::send_batch_(uint32_t now, TxRequest &request, size_t limit) {
+  if (this->char_handle_commands_ == 0) return;
+
+  // Further queued frames ride along in the same write while they fit, within the usual pacing
+  size_t len = 0;
+  uint8_t frames = 0;
+  struct {
+    uint8_t did;
+    uint8_t cid;
+    uint8_t len;
+    uint32_t traced_at;
+  } sent[MAX_BATCH_SIZE / PACKET_OVERHEAD];
+  do {
+    uint8_t seq = this->sequence_number_++;
+    size_t packet_len = encode_packet(this->tx_batch_ + len, request.did, request.cid, seq, request.payload,
+                                      request.len);
+    ESP_LOGV(TAG, "Batching packet DID=0x%02X CID=0x%02X SEQ=%d", request.did, request.cid, seq);
+    this->track_request_(seq, request, now);
+    sent[frames] = {request.did, request.cid, static_cast<uint8_t>(packet_len), request.traced_at};
+    len += packet_len;
+    frames++;
+  } while (len + PACKET_OVERHEAD <= limit &&
+           this->tx_scheduler_.pop(now, request, limit - len - PACKET_OVERHEAD));
 
-    // Get Version Once
-    if (!this->version_requested_ && now - this->last_state_change_ > 3000) {
-      ESP_LOGD(TAG, "Requesting Firmware Version");
-      this->version_req_seq_ = this->send_packet(DID_CORE, CID_VERSION, {});
-      this->version_requested_ = true;
+  // A single frame goes out exactly as before; a batch is acknowledged so a rejection can be detected
+  this->batch_in_flight_ = frames > 1;
+  auto status = this->write_char_(this->char_handle_commands_, this->tx_batch_, len, this->batch_in_flight_);
+  if (status != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to write command: %d", status);
+    if (this->batch_in_flight_)
+      this->disable_batching_();
+  } else {
+    if (frames > 1)
+      this->metrics_.batched_writes++;
+    uint32_t written = millis();
+    for (uint8_t i = 0; i < frames; i++) {
+      this->metrics_.count_sent(sent[i].did, sent[i].cid, sent[i].len);
+      if (sent[i].traced_at != 0)
+        this->latency_[LATENCY_WRITE].add(written - sent[i].traced_at);
     }
+  }
+  this->last_packet_sent_ = millis();
+}
 
-    if (now - this->last_packet_sent_ > 2000) {
-      ESP_LOGV(TAG, "Sending Keep Alive Ping");
-      this->send_packet(0x00, 0x01, {}, false);
-    } 
-    else if (now - this->last_packet_sent_ < 50) {
-      return;
+void SpheroBB8::disable_batching_() {
+  ESP_LOGW(TAG, "Droid rejected a batched write, sending one packet per write from now on");
+  this->batching_ = false;
+  this->batch_in_flight_ = false;
+  // Whatever was in the batch may be lost, so LED, drive and configuration state is sent again.
+  // Requests with a response handler are retried by the request table.
+  this->current_r_ = 0xFE;
+  this->current_g_ = 0xFE;
+  this->current_b_ = 0xFE;
+  this->current_back_brightness_ = 0xFE;
+  this->drive_pending_ = true;
+  this->power_notify_enabled_ = false;
+  this->collision_config_sent_ = false;
+  this->stream_config_sent_ = false;
+}
+
+void SpheroBB8::track_request_(uint8_t seq, const TxRequest &request, uint32_t now) {
+  if (this->restore_pending_ && request.did == DID_SPHERO && request.cid == CID_SET_RGB) {
+    ESP_LOGD(TAG, "Main LED restored %ums after connecting", (unsigned) (now - this->connected_at_));
+    this->restore_pending_ = false;
+  }
+  // Every packet is sent with SOP2=0xFF, so the droid answers each one; that gives RTT for all commands.
+  // Fire-and-forget frames make way for requests with a handler when the table is full.
+  if (!this->requests_.add(seq, request, now) && request.on_response != nullptr) {
+    ESP_LOGW(TAG, "Request table full, response to DID=0x%02X CID=0x%02X will be ignored", request.did, request.cid);
+  }
+}
+
+void SpheroBB8::expire_requests_(uint32_t now) {
+  PendingRequest expired;
+  while (this->requests_.expire(now, expired)) {
+    TxRequest &request = expired.request;
+    if (request.on_response == nullptr) {
+      ESP_LOGV(TAG, "No response for DID=0x%02X CID=0x%02X SEQ=%d", request.did, request.cid, expired.seq);
+      continue;
     }
+    this->retry_request_(request, "timed out");
+  }
+}
 
-    if (this->target_r_ != this->current_r_ || this->target_g_ != this->current_g_ || this->target_b_ != this->current_b_) {
-      ESP_LOGV(TAG, "Syncing RGB: %d, %d, %d", this->target_r_, this->target_g_, this->target_b_);
-      this->send_packet(0x02, 0x20, {this->target_r_, this->target_g_, this->target_b_, 0x00}, false);
-      this->current_r_ = this->target_r_;
-      this->current_g_ = this->target_g_;
-      this->current_b_ = this->target_b_;
-    } else if (this->target_back_brightness_ != this->current_back_brightness_) {
-      ESP_LOGV(TAG, "Syncing Back LED: %d", this->target_back_brightness_);
-      this->send_packet(0x02, 0x21, {this->target_back_brightness_}, false);
-      this->current_back_brightness_ = this->target_back_brightness_;
+void SpheroBB8::retry_request_(TxRequest &request, const char *reason) {
+  if (request.retries == 0) {
+    if (request.on_timeout != nullptr) {
+      (this->*request.on_timeout)(request);
+    } else {
+      ESP_LOGW(TAG, "Request DID=0x%02X CID=0x%02X %s, giving up", request.did, request.cid, reason);
     }
+    return;
   }
+  ESP_LOGD(TAG, "Request DID=0x%02X CID=0x%02X %s, retrying (%d left)", request.did, request.cid, reason,
+           request.retries);
+  request.retries--;
+  this->tx_scheduler_.enqueue(request);
+}
+
+void SpheroBB8::set_collision_config(uint8_t x_threshold, uint8_t x_speed, uint8_t y_threshold, uint8_t y_speed,
+                                      uint32_t dead_time) {
+  this->collision_config_.x_threshold = x_threshold;
+  this->collision_config_.x_speed = x_speed;
+  this->collision_config_.y_threshold = y_threshold;
+  this->collision_config_.y_speed = y_speed;
+  // Dead time is sent in 10ms units
+  this->collision_config_.dead_time = std::min<uint32_t>(dead_time / 10, 255);
+  // Picked up by loop() once the droid is ready
+  this->collision_config_sent_ = false;
 }
 
 void SpheroBB8::configure_collision_detection_() {
-    ESP_LOGD(TAG, "Configuring Collision Detection");
-    // Method: 0x01 (Enable)
-    // Xt (Threshold): 0x64 (100)
-    // Xspd (Speed): 0x64 (100)
-    // Yt (Threshold): 0x64 (100)
-    // Yspd (Speed): 0x64 (100)
-    // DeadTime: 0x32 (50 * 10ms = 500ms)
-    this->send_packet(DID_SPHERO, CID_CONFIG_COLLISION, {0x01, 0x64, 0x64, 0x64, 0x64, 0x32});
+    const CollisionConfig &config = this->collision_config_;
+    ESP_LOGD(TAG, "Configuring Collision Detection: X %u/%u, Y %u/%u, dead time %ums", config.x_threshold,
+             config.x_speed, config.y_threshold, config.y_speed, config.dead_time * 10u);
+    // Method 0x01 (Enable), Xt, Xspd, Yt, Yspd, DeadTime
+    this->tx_scheduler_.enqueue<CmdConfigCollision>(TX_PRIORITY_CONTROL,
+                                                    {0x01, config.x_threshold, config.x_speed, config.y_threshold,
+                                                     config.y_speed, config.dead_time});
+}
+
+bool SpheroBB8::discover_handles_() {
+  const SpheroUUIDs &uuids = get_sphero_uuids();
+
+  auto *anti_dos_char = this->parent()->get_characteristic(uuids.ble_service, uuids.anti_dos);
+  if (anti_dos_char != nullptr) this->char_handle_anti_dos_ = anti_dos_char->handle;
+
+  auto *tx_power_char = this->parent()->get_characteristic(uuids.ble_service, uuids.tx_power);
+  if (tx_power_char != nullptr) this->char_handle_tx_power_ = tx_power_char->handle;
+
+  auto *wake_char = this->parent()->get_characteristic(uuids.ble_service, uuids.wake);
+  if (wake_char != nullptr) this->char_handle_wake_ = wake_char->handle;
+
+  auto *commands_char = this->parent()->get_characteristic(uuids.control_service, uuids.commands);
+  if (commands_char != nullptr) this->char_handle_commands_ = commands_char->handle;
+
+  auto *responses_char = this->parent()->get_characteristic(uuids.control_service, uuids.responses);
+  if (responses_char != nullptr) this->char_handle_responses_ = responses_char->handle;
+
+  return this->char_handle_anti_dos_ && this->char_handle_wake_ && this->char_handle_commands_ &&
+         this->char_handle_responses_;
 }
 
 void SpheroBB8::center_head() {
     ESP_LOGI(TAG, "Centering Head (Self Level)...");
     // DID 0x02, CID 0x09
     // Payload: [0x01, 0x00, 0x00, 0x00] -> Options: Start, AngleLimit: 0, Timeout: 0, TrueTime: 0
-    this->send_packet(DID_SPHERO, CID_SET_SELF_LEVEL, {0x01, 0x00, 0x00, 0x00}, false);
+    if (!this->is_ready()) {
+        ESP_LOGW(TAG, "Cannot center head, Sphero BB8 is not ready");
+        return;
+    }
+    this->tx_scheduler_.enqueue<CmdSetSelfLevel>(TX_PRIORITY_CONTROL, {0x01, 0x00, 0x00, 0x00});
+}
+
+void SpheroBB8::reset_odometry() {
+  ESP_LOGI(TAG, "Resetting odometry at x %.0fcm, y %.0fcm, %.0fcm travelled", this->odometry_.get_x(),
+           this->odometry_.get_y(), this->odometry_.get_distance());
+  this->odometry_.reset();
 }
 
-void SpheroBB8::update_status_sensor_(const std::string &status) {
-  if (this->status_sensor_ != nullptr && this->last_status_str_ != status) {
-    this->status_sensor_->publish_state(status);
-    this->last_status_str_ = status;
+void SpheroBB8::drive(uint8_t speed, uint16_t heading) {
+  if (!this->is_ready()) {
+    // Setpoints stream in at the caller's rate, so only the first one after the droid went away is reported
+    if (!this->drive_rejected_)
+      ESP_LOGW(TAG, "Cannot drive, Sphero BB8 is not ready");
+    this->drive_rejected_ = true;
+    return;
+  }
+  this->drive_rejected_ = false;
+  ESP_LOGV(TAG, "Setting drive target: speed=%d heading=%d", speed, heading);
+  this->drive_speed_ = speed;
+  this->drive_heading_ = heading % 360;
+  this->drive_pending_ = true;
+  this->last_drive_setpoint_ = millis();
+}
+
+void SpheroBB8::stop() {
+  ESP_LOGD(TAG, "Stopping");
+  this->drive_speed_ = 0;
+  this->drive_pending_ = true;
+}
+
+void SpheroBB8::sync_drive_(uint32_t now) {
+  if (this->driving_ && !this->drive_pending_ && now - this->last_drive_setpoint_ > this->drive_deadman_) {
+    ESP_LOGW(TAG, "No drive setpoint for %ums, stopping", (unsigned) this->drive_deadman_);
+    this->drive_speed_ = 0;
+    this->drive_pending_ = true;
+  }
+  if (!this->drive_pending_)
+    return;
+
+  // Roll payload: [SPEED, HEADING_H, HEADING_L, STATE]; STATE 0 brakes to a stop
+  uint8_t state = this->drive_speed_ > 0 ? 0x01 : 0x00;
+  this->tx_scheduler_.enqueue<CmdRoll>(TX_PRIORITY_DRIVE,
+                                       {this->drive_speed_, static_cast<uint8_t>(this->drive_heading_ >> 8),
+                                        static_cast<uint8_t>(this->drive_heading_ & 0xFF), state});
+  this->driving_ = this->drive_speed_ > 0;
+  this->drive_pending_ = false;
+}
+
+void SpheroBB8::set_status_(HubStatus status) {
+  if (this->status_ == status && this->status_published_)
+    return;
+  this->status_ = status;
+  if (this->status_sensor_ != nullptr) {
+    this->status_sensor_->publish_state(STATUS_NAMES[status]);
+    this->status_published_ = true;
   }
 }
 
@@ -264,52 +652,107 @@ void SpheroBB8::force_lights_off_() {
         call.perform();
       }
     }
+    // Matches the cleared targets, so the colour from before is sent again when it is picked again
+    if (light != nullptr)
+      memset(light->last_sent_, 0, sizeof(light->last_sent_));
   }
+  // Home Assistant now shows the lights off, so the restore after the next connect keeps them dark
+  this->target_r_ = 0;
+  this->target_g_ = 0;
+  this->target_b_ = 0;
+  this->target_back_brightness_ = 0;
 }
 
 void SpheroBB8::dump_config() {
   ESP_LOGCONFIG(TAG, "Sphero BB8");
-  ESP_LOGCONFIG(TAG, "  State: %d", this->state_);
+  ESP_LOGCONFIG(TAG, "  State: %d (%s)", this->state_, STATUS_NAMES[this->status_]);
   LOG_SENSOR("  ", "Battery Level", this->battery_sensor_);
+  LOG_SENSOR("  ", "Discharge Rate", this->discharge_rate_sensor_);
+  LOG_SENSOR("  ", "Time Remaining", this->time_remaining_sensor_);
   LOG_TEXT_SENSOR("  ", "Firmware Version", this->version_sensor_);
   LOG_TEXT_SENSOR("  ", "Charging Status", this->charging_status_sensor_);
   LOG_BINARY_SENSOR("  ", "Collision Detected", this->collision_sensor_);
   LOG_SENSOR("  ", "Collision Speed", this->collision_speed_sensor_);
   LOG_SENSOR("  ", "Collision Magnitude", this->collision_magnitude_sensor_);
+  ESP_LOGCONFIG(TAG, "  Collision Detection: X %u/%u, Y %u/%u, dead time %ums, published every %ums",
+                this->collision_config_.x_threshold, this->collision_config_.x_speed,
+                this->collision_config_.y_threshold, this->collision_config_.y_speed,
+                this->collision_config_.dead_time * 10u, (unsigned) this->collision_publish_interval_);
+  if (this->data_stream_.is_enabled()) {
+    ESP_LOGCONFIG(TAG, "  Data Streaming: %dHz, published every %ums (%u samples received)",
+                  this->data_stream_.get_sample_rate(), (unsigned) this->data_stream_.get_publish_interval(),
+                  (unsigned) this->data_stream_.get_samples());
+  }
+  if (this->odometry_.is_enabled()) {
+    ESP_LOGCONFIG(TAG, "  Odometry: x %.0fcm, y %.0fcm, heading %.0f°, %.0fcm travelled", this->odometry_.get_x(),
+                  this->odometry_.get_y(), this->odometry_.get_heading(), this->odometry_.get_distance());
+  }
+  ESP_LOGCONFIG(TAG, "  Drive Deadman: %ums", (unsigned) this->drive_deadman_);
+  ESP_LOGCONFIG(TAG, "  Airtime: client %u of %u, %ums shared gap, %ums stagger, %u grants", this->airtime_client_,
+                this->airtime_arbiter_.get_client_count(), (unsigned) this->airtime_arbiter_.get_interval(),
+                (unsigned) this->airtime_stagger_, (unsigned) this->airtime_arbiter_.get_grants(this->airtime_client_));
+  if (this->pacing_mode_ == PACING_MODE_ADAPTIVE) {
+    ESP_LOGCONFIG(TAG, "  Pacing: adaptive, %u-%ums (current %ums), burst %u", (unsigned) this->pacing_min_interval_,
+                  (unsigned) this->pacing_max_interval_, (unsigned) this->current_interval_, this->pacing_burst_);
+    ESP_LOGCONFIG(TAG, "    Target RTT: %ums, Min RSSI: %ddBm, Probe Interval: %ums",
+                  (unsigned) this->pacing_target_rtt_, this->pacing_min_rssi_, (unsigned) this->probe_interval_);
+  } else {
+    ESP_LOGCONFIG(TAG, "  Pacing: fixed, %ums, burst %u", (unsigned) this->pacing_interval_, this->pacing_burst_);
+  }
+  LOG_SENSOR("  ", "Pacing Interval", this->pacing_interval_sensor_);
+  LOG_SENSOR("  ", "Link RTT", this->link_rtt_sensor_);
+  LOG_SENSOR("  ", "RSSI", this->rssi_sensor_);
+  ESP_LOGCONFIG(TAG, "  Metrics (published every %ums):", (unsigned) this->metrics_interval_);
+  ESP_LOGCONFIG(TAG, "    Sent: %u packets, %u bytes", (unsigned) this->metrics_.packets_sent,
+                (unsigned) this->metrics_.bytes_sent);
+  ESP_LOGCONFIG(TAG, "    Received: %u notifications, %u bytes, %u frames", (unsigned) this->metrics_.notifications_received,
+                (unsigned) this->metrics_.bytes_received, (unsigned) this->metrics_.frames_parsed);
+  ESP_LOGCONFIG(TAG, "    Write failures: %u, Write timeouts: %u", (unsigned) this->metrics_.write_failures,
+                (unsigned) this->metrics_.write_timeouts);
+  ESP_LOGCONFIG(TAG, "    Batching: %s, MTU %u, %u batched writes", this->batching_ ? "on" : "off",
+                this->mtu_, (unsigned) this->metrics_.batched_writes);
+  ESP_LOGCONFIG(TAG, "    Async frames without a decoder: %u (last ID 0x%02X)",
+                (unsigned) this->async_dispatcher_.get_unknown(), this->async_dispatcher_.get_last_unknown_id());
+  uint32_t keepalive = this->inactivity_timeout_set_ ? this->liveness_interval_ : FAST_KEEPALIVE_INTERVAL;
+  ESP_LOGCONFIG(TAG, "  Inactivity Timeout: %us (%s)", this->inactivity_timeout_,
+                this->inactivity_timeout_set_ ? "accepted" : "not set yet");
+  ESP_LOGCONFIG(TAG, "  Idle keepalive: one ping per %ums, %u packets/h (%u packets/h at %ums)", (unsigned) keepalive,
+                (unsigned) (3600000 / keepalive), (unsigned) (3600000 / FAST_KEEPALIVE_INTERVAL),
+                (unsigned) FAST_KEEPALIVE_INTERVAL);
+  ESP_LOGCONFIG(TAG, "    Keepalive pings: %u, LED updates coalesced: %u", (unsigned) this->metrics_.keepalive_pings,
+                (unsigned) this->tx_scheduler_.get_coalesced_count(TX_PRIORITY_LED));
+  for (size_t i = 0; i < this->metrics_.command_count; i++) {
+    const CommandCounter &counter = this->metrics_.commands[i];
+    ESP_LOGCONFIG(TAG, "    DID=0x%02X CID=0x%02X: %u packets, %u bytes", counter.did, counter.cid,
+                  (unsigned) counter.packets, (unsigned) counter.bytes);
+  }
+  ESP_LOGCONFIG(TAG, "  RX Checksum Failures: %u", (unsigned) this->get_checksum_failures());
+  ESP_LOGCONFIG(TAG, "  RX Resync Bytes: %u", (unsigned) this->get_resync_bytes());
+  ESP_LOGCONFIG(TAG, "  Request Table Evictions: %u", (unsigned) this->requests_.get_evictions());
+  for (size_t i = 0; i < this->requests_.get_stats_count(); i++) {
+    const LatencyStats &stats = this->requests_.get_stats(i);
+    ESP_LOGCONFIG(TAG, "  RTT DID=0x%02X CID=0x%02X: last=%ums min=%ums avg=%ums max=%ums (%u ok, %u timeouts)",
+                  stats.did, stats.cid, (unsigned) stats.last_ms, (unsigned) stats.min_ms,
+                  (unsigned) (stats.responses > 0 ? stats.total_ms / stats.responses : 0), (unsigned) stats.max_ms,
+                  (unsigned) stats.responses, (unsigned) stats.timeouts);
+  }
 }
 
 void SpheroBB8::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
                                     esp_ble_gattc_cb_param_t *param) {
   switch (event) {
     case ESP_GATTC_SEARCH_CMPL_EVT: {
-      auto ble_service_uuid = espbt::ESPBTUUID::from_raw(SERVICE_BLE_UUID);
-      auto control_service_uuid = espbt::ESPBTUUID::from_raw(SERVICE_CONTROL_UUID);
-      
-      auto *anti_dos_char = this->parent()->get_characteristic(ble_service_uuid,
-                                                               espbt::ESPBTUUID::from_raw(CHAR_ANTI_DOS_UUID));
-      if (anti_dos_char != nullptr) this->char_handle_anti_dos_ = anti_dos_char->handle;
-
-      auto *tx_power_char = this->parent()->get_characteristic(ble_service_uuid,
-                                                               espbt::ESPBTUUID::from_raw(CHAR_TX_POWER_UUID));
-      if (tx_power_char != nullptr) this->char_handle_tx_power_ = tx_power_char->handle;
-
-      auto *wake_char = this->parent()->get_characteristic(ble_service_uuid,
-                                                           espbt::ESPBTUUID::from_raw(CHAR_WAKE_UUID));
-      if (wake_char != nullptr) this->char_handle_wake_ = wake_char->handle;
-
-      auto *commands_char = this->parent()->get_characteristic(control_service_uuid,
-                                                               espbt::ESPBTUUID::from_raw(CHAR_COMMANDS_UUID));
-      if (commands_char != nullptr) this->char_handle_commands_ = commands_char->handle;
-
-      auto *responses_char = this->parent()->get_characteristic(control_service_uuid,
-                                                                espbt::ESPBTUUID::from_raw(CHAR_RESPONSES_UUID));
-      if (responses_char != nullptr) this->char_handle_responses_ = responses_char->handle;
-
-      if (this->char_handle_anti_dos_ && this->char_handle_wake_ && this->char_handle_commands_ && this->char_handle_responses_) {
+      if (this->mtu_ == DEFAULT_MTU) {
+        this->request_mtu_();
+      }
+      if (this->discover_handles_()) {
         ESP_LOGI(TAG, "Found all required characteristics for Sphero BB8");
-        this->state_ = SUBSCRIBE;
+        this->start_handshake_();
       } else {
         ESP_LOGE(TAG, "Failed to find all required characteristics for Sphero BB8");
+        // A stale flash GATT cache would keep hiding them, so the next connection rediscovers
+        if (this->cache_services_)
+          esp_ble_gattc_cache_clean(this->parent()->get_remote_bda());
       }
       break;
     }
@@ -317,7 +760,9 @@ void SpheroBB8::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t ga
       ESP_LOGI(TAG, "Connected to Sphero BB8");
       this->state_ = CONNECTING;
       this->last_state_change_ = millis();
-      this->update_status_sensor_("Connected");
+      this->connected_at_ = this->last_state_change_;
+      this->set_status_(STATUS_CONNECTED);
+      this->enable_loop();
       break;
     }
     case ESP_GATTC_DISCONNECT_EVT: {
@@ -329,29 +774,81 @@ void SpheroBB8::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t ga
       this->char_handle_commands_ = 0;
       this->char_handle_responses_ = 0;
       this->write_in_progress_ = false;
-      this->current_r_ = 0xFE; 
+      // Completions of writes still pending on the old link never arrive
+      this->write_handle_ = 0;
+      this->unconfirmed_writes_ = 0;
+      // Nothing the droid showed survives the disconnect, so every target is sent again once ready
+      this->current_r_ = 0xFE;
+      this->current_g_ = 0xFE;
+      this->current_b_ = 0xFE;
+      this->current_back_brightness_ = 0xFE;
+      this->rgb_set_at_ = 0;
+      this->back_led_set_at_ = 0;
       this->version_requested_ = false;
       this->power_notify_enabled_ = false;
       this->collision_config_sent_ = false;
-      this->update_status_sensor_("Disconnected");
+      this->stream_config_sent_ = false;
+      this->odometry_.rebase();
+      this->inactivity_timeout_sent_ = false;
+      this->inactivity_timeout_set_ = false;
+      this->macro_running_ = false;
+      this->uploaded_macro_ = nullptr;
+      this->collisions_.reset_clock();
+      this->mtu_ = DEFAULT_MTU;
+      this->batching_ = this->batching_enabled_;
+      this->batch_in_flight_ = false;
+      this->rx_assembler_.reset();
+      this->tx_scheduler_.clear();
+      this->requests_.clear();
+      this->drive_speed_ = 0;
+      this->drive_pending_ = false;
+      this->driving_ = false;
+      this->current_interval_ = this->pacing_interval_;
+      this->tx_scheduler_.set_pacing(this->current_interval_, this->pacing_burst_);
+      this->rssi_ = 0;
+      this->set_status_(this->enabled_ ? STATUS_CONNECTING : STATUS_DISCONNECTED);
       this->force_lights_off_();
+      this->publish_commands_sent_();
       break;
     }
     case ESP_GATTC_WRITE_CHAR_EVT: {
-      this->write_in_progress_ = false;
       if (param->write.status != ESP_GATT_OK) {
         ESP_LOGW(TAG, "Error writing characteristic: %d", param->write.status);
+        this->metrics_.write_failures++;
+      }
+      // Writes without response complete too. Only the outstanding write with response ends the wait
+      // and settles a batch; a completion after the write timed out was already handled by loop().
+      if (!this->write_in_progress_ || param->write.handle != this->write_handle_ || this->unconfirmed_writes_ > 0) {
+        if (this->unconfirmed_writes_ > 0)
+          this->unconfirmed_writes_--;
+        break;
+      }
+      this->write_in_progress_ = false;
+      if (param->write.status != ESP_GATT_OK && this->batch_in_flight_)
+        this->disable_batching_();
+      this->batch_in_flight_ = false;
+      if (this->state_ >= ANTI_DOS && this->state_ <= WAKE)
+        this->next_handshake_step_();
+      break;
+    }
+    case ESP_GATTC_CFG_MTU_EVT: {
+      if (param->cfg_mtu.status == ESP_GATT_OK) {
+        ESP_LOGD(TAG, "MTU negotiated: %d", param->cfg_mtu.mtu);
+        this->mtu_ = param->cfg_mtu.mtu;
       }
       break;
     }
     case ESP_GATTC_REG_FOR_NOTIFY_EVT: {
       ESP_LOGI(TAG, "Registered for notifications");
+      if (this->state_ == SUBSCRIBE && param->reg_for_notify.handle == this->char_handle_responses_)
+        this->next_handshake_step_();
       break;
     }
     case ESP_GATTC_NOTIFY_EVT: {
+      this->capture_.record(CAPTURE_RX, param->notify.handle, param->notify.value, param->notify.value_len, millis());
       if (param->notify.handle == this->char_handle_responses_) {
-        std::vector<uint8_t> data(param->notify.value, param->notify.value + param->notify.value_len);
-        this->handle_packet_(data);
+        this->metrics_.count_received(param->notify.value_len);
+        this->handle_packet_(param->notify.value, param->notify.value_len);
       }
       break;
     }
@@ -360,8 +857,26 @@ void SpheroBB8::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t ga
   }
 }
 
+void SpheroBB8::gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+  if (event != ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT)
+    return;
+  if (memcmp(param->read_rssi_cmpl.remote_addr, this->parent()->get_remote_bda(), sizeof(esp_bd_addr_t)) != 0)
+    return;
+  if (param->read_rssi_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+    ESP_LOGW(TAG, "Error reading RSSI: %d", param->read_rssi_cmpl.status);
+    return;
+  }
+  this->rssi_ = param->read_rssi_cmpl.rssi;
+  ESP_LOGV(TAG, "RSSI: %ddBm", this->rssi_);
+  if (this->rssi_sensor_ != nullptr) {
+    this->rssi_sensor_->publish_state(this->rssi_);
+  }
+}
+
 void SpheroBB8::set_rgb(uint8_t r, uint8_t g, uint8_t b) {
   ESP_LOGV(TAG, "Setting RGB target: %d, %d, %d", r, g, b);
+  if (r != this->target_r_ || g != this->target_g_ || b != this->target_b_)
+    this->trace_led_target_(this->rgb_set_at_);
   this->target_r_ = r;
   this->target_g_ = g;
   this->target_b_ = b;
@@ -369,159 +884,218 @@ void SpheroBB8::set_rgb(uint8_t r, uint8_t g, uint8_t b) {
 
 void SpheroBB8::set_back_led(uint8_t brightness) {
   ESP_LOGV(TAG, "Setting Back LED target: %d", brightness);
+  if (brightness != this->target_back_brightness_)
+    this->trace_led_target_(this->back_led_set_at_);
   this->target_back_brightness_ = brightness;
 }
 
-uint8_t SpheroBB8::send_packet(uint8_t did, uint8_t cid, const std::vector<uint8_t> &data, bool wait_for_response) {
+void SpheroBB8::trace_led_target_(uint32_t &set_at) {
+  // A target replaced before loop() queued it is never sent; latency is still measured from the first one
+  if (set_at != 0) {
+    this->metrics_.led_targets_overwritten++;
+    return;
+  }
+  set_at = millis();
+}
+
+uint32_t SpheroBB8::trace_led_sync_(uint32_t &set_at, uint32_t now) {
+  uint32_t traced_at = set_at;
+  if (traced_at != 0)
+    this->latency_[LATENCY_SYNC].add(now - traced_at);
+  set_at = 0;
+  return traced_at;
+}
+
+void SpheroBB8::run_macro(const uint8_t *macro, size_t len) {
+  if (!this->is_ready()) {
+    ESP_LOGW(TAG, "Cannot run macro, Sphero BB8 is not ready");
+    return;
+  }
+  if (this->uploaded_macro_ != macro) {
+    ESP_LOGD(TAG, "Uploading LED macro (%u bytes)", (unsigned) len);
+    if (!this->tx_scheduler_.enqueue(TX_PRIORITY_LED, DID_SPHERO, CID_SAVE_TEMP_MACRO, macro, len)) {
+      ESP_LOGW(TAG, "Failed to queue LED macro upload");
+      return;
+    }
+    this->uploaded_macro_ = macro;
+  }
+  ESP_LOGD(TAG, "Running LED macro");
+  this->tx_scheduler_.enqueue<CmdRunMacro>(TX_PRIORITY_LED, {TEMP_MACRO_ID});
+  this->macro_running_ = true;
+}
+
+void SpheroBB8::abort_macro() {
+  if (!this->macro_running_)
+    return;
+  ESP_LOGD(TAG, "Aborting LED macro");
+  this->macro_running_ = false;
+  if (this->is_ready()) {
+    this->tx_scheduler_.enqueue<CmdAbortMacro>(TX_PRIORITY_LED);
+  }
+  // The macro left the LEDs in an unknown state, so the current targets are sent again
+  this->current_r_ = 0xFE;
+  this->current_g_ = 0xFE;
+  this->current_b_ = 0xFE;
+  this->current_back_brightness_ = 0xFE;
+}
+
+uint8_t SpheroBB8::send_packet(uint8_t did, uint8_t cid, const uint8_t *data, size_t len, bool wait_for_response) {
   if (this->char_handle_commands_ == 0) return 0;
+  if (len > MAX_PAYLOAD_SIZE) {
+    ESP_LOGE(TAG, "Payload too large for DID=0x%02X CID=0x%02X (%u bytes)", did, cid, (unsigned) len);
+    return 0;
+  }
 
   uint8_t seq = this->sequence_number_++;
-  uint8_t dlen = data.size() + 1;
-  uint8_t checksum = this->calculate_checksum(did, cid, seq, data);
-
-  std::vector<uint8_t> packet;
-  packet.push_back(0xFF); packet.push_back(0xFF);
-  packet.push_back(did); packet.push_back(cid);
-  packet.push_back(seq); packet.push_back(dlen);
-  packet.insert(packet.end(), data.begin(), data.end());
-  packet.push_back(checksum);
+  uint8_t packet[MAX_PACKET_SIZE];
+  size_t packet_len = encode_packet(packet, did, cid, seq, data, len);
+  this->write_packet_(did, cid, seq, packet, packet_len, wait_for_response);
+  return seq;
+}
 
+esp_err_t SpheroBB8::write_packet_(uint8_t did, uint8_t cid, uint8_t seq, uint8_t *packet, size_t len,
+                                   bool wait_for_response) {
   ESP_LOGV(TAG, "Sending packet DID=0x%02X CID=0x%02X SEQ=%d (wait=%d)", did, cid, seq, wait_for_response);
-  
-  auto write_type = wait_for_response ? ESP_GATT_WRITE_TYPE_RSP : ESP_GATT_WRITE_TYPE_NO_RSP;
 
-  if (wait_for_response) {
-    this->write_in_progress_ = true;
-    this->last_write_request_ = millis();
+  // The droid reassembles its command stream, so packets longer than one ATT payload are written in pieces
+  size_t max_write = this->mtu_ - ATT_HEADER_SIZE;
+  esp_err_t status = ESP_OK;
+  for (size_t offset = 0; offset < len && status == ESP_OK; offset += max_write) {
+    size_t chunk = std::min(len - offset, max_write);
+    bool last = offset + chunk == len;
+    status = this->write_char_(this->char_handle_commands_, packet + offset, chunk, wait_for_response && last);
   }
-
-  auto status = esp_ble_gattc_write_char(this->parent()->get_gattc_if(), this->parent()->get_conn_id(),
-                                        this->char_handle_commands_, packet.size(), packet.data(),
-                                        write_type, ESP_GATT_AUTH_REQ_NONE);
   if (status != ESP_OK) {
     ESP_LOGE(TAG, "Failed to write command: %d", status);
-    if (wait_for_response) this->write_in_progress_ = false;
+  } else {
+    this->metrics_.count_sent(did, cid, len);
   }
   this->last_packet_sent_ = millis();
-  return seq;
+  return status;
 }
 
-uint8_t SpheroBB8::calculate_checksum(uint8_t did, uint8_t cid, uint8_t seq, const std::vector<uint8_t> &data) {
-  uint32_t sum = did + cid + seq + (data.size() + 1);
-  for (uint8_t b : data) sum += b;
-  return ~(sum % 256) & 0xFF;
+// All GATT traffic goes through write_char_(), register_for_notify_() and request_mtu_(), so the BLE
+// stack is only touched in these places.
+esp_err_t SpheroBB8::write_char_(uint16_t handle, uint8_t *data, size_t len, bool with_response) {
+  this->capture_.record(CAPTURE_TX, handle, data, len, millis());
+  if (with_response) {
+    this->write_in_progress_ = true;
+    this->write_handle_ = handle;
+    this->last_write_request_ = millis();
+  }
+
+  auto status = esp_ble_gattc_write_char(this->parent()->get_gattc_if(), this->parent()->get_conn_id(), handle, len,
+                                        data, with_response ? ESP_GATT_WRITE_TYPE_RSP : ESP_GATT_WRITE_TYPE_NO_RSP,
+                                        ESP_GATT_AUTH_REQ_NONE);
+  if (status != ESP_OK) {
+    this->metrics_.write_failures++;
+    if (with_response) this->write_in_progress_ = false;
+  } else if (!with_response && this->unconfirmed_writes_ < UINT8_MAX) {
+    this->unconfirmed_writes_++;
+  }
+  return status;
 }
 
-void SpheroBB8::handle_packet_(const std::vector<uint8_t> &data) {
-  this->packet_buffer_.insert(this->packet_buffer_.end(), data.begin(), data.end());
+esp_err_t SpheroBB8::register_for_notify_(uint16_t handle) {
+  return esp_ble_gattc_register_for_notify(this->parent()->get_gattc_if(), this->parent()->get_remote_bda(), handle);
+}
 
-  while (this->packet_buffer_.size() >= 5) {
-      // Check SOP
-      if (this->packet_buffer_[0] != 0xFF || (this->packet_buffer_[1] != 0xFF && this->packet_buffer_[1] != 0xFE)) {
-          // Invalid start, shift by 1 to find next SOP
-          this->packet_buffer_.erase(this->packet_buffer_.begin());
-          continue;
-      }
+esp_err_t SpheroBB8::request_mtu_() {
+  // ble_client may already have negotiated; a second request is harmless
+  auto status = esp_ble_gattc_send_mtu_req(this->parent()->get_gattc_if(), this->parent()->get_conn_id());
+  if (status != ESP_OK) {
+    ESP_LOGV(TAG, "MTU request not sent: %d", status);
+  }
+  return status;
+}
 
-      // Parse Length
-      uint8_t sop2 = this->packet_buffer_[1];
-      size_t packet_len = 0;
+void SpheroBB8::handle_packet_(const uint8_t *data, size_t len) {
+  FrameView frame;
+  while (len > 0) {
+    size_t accepted = this->rx_assembler_.push(data, len);
+    data += accepted;
+    len -= accepted;
 
-      if (sop2 == 0xFF) { // Sync
-          uint8_t dlen = this->packet_buffer_[4];
-          packet_len = 5 + dlen;
-      } else { // Async (0xFE)
-          uint16_t dlen = (this->packet_buffer_[3] << 8) | this->packet_buffer_[4];
-          packet_len = 5 + dlen;
-      }
+    // Frames point into the assembler, so each one is processed before more bytes are pushed
+    while (this->rx_assembler_.pop(frame)) {
+      this->metrics_.frames_parsed++;
+      this->process_packet_(frame);
+    }
 
-      if (this->packet_buffer_.size() < packet_len) {
-          // Incomplete packet, wait for more data
-          return;
-      }
+    if (accepted == 0 && len > 0) {
+      ESP_LOGW(TAG, "Receive buffer full without a complete frame, discarding");
+      // Only the received bytes are dropped; queued commands and in-flight requests carry on
+      this->rx_assembler_.reset();
+    }
+  }
+}
 
-      // Extract complete packet
-      std::vector<uint8_t> packet(this->packet_buffer_.begin(), this->packet_buffer_.begin() + packet_len);
-      this->packet_buffer_.erase(this->packet_buffer_.begin(), this->packet_buffer_.begin() + packet_len);
+/// Writes `len` bytes as space separated hex into `out`, truncated to fit; returns `out`.
+static const char *format_hex(const uint8_t *data, size_t len, char *out, size_t out_size) {
+  size_t pos = 0;
+  for (size_t i = 0; i < len && pos + 3 < out_size; i++) {
+    pos += snprintf(out + pos, out_size - pos, i == 0 ? "%02X" : " %02X", data[i]);
+  }
+  out[pos] = '\0';
+  return out;
+}
 
-      this->process_packet_(packet);
+void SpheroBB8::log_frame_(const FrameView &data) {
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_DEBUG
+  // Simple ACKs (FF FF 00 SEQ 01 CHK) and streamed sensor data arrive continuously, so they are only
+  // dumped at VERBOSE. The hex is only formatted when the line is actually logged.
+  bool routine = (data.size() == 6 && data[0] == 0xFF && data[1] == 0xFF && data[2] == 0x00 && data[4] == 0x01) ||
+                 (data.size() >= 5 && data[1] == 0xFE && data[2] == 0x03);
+#if ESPHOME_LOG_LEVEL < ESPHOME_LOG_LEVEL_VERBOSE
+  if (routine)
+    return;
+#endif
+  char hex[MAX_PACKET_SIZE * 3];
+  format_hex(data.data, data.size(), hex, sizeof(hex));
+  if (routine) {
+    ESP_LOGV(TAG, "Processing Packet: %s", hex);
+  } else {
+    ESP_LOGD(TAG, "Processing Packet: %s", hex);
   }
+#endif
 }
 
-void SpheroBB8::process_packet_(const std::vector<uint8_t> &data) {
-  // Debug dump
-  std::string hex_dump = "";
-  for (uint8_t b : data) {
-    char buf[4];
-    sprintf(buf, "%02X ", b);
-    hex_dump += buf;
+void SpheroBB8::dump_capture() {
+  ESP_LOGI(TAG, "Capture: %u records (%u since boot), oldest first", (unsigned) this->capture_.size(),
+           (unsigned) this->capture_.get_total());
+  char hex[CaptureRecord::DATA_SIZE * 3];
+  for (size_t i = 0; i < this->capture_.size(); i++) {
+    const CaptureRecord &record = this->capture_.get(i);
+    size_t shown = record.len < CaptureRecord::DATA_SIZE ? record.len : CaptureRecord::DATA_SIZE;
+    ESP_LOGI(TAG, "CAP %u %s 0x%04X %u: %s%s", (unsigned) record.time, record.direction == CAPTURE_TX ? "TX" : "RX",
+             record.handle, record.len, format_hex(record.data, shown, hex, sizeof(hex)),
+             shown < record.len ? " .." : "");
   }
-  // Check if it's a simple ACK packet (SOP1=FF, SOP2=FF, MRSP=00, SEQ, DLEN=01, CHK)
-  // 6 bytes total, no payload, success code.
-  if (data.size() == 6 && data[0] == 0xFF && data[1] == 0xFF && data[2] == 0x00 && data[4] == 0x01) {
-    ESP_LOGV(TAG, "Processing Packet: %s", hex_dump.c_str());
-  } else {
-    ESP_LOGD(TAG, "Processing Packet: %s", hex_dump.c_str());
+
+  ESP_LOGI(TAG, "Collisions: %u events (%u since boot), oldest first", (unsigned) this->collisions_.size(),
+           (unsigned) this->collisions_.get_total());
+  for (size_t i = 0; i < this->collisions_.size(); i++) {
+    const CollisionEvent &event = this->collisions_.get(i);
+    ESP_LOGI(TAG, "COL %u X=%d Y=%d Z=%d Axis=0x%02X MagX=%d MagY=%d Speed=%u", (unsigned) event.time, event.x,
+             event.y, event.z, event.axis, event.mag_x, event.mag_y, event.speed);
   }
+}
+
+void SpheroBB8::process_packet_(const FrameView &data) {
+  this->log_frame_(data);
+
+  if (data.size() <= FrameView::HEADER_SIZE) return;
 
-  if (data.size() < 5) return;
-  
   // Async Packet (Notification)
   if (data[0] == 0xFF && data[1] == 0xFE) {
-     uint8_t id_code = data[2];
-     uint16_t length = (data[3] << 8) | data[4];
-     
-     // Async Power Notification
-     if (id_code == 0x01 && length >= 1) {
-         uint8_t state = data[5];
-         ESP_LOGI(TAG, "Received Async Power Notification: State=0x%02X", state);
-         
-         if (this->charging_status_sensor_ != nullptr) {
-            std::string status = "Unknown";
-            if (state == 0x01) status = "Charging";
-            else if (state == 0x02) status = "OK";
-            else if (state == 0x03) status = "Low";
-            else if (state == 0x04) status = "Critical";
-            this->charging_status_sensor_->publish_state(status);
-         }
-    
-         if (this->battery_sensor_ != nullptr) {
-            float level = 0.0f;
-            if (state == 0x01) return; // Don't jump to 100% when charging starts, wait for poll
-            else if (state == 0x02) level = 100.0f;
-            else if (state == 0x03) level = 10.0f;
-            else if (state == 0x04) level = 1.0f;
-            this->battery_sensor_->publish_state(level);
-         }
-     }
-     // Async Collision Notification
-     else if (id_code == 0x07 && length >= 1) {
-         ESP_LOGI(TAG, "Received Async Collision Notification");
-         if (this->collision_sensor_ != nullptr) {
-             this->collision_sensor_->publish_state(true);
-             this->last_collision_time_ = millis();
-         }
-
-         // Payload parsing (Standard 16-byte structure)
-         // X(2), Y(2), Z(2), Axis(1), MagX(2), MagY(2), Speed(1), Time(4)
-         if (data.size() >= 5 + 16) { 
-             int16_t mag_x = (int16_t)((data[12] << 8) | data[13]);
-             int16_t mag_y = (int16_t)((data[14] << 8) | data[15]);
-             uint8_t speed = data[16];
-             
-             ESP_LOGD(TAG, "Collision Data: MagX=%d MagY=%d Speed=%d", mag_x, mag_y, speed);
-             
-             if (this->collision_speed_sensor_ != nullptr) {
-                 this->collision_speed_sensor_->publish_state(speed);
-             }
-             
-             if (this->collision_magnitude_sensor_ != nullptr) {
-                 float magnitude = std::sqrt(mag_x*mag_x + mag_y*mag_y);
-                 this->collision_magnitude_sensor_->publish_state(magnitude);
-             }
-         }
-     }
-     return;
+    uint8_t id_code = data[2];
+    AsyncHandler handler = this->async_dispatcher_.find(id_code);
+    if (handler == nullptr) {
+      ESP_LOGV(TAG, "No decoder for async ID 0x%02X (%u bytes)", id_code, (unsigned) data.payload_size());
+      return;
+    }
+    (this->*handler)(data);
+    return;
   }
 
   // Sync Packet (Response)
@@ -529,73 +1103,324 @@ void SpheroBB8::process_packet_(const std::vector<uint8_t> &data) {
 
   uint8_t mrp = data[2];
   uint8_t seq = data[3];
-  uint8_t dlen = data[4];
-  
+
+  PendingRequest pending;
+  if (!this->requests_.complete(seq, millis(), pending)) {
+    ESP_LOGV(TAG, "Ignoring unsolicited response for sequence %d", seq);
+    return;
+  }
+
   if (mrp != 0x00) {
     ESP_LOGW(TAG, "Received error response code: 0x%02X for sequence %d", mrp, seq);
+    // A failed attempt, like a timeout: the caller gets its retries and then its timeout handler
+    if (pending.request.on_response != nullptr)
+      this->retry_request_(pending.request, "failed");
     return;
   }
 
-  if (data.size() < 5 + dlen) return;
+  if (pending.request.traced_at != 0)
+    this->latency_[LATENCY_ACK].add(millis() - pending.request.traced_at);
 
-  if (seq == this->power_req_seq_) {
-    if (dlen >= 3) {
-      uint8_t rec_ver = data[5];
-      uint8_t power_state = data[6];
-      uint16_t voltage_raw = (data[7] << 8) | data[8];
-      float voltage = voltage_raw / 100.0f;
-      ESP_LOGD(TAG, "Received Power State: RecVer=0x%02X, PowerState=0x%02X, Voltage=%.2fV", rec_ver, power_state, voltage);
+  if (pending.request.on_response != nullptr) {
+    this->response_rtt_ = millis() - pending.sent_at;
+    (this->*pending.request.on_response)(data);
+  }
+}
 
-      if (this->charging_status_sensor_ != nullptr) {
-        std::string status = "Unknown";
-        if (power_state == 0x01) status = "Charging";
-        else if (power_state == 0x02) status = "OK";
-        else if (power_state == 0x03) status = "Low";
-        else if (power_state == 0x04) status = "Critical";
-        this->charging_status_sensor_->publish_state(status);
-      }
+uint32_t SpheroBB8::get_metric_(MetricSensor metric) const {
+  switch (metric) {
+    case METRIC_PACKETS_SENT:
+      return this->metrics_.packets_sent;
+    case METRIC_BYTES_SENT:
+      return this->metrics_.bytes_sent;
+    case METRIC_NOTIFICATIONS_RECEIVED:
+      return this->metrics_.notifications_received;
+    case METRIC_BYTES_RECEIVED:
+      return this->metrics_.bytes_received;
+    case METRIC_FRAMES_PARSED:
+      return this->metrics_.frames_parsed;
+    case METRIC_RESYNC_BYTES:
+      return this->rx_assembler_.get_resync_bytes();
+    case METRIC_CHECKSUM_FAILURES:
+      return this->rx_assembler_.get_checksum_failures();
+    case METRIC_WRITE_FAILURES:
+      return this->metrics_.write_failures;
+    case METRIC_WRITE_TIMEOUTS:
+      return this->metrics_.write_timeouts;
+    case METRIC_KEEPALIVE_PINGS:
+      return this->metrics_.keepalive_pings;
+    case METRIC_LED_UPDATES_COALESCED:
+      return this->tx_scheduler_.get_coalesced_count(TX_PRIORITY_LED);
+    case METRIC_BATCHED_WRITES:
+      return this->metrics_.batched_writes;
+    case METRIC_ASYNC_UNKNOWN:
+      return this->async_dispatcher_.get_unknown();
+    case METRIC_LED_TARGETS_OVERWRITTEN:
+      return this->metrics_.led_targets_overwritten;
+    default:
+      return 0;
+  }
+}
 
-      if (this->battery_sensor_ != nullptr) {
-        float level = 0.0f;
-        
-        // Estimate level from voltage
-        // For 2S: 7.0V (empty) to 8.4V (full)
-        // For 1S: 3.5V (empty) to 4.2V (full)
-        if (voltage > 5.0f) { // Likely 2S
-            level = (voltage - 7.0f) / (8.4f - 7.0f) * 100.0f;
-        } else if (voltage > 2.0f) { // Likely 1S
-            level = (voltage - 3.5f) / (4.2f - 3.5f) * 100.0f;
-        }
-        
-        if (level > 100.0f) level = 100.0f;
-        if (level < 0.0f) level = 0.0f;
-        
-        // If we don't have a good voltage (e.g. 0), fallback to state
-        if (voltage < 1.0f) {
-            if (power_state == 0x01 || power_state == 0x02) level = 100.0f;
-            else if (power_state == 0x03) level = 10.0f;
-            else if (power_state == 0x04) level = 1.0f;
-        }
-
-        this->battery_sensor_->publish_state(level);
-      }
+void SpheroBB8::publish_metrics_() {
+  if (this->loop_time_sensor_ != nullptr) {
+    // Average time per loop() pass since the last publish. No passes at all means the loop was idle.
+    uint32_t passes = this->metrics_.loop_passes;
+    ESP_LOGD(TAG, "Loop: %u passes, avg %uus, max %uus", (unsigned) passes,
+             (unsigned) (passes > 0 ? this->metrics_.loop_time_us / passes : 0),
+             (unsigned) this->metrics_.loop_time_max_us);
+    this->loop_time_sensor_->publish_state(passes > 0 ? (float) this->metrics_.loop_time_us / passes : 0.0f);
+    this->metrics_.reset_loop();
+  }
+
+  for (uint8_t i = 0; i < METRIC_COUNT; i++) {
+    if (this->metric_sensors_[i] != nullptr) {
+      this->metric_sensors_[i]->publish_state(this->get_metric_(static_cast<MetricSensor>(i)));
     }
-  } 
-  else if (seq == this->version_req_seq_) {
-     if (dlen >= 5 && data.size() >= 10) {
-       uint8_t maj = data[8];
-       uint8_t min = data[9];
-       char buffer[16];
-       // BB-8 (Ray) firmware version is reported as Major.Minor (e.g., 4.69).
-       // The official Android app appends a ".0" revision to this for display.
-       snprintf(buffer, sizeof(buffer), "%d.%d.0", maj, min);
-       ESP_LOGI(TAG, "Received Firmware Version: %s (Raw DLEN=%d)", buffer, dlen);
-       if (this->version_sensor_ != nullptr) {
-         this->version_sensor_->publish_state(buffer);
-       }
-     } else {
-       ESP_LOGW(TAG, "Received Version packet but too short (DLEN=%d, Size=%d)", dlen, data.size());
-     }
+  }
+
+  // Publishing text allocates, so the command counts wait until the connection ends
+  if (this->state_ != READY)
+    this->publish_commands_sent_();
+
+  // LED latency over the last interval, from set_rgb()/set_back_led() to each point on the way to the droid
+  for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+    LatencyHistogram &histogram = this->latency_[i];
+    if (histogram.get_count() > 0) {
+      ESP_LOGD(TAG, "LED latency until %s: p50 %ums, p95 %ums, max %ums (%u changes)", LATENCY_STAGE_NAMES[i],
+               (unsigned) histogram.get_percentile(0.5f), (unsigned) histogram.get_percentile(0.95f),
+               (unsigned) histogram.get_max(), (unsigned) histogram.get_count());
+    }
+  }
+  const LatencyHistogram &ack = this->latency_[LATENCY_ACK];
+  if (ack.get_count() > 0) {
+    uint32_t values[LATENCY_SENSOR_COUNT] = {ack.get_percentile(0.5f), ack.get_percentile(0.95f), ack.get_max()};
+    for (uint8_t i = 0; i < LATENCY_SENSOR_COUNT; i++) {
+      if (this->latency_sensors_[i] != nullptr)
+        this->latency_sensors_[i]->publish_state(values[i]);
+    }
+  }
+  for (auto &histogram : this->latency_)
+    histogram.reset();
+}
+
+void SpheroBB8::publish_commands_sent_() {
+  if (this->commands_sent_sensor_ == nullptr)
+    return;
+  // "DID:CID=packets" per command, e.g. "02:20=1234 00:01=56"
+  char buffer[Metrics::COMMAND_CAPACITY * 16];
+  size_t pos = 0;
+  buffer[0] = '\0';
+  for (size_t i = 0; i < this->metrics_.command_count && pos < sizeof(buffer); i++) {
+    const CommandCounter &counter = this->metrics_.commands[i];
+    pos += snprintf(buffer + pos, sizeof(buffer) - pos, "%s%02X:%02X=%u", i > 0 ? " " : "", counter.did,
+                    counter.cid, (unsigned) counter.packets);
+  }
+  if (this->commands_sent_sensor_->state != buffer)
+    this->commands_sent_sensor_->publish_state(buffer);
+}
+
+void SpheroBB8::handle_inactivity_timeout_(const FrameView &frame) {
+  ESP_LOGD(TAG, "Inactivity timeout accepted, keepalive ping every %us", (unsigned) (this->liveness_interval_ / 1000));
+  this->inactivity_timeout_set_ = true;
+}
+
+void SpheroBB8::send_link_probe_(uint32_t now) {
+  this->last_probe_ = now;
+  TxRequest probe{};
+  probe.did = CmdPing::DEVICE_ID;
+  probe.cid = CmdPing::COMMAND_ID;
+  probe.priority = TX_PRIORITY_TELEMETRY;
+  probe.on_response = &SpheroBB8::handle_link_probe_;
+  probe.on_timeout = &SpheroBB8::handle_link_probe_timeout_;
+  this->tx_scheduler_.enqueue(probe);
+
+  auto status = esp_ble_gap_read_rssi(this->parent()->get_remote_bda());
+  if (status != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to request RSSI: %d", status);
+  }
+}
+
+void SpheroBB8::handle_link_probe_(const FrameView &frame) {
+  ESP_LOGV(TAG, "Link probe RTT: %ums", (unsigned) this->response_rtt_);
+  if (this->link_rtt_sensor_ != nullptr) {
+    this->link_rtt_sensor_->publish_state(this->response_rtt_);
+  }
+  bool weak_signal = this->rssi_ != 0 && this->rssi_ < this->pacing_min_rssi_;
+  this->adapt_pacing_(this->response_rtt_ > this->pacing_target_rtt_ || weak_signal);
+}
+
+void SpheroBB8::handle_link_probe_timeout_(const TxRequest &request) {
+  ESP_LOGD(TAG, "Link probe lost");
+  this->adapt_pacing_(true);
+}
+
+void SpheroBB8::adapt_pacing_(bool congested) {
+  // AIMD on the send interval: back off multiplicatively, recover additively
+  uint32_t interval = this->current_interval_;
+  if (congested) {
+    interval *= 2;
+  } else if (interval > this->pacing_min_interval_) {
+    interval -= 5;
+  }
+  interval = clamp(interval, this->pacing_min_interval_, this->pacing_max_interval_);
+
+  if (interval != this->current_interval_) {
+    ESP_LOGD(TAG, "Pacing interval %ums -> %ums", (unsigned) this->current_interval_, (unsigned) interval);
+    this->current_interval_ = interval;
+    this->tx_scheduler_.set_pacing(interval, this->pacing_burst_);
+  }
+  if (this->pacing_interval_sensor_ != nullptr) {
+    this->pacing_interval_sensor_->publish_state(interval);
+  }
+}
+
+void SpheroBB8::publish_charging_status_(uint8_t power_state) {
+  // Text sensors copy their state into a std::string, so only changes are published
+  if (this->charging_status_sensor_ == nullptr || power_state == this->charging_state_)
+    return;
+  this->charging_state_ = power_state;
+  const char *status = "Unknown";
+  switch (power_state) {
+    case POWER_STATE_CHARGING:
+      status = "Charging";
+      break;
+    case POWER_STATE_OK:
+      status = "OK";
+      break;
+    case POWER_STATE_LOW:
+      status = "Low";
+      break;
+    case POWER_STATE_CRITICAL:
+      status = "Critical";
+      break;
+  }
+  this->charging_status_sensor_->publish_state(status);
+}
+
+void SpheroBB8::handle_power_notification_(const FrameView &data) {
+  if (data.payload_size() < 1)
+    return;
+  uint8_t state = data.payload()[0];
+  ESP_LOGI(TAG, "Received Async Power Notification: State=0x%02X", state);
+  this->publish_charging_status_(state);
+  this->battery_.set_power_state(state);
+  // The droid just told us its state, so the next poll can wait a full interval
+  this->last_power_check_ = millis();
+
+  // Don't jump to 100% when charging starts, wait for the next poll
+  if (this->battery_sensor_ != nullptr && state != POWER_STATE_CHARGING) {
+    this->battery_sensor_->publish_state(BatteryMonitor::power_state_level(state));
+  }
+}
+
+void SpheroBB8::handle_diagnostic_(const FrameView &data) {
+  // Level 1 diagnostics are plain ASCII text
+  ESP_LOGD(TAG, "Diagnostics: %.*s", (int) data.payload_size(), reinterpret_cast<const char *>(data.payload()));
+}
+
+void SpheroBB8::handle_sensor_data_(const FrameView &data) {
+  size_t samples = this->data_stream_.decode(data.payload(), data.payload_size());
+  // Frames carry one sample each (M = 1), so the latest values cover the whole frame
+  if (samples > 0 && this->odometry_.is_enabled()) {
+    this->odometry_.update(this->data_stream_.get_value(STREAM_YAW), this->data_stream_.get_value(STREAM_VELOCITY_X),
+                           this->data_stream_.get_value(STREAM_VELOCITY_Y), millis());
+  }
+}
+
+void SpheroBB8::handle_pre_sleep_warning_(const FrameView &data) {
+  ESP_LOGW(TAG, "Droid reports it will go to sleep in 10 seconds");
+}
+
+void SpheroBB8::handle_macro_marker_(const FrameView &data) {
+  // Marker(1), MacroID(1), Command number(2)
+  if (data.payload_size() < 4)
+    return;
+  const uint8_t *payload = data.payload();
+  ESP_LOGD(TAG, "Macro 0x%02X reached marker %u at command %u", payload[1], payload[0],
+           (unsigned) ((payload[2] << 8) | payload[3]));
+}
+
+void SpheroBB8::handle_collision_(const FrameView &data) {
+  uint32_t now = millis();
+  ESP_LOGI(TAG, "Received Async Collision Notification");
+  if (this->collision_sensor_ != nullptr) {
+    this->collision_sensor_->publish_state(true);
+    this->last_collision_time_ = now;
+  }
+
+  if (!this->collisions_.decode(data.payload(), data.payload_size(), now))
+    return;
+  const CollisionEvent &event = this->collisions_.get_latest();
+  ESP_LOGD(TAG, "Collision Data: X=%d Y=%d Z=%d Axis=0x%02X MagX=%d MagY=%d Speed=%d at %ums (droid %ums)", event.x,
+           event.y, event.z, event.axis, event.mag_x, event.mag_y, event.speed, (unsigned) event.time,
+           (unsigned) event.droid_time);
+
+  if (!this->collision_pending_ || event.get_magnitude() > this->collision_peak_.get_magnitude()) {
+    this->collision_peak_ = event;
+  }
+  this->collision_pending_ = true;
+  this->publish_collision_(now);
+}
+
+void SpheroBB8::publish_collision_(uint32_t now) {
+  // The first impact after a quiet period goes out immediately, the rest of a burst is coalesced
+  if (!this->collision_pending_ || now - this->last_collision_publish_ < this->collision_publish_interval_)
+    return;
+  this->collision_pending_ = false;
+  this->last_collision_publish_ = now;
+
+  if (this->collision_speed_sensor_ != nullptr) {
+    this->collision_speed_sensor_->publish_state(this->collision_peak_.speed);
+  }
+
+  if (this->collision_magnitude_sensor_ != nullptr) {
+    this->collision_magnitude_sensor_->publish_state(this->collision_peak_.get_magnitude());
+  }
+}
+
+void SpheroBB8::handle_power_state_(const FrameView &data) {
+  // RecVer(1), PowerState(1), Voltage(2), ...
+  const uint8_t *payload = data.payload();
+  if (data.payload_size() >= 4) {
+    uint8_t rec_ver = payload[0];
+    uint8_t power_state = payload[1];
+    uint16_t voltage_raw = (payload[2] << 8) | payload[3];
+    float voltage = voltage_raw / 100.0f;
+    ESP_LOGD(TAG, "Received Power State: RecVer=0x%02X, PowerState=0x%02X, Voltage=%.2fV", rec_ver, power_state, voltage);
+
+    this->publish_charging_status_(power_state);
+
+    float level = this->battery_.add_sample(power_state, voltage, millis());
+    if (this->battery_sensor_ != nullptr) {
+      this->battery_sensor_->publish_state(level);
+    }
+    if (this->discharge_rate_sensor_ != nullptr) {
+      this->discharge_rate_sensor_->publish_state(this->battery_.get_discharge_rate());
+    }
+    if (this->time_remaining_sensor_ != nullptr) {
+      this->time_remaining_sensor_->publish_state(this->battery_.get_time_remaining());
+    }
+  }
+}
+
+void SpheroBB8::handle_version_(const FrameView &data) {
+  // RECV(1), MDL(1), HW(1), MSA-ver(1), MSA-rev(1), ...
+  const uint8_t *payload = data.payload();
+  uint8_t dlen = data[4];
+  if (data.payload_size() >= 5) {
+    uint8_t maj = payload[3];
+    uint8_t min = payload[4];
+    char buffer[16];
+    // BB-8 (Ray) firmware version is reported as Major.Minor (e.g., 4.69).
+    // The official Android app appends a ".0" revision to this for display.
+    snprintf(buffer, sizeof(buffer), "%d.%d.0", maj, min);
+    ESP_LOGI(TAG, "Received Firmware Version: %s (Raw DLEN=%d)", buffer, dlen);
+    if (this->version_sensor_ != nullptr) {
+      this->version_sensor_->publish_state(buffer);
+    }
+  } else {
+    ESP_LOGW(TAG, "Received Version packet but too short (DLEN=%d, Size=%d)", dlen, (int) data.size());
   }
 }
 
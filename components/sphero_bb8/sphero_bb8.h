@@ -7,6 +7,19 @@
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/button/button.h"
+#include "sphero_bb8_airtime.h"
+#include "sphero_bb8_async.h"
+#include "sphero_bb8_battery.h"
+#include "sphero_bb8_capture.h"
+#include "sphero_bb8_collision.h"
+#include "sphero_bb8_latency.h"
+#include "sphero_bb8_metrics.h"
+#include "sphero_bb8_odometry.h"
+#include "sphero_bb8_parser.h"
+#include "sphero_bb8_protocol.h"
+#include "sphero_bb8_requests.h"
+#include "sphero_bb8_scheduler.h"
+#include "sphero_bb8_stream.h"
 
 #include <vector>
 
@@ -17,6 +30,21 @@ namespace espbt = esphome::esp32_ble_tracker;
 
 class SpheroBB8Light;
 
+/// Connection status shown by the status text sensor.
+enum HubStatus : uint8_t {
+  STATUS_DISCONNECTED,
+  STATUS_CONNECTING,
+  STATUS_CONNECTED,
+  STATUS_INITIALIZING,
+  STATUS_READY,
+  STATUS_DISABLING,
+};
+
+enum PacingMode : uint8_t {
+  PACING_MODE_FIXED,
+  PACING_MODE_ADAPTIVE,
+};
+
 class SpheroBB8 : public Component, public ble_client::BLEClientNode {
  public:
   void setup() override;
@@ -26,17 +54,67 @@ class SpheroBB8 : public Component, public ble_client::BLEClientNode {
 
   void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
                            esp_ble_gattc_cb_param_t *param) override;
+  void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) override;
 
   void set_rgb(uint8_t r, uint8_t g, uint8_t b);
   void set_back_led(uint8_t brightness);
+  /// Uploads `macro` to the temporary macro slot (skipped if it is already there) and runs it.
+  /// LED syncing is paused until the macro is aborted.
+  void run_macro(const uint8_t *macro, size_t len);
+  void abort_macro();
+  bool is_macro_running() const { return macro_running_; }
 
   void set_status_sensor(text_sensor::TextSensor *sensor) { status_sensor_ = sensor; }
   void set_battery_sensor(sensor::Sensor *sensor) { battery_sensor_ = sensor; }
+  void set_discharge_rate_sensor(sensor::Sensor *sensor) { discharge_rate_sensor_ = sensor; }
+  void set_time_remaining_sensor(sensor::Sensor *sensor) { time_remaining_sensor_ = sensor; }
   void set_version_sensor(text_sensor::TextSensor *sensor) { version_sensor_ = sensor; }
   void set_charging_status_sensor(text_sensor::TextSensor *sensor) { charging_status_sensor_ = sensor; }
   void set_collision_sensor(binary_sensor::BinarySensor *sensor) { collision_sensor_ = sensor; }
   void set_collision_speed_sensor(sensor::Sensor *sensor) { collision_speed_sensor_ = sensor; }
   void set_collision_magnitude_sensor(sensor::Sensor *sensor) { collision_magnitude_sensor_ = sensor; }
+  /// Updates the collision thresholds; they are resent to a connected droid right away.
+  void set_collision_config(uint8_t x_threshold, uint8_t x_speed, uint8_t y_threshold, uint8_t y_speed,
+                            uint32_t dead_time);
+  const CollisionConfig &get_collision_config() const { return this->collision_config_; }
+  /// Collision speed and magnitude are published at most once per interval, with the strongest
+  /// impact of a burst.
+  void set_collision_publish_interval(uint32_t interval) { collision_publish_interval_ = interval; }
+  const CollisionTracker &get_collisions() const { return this->collisions_; }
+  void set_pacing_interval_sensor(sensor::Sensor *sensor) { pacing_interval_sensor_ = sensor; }
+  void set_link_rtt_sensor(sensor::Sensor *sensor) { link_rtt_sensor_ = sensor; }
+  void set_rssi_sensor(sensor::Sensor *sensor) { rssi_sensor_ = sensor; }
+  void set_handshake_time_sensor(sensor::Sensor *sensor) { handshake_time_sensor_ = sensor; }
+  void set_loop_time_sensor(sensor::Sensor *sensor) { loop_time_sensor_ = sensor; }
+  void set_latency_sensor(LatencySensor statistic, sensor::Sensor *sensor) { latency_sensors_[statistic] = sensor; }
+  void set_metric_sensor(MetricSensor metric, sensor::Sensor *sensor) { metric_sensors_[metric] = sensor; }
+  void set_commands_sent_sensor(text_sensor::TextSensor *sensor) { commands_sent_sensor_ = sensor; }
+  void set_metrics_interval(uint32_t interval) { metrics_interval_ = interval; }
+  void set_stream_sensor(StreamChannel channel, sensor::Sensor *sensor) { data_stream_.set_sensor(channel, sensor); }
+  void set_stream_sample_rate(uint16_t rate) { data_stream_.set_sample_rate(rate); }
+  void set_stream_publish_interval(uint32_t interval) { data_stream_.set_publish_interval(interval); }
+  void set_odometry_x_sensor(sensor::Sensor *sensor) { odometry_.set_x_sensor(sensor); }
+  void set_odometry_y_sensor(sensor::Sensor *sensor) { odometry_.set_y_sensor(sensor); }
+  void set_odometry_heading_sensor(sensor::Sensor *sensor) { odometry_.set_heading_sensor(sensor); }
+  void set_odometry_distance_sensor(sensor::Sensor *sensor) { odometry_.set_distance_sensor(sensor); }
+  void set_odometry_min_distance(float min_distance) { odometry_.set_min_distance(min_distance); }
+  void set_odometry_min_heading(float min_heading) { odometry_.set_min_heading(min_heading); }
+
+  void set_pacing_mode(PacingMode mode) { pacing_mode_ = mode; }
+  void set_pacing_interval(uint32_t interval) { pacing_interval_ = interval; }
+  void set_pacing_min_interval(uint32_t interval) { pacing_min_interval_ = interval; }
+  void set_pacing_max_interval(uint32_t interval) { pacing_max_interval_ = interval; }
+  void set_pacing_burst(uint8_t burst) { pacing_burst_ = burst; }
+  void set_pacing_target_rtt(uint32_t rtt) { pacing_target_rtt_ = rtt; }
+  void set_pacing_min_rssi(int8_t rssi) { pacing_min_rssi_ = rssi; }
+  void set_probe_interval(uint32_t interval) { probe_interval_ = interval; }
+  void set_inactivity_timeout(uint16_t timeout) { inactivity_timeout_ = timeout; }
+  void set_liveness_interval(uint32_t interval) { liveness_interval_ = interval; }
+  /// Minimum gap between writes of all hubs on this controller.
+  void set_airtime_interval(uint32_t interval) { airtime_interval_ = interval; }
+  /// Concatenate queued packets into one write when they fit the negotiated MTU.
+  void set_batching(bool batching) { batching_enabled_ = batching; }
+  void set_cache_services(bool cache_services) { cache_services_ = cache_services; }
   
   void set_auto_connect(bool auto_connect) { auto_connect_ = auto_connect; }
   void set_enabled(bool enabled) { enabled_ = enabled; }
@@ -45,17 +123,75 @@ class SpheroBB8 : public Component, public ble_client::BLEClientNode {
   void connect();
   void disconnect();
   void center_head();
+  /// Logs the captured BLE traffic; decode it with scripts/decode_capture.py.
+  void dump_capture();
+  /// Zeroes the odometry pose; the droid's current position and direction become the origin.
+  void reset_odometry();
+
+  /// Sets the drive setpoint: speed 0-255, heading 0-359 degrees. Setpoints must keep arriving
+  /// within the deadman window or the droid is stopped.
+  void drive(uint8_t speed, uint16_t heading);
+  void stop();
+  void set_drive_deadman(uint32_t deadman) { drive_deadman_ = deadman; }
 
   bool is_ready() const { return state_ == READY; }
 
+  uint32_t get_checksum_failures() const { return this->rx_assembler_.get_checksum_failures(); }
+  uint32_t get_resync_bytes() const { return this->rx_assembler_.get_resync_bytes(); }
+  const Metrics &get_metrics() const { return this->metrics_; }
+
  protected:
-  uint8_t send_packet(uint8_t did, uint8_t cid, const std::vector<uint8_t> &data, bool wait_for_response = false);
-  uint8_t calculate_checksum(uint8_t did, uint8_t cid, uint8_t seq, const std::vector<uint8_t> &data);
-  void update_status_sensor_(const std::string &status);
+  uint8_t send_packet(uint8_t did, uint8_t cid, const uint8_t *data, size_t len, bool wait_for_response = false);
+  void flush_tx_queue_(uint32_t now);
+  void send_request_(uint32_t now, const TxRequest &request);
+  void send_batch_(uint32_t now, TxRequest &request, size_t limit);
+  void disable_batching_();
+  void track_request_(uint8_t seq, const TxRequest &request, uint32_t now);
+  esp_err_t write_packet_(uint8_t did, uint8_t cid, uint8_t seq, uint8_t *packet, size_t len,
+                          bool wait_for_response);
+  esp_err_t write_char_(uint16_t handle, uint8_t *data, size_t len, bool with_response);
+  esp_err_t register_for_notify_(uint16_t handle);
+  esp_err_t request_mtu_();
+  void set_status_(HubStatus status);
+  void start_handshake_();
+  void run_handshake_step_();
+  void next_handshake_step_();
+  void send_readiness_probe_();
+  void handle_readiness_probe_(const FrameView &frame);
+  void handle_readiness_probe_timeout_(const TxRequest &request);
+  void enter_ready_();
+  void start_disabling_();
+  void loop_ready_(uint32_t now);
+  void housekeeping_(uint32_t now);
   void force_lights_off_();
-  void handle_packet_(const std::vector<uint8_t> &data);
-  void process_packet_(const std::vector<uint8_t> &packet);
+  void handle_packet_(const uint8_t *data, size_t len);
+  void process_packet_(const FrameView &packet);
+  void log_frame_(const FrameView &frame);
+  void expire_requests_(uint32_t now);
+  void retry_request_(TxRequest &request, const char *reason);
+  void publish_charging_status_(uint8_t power_state);
+  void handle_power_notification_(const FrameView &frame);
+  void handle_diagnostic_(const FrameView &frame);
+  void handle_sensor_data_(const FrameView &frame);
+  void handle_pre_sleep_warning_(const FrameView &frame);
+  void handle_macro_marker_(const FrameView &frame);
+  void handle_collision_(const FrameView &frame);
+  void publish_collision_(uint32_t now);
+  void handle_power_state_(const FrameView &frame);
+  void handle_version_(const FrameView &frame);
+  void handle_inactivity_timeout_(const FrameView &frame);
+  void send_link_probe_(uint32_t now);
+  void handle_link_probe_(const FrameView &frame);
+  void handle_link_probe_timeout_(const TxRequest &request);
+  void adapt_pacing_(bool congested);
+  void sync_drive_(uint32_t now);
+  void trace_led_target_(uint32_t &set_at);
+  uint32_t trace_led_sync_(uint32_t &set_at, uint32_t now);
+  uint32_t get_metric_(MetricSensor metric) const;
+  void publish_metrics_();
+  void publish_commands_sent_();
   void configure_collision_detection_();
+  bool discover_handles_();
 
   enum State {
     DISCONNECTED,
@@ -69,43 +205,149 @@ class SpheroBB8 : public Component, public ble_client::BLEClientNode {
     DISABLING,
   } state_{DISCONNECTED};
 
+  /// One GATT operation of the connection handshake. A step without payload subscribes to the
+  /// characteristic; the others write the payload with response.
+  struct HandshakeStep {
+    State state;
+    const char *name;
+    uint16_t SpheroBB8::*handle;
+    const uint8_t *payload;
+    uint8_t len;
+    /// Skipped when the droid does not have the characteristic.
+    bool optional;
+  };
+  static const HandshakeStep HANDSHAKE_STEPS[];
+  static const size_t HANDSHAKE_STEP_COUNT;
+  size_t handshake_step_{0};
+  HubStatus status_{STATUS_DISCONNECTED};
+  bool status_published_{false};
+  /// Set when the droid becomes ready, cleared once the first Set RGB is sent.
+  bool restore_pending_{false};
+  uint32_t last_housekeeping_{0};
+
   uint16_t char_handle_anti_dos_{0};
   uint16_t char_handle_tx_power_{0};
   uint16_t char_handle_wake_{0};
   uint16_t char_handle_commands_{0};
   uint16_t char_handle_responses_{0};
+  uint16_t mtu_{23};
 
   uint32_t last_state_change_{0};
+  uint32_t connected_at_{0};
   uint32_t last_write_request_{0};
   uint32_t last_packet_sent_{0};
   uint32_t last_power_check_{0};
+  BatteryMonitor battery_;
   uint32_t last_collision_time_{0};
+  CollisionConfig collision_config_;
+  CollisionTracker collisions_;
+  /// Strongest impact since speed and magnitude were last published.
+  CollisionEvent collision_peak_{};
+  bool collision_pending_{false};
+  uint32_t collision_publish_interval_{250};
+  uint32_t last_collision_publish_{0};
   uint8_t sequence_number_{0};
   bool write_in_progress_{false};
+  /// Handle of the outstanding write with response.
+  uint16_t write_handle_{0};
+  /// Writes without response whose WRITE_CHAR_EVT has not arrived yet. Those events come before the
+  /// one of a later write with response, so they are not taken for its completion.
+  uint8_t unconfirmed_writes_{0};
   bool version_requested_{false};
+  /// Last power state published to the charging status sensor.
+  uint8_t charging_state_{0xFF};
   bool power_notify_enabled_{false};
   bool collision_config_sent_{false};
-  uint8_t version_req_seq_{0};
-  uint8_t power_req_seq_{0};
+  bool stream_config_sent_{false};
+  bool macro_running_{false};
+  /// Macro currently held in the droid's temporary slot, cleared on disconnect.
+  const uint8_t *uploaded_macro_{nullptr};
 
   uint8_t target_r_{0}, target_g_{0}, target_b_{0};
   uint8_t current_r_{0}, current_g_{0}, current_b_{0};
   uint8_t target_back_brightness_{0};
+  /// When the oldest LED target not yet queued was set, or 0 when none is waiting.
+  uint32_t rgb_set_at_{0};
+  uint32_t back_led_set_at_{0};
+  LatencyHistogram latency_[LATENCY_STAGE_COUNT];
   uint8_t current_back_brightness_{0};
 
+  uint8_t drive_speed_{0};
+  uint16_t drive_heading_{0};
+  bool drive_pending_{false};
+  /// A setpoint was refused since the droid was last ready; keeps the warning to one per outage.
+  bool drive_rejected_{false};
+  bool driving_{false};
+  uint32_t last_drive_setpoint_{0};
+  uint32_t drive_deadman_{1000};
+
   text_sensor::TextSensor *status_sensor_{nullptr};
   sensor::Sensor *battery_sensor_{nullptr};
+  sensor::Sensor *discharge_rate_sensor_{nullptr};
+  sensor::Sensor *time_remaining_sensor_{nullptr};
   text_sensor::TextSensor *version_sensor_{nullptr};
   text_sensor::TextSensor *charging_status_sensor_{nullptr};
   binary_sensor::BinarySensor *collision_sensor_{nullptr};
   sensor::Sensor *collision_speed_sensor_{nullptr};
   sensor::Sensor *collision_magnitude_sensor_{nullptr};
+  sensor::Sensor *pacing_interval_sensor_{nullptr};
+  sensor::Sensor *link_rtt_sensor_{nullptr};
+  sensor::Sensor *rssi_sensor_{nullptr};
+  sensor::Sensor *handshake_time_sensor_{nullptr};
+  sensor::Sensor *loop_time_sensor_{nullptr};
+  sensor::Sensor *latency_sensors_[LATENCY_SENSOR_COUNT]{};
+  sensor::Sensor *metric_sensors_[METRIC_COUNT]{};
+  text_sensor::TextSensor *commands_sent_sensor_{nullptr};
 
   std::vector<SpheroBB8Light *> lights_;
-  std::vector<uint8_t> packet_buffer_;
+  TxScheduler tx_scheduler_;
+  RequestTable requests_;
+  /// Round-trip time of the response currently being dispatched.
+  uint32_t response_rtt_{0};
+
+  PacingMode pacing_mode_{PACING_MODE_FIXED};
+  uint32_t pacing_interval_{50};
+  uint32_t pacing_min_interval_{20};
+  uint32_t pacing_max_interval_{200};
+  uint8_t pacing_burst_{3};
+  uint32_t pacing_target_rtt_{150};
+  int8_t pacing_min_rssi_{-85};
+  uint32_t probe_interval_{5000};
+  uint32_t last_probe_{0};
+
+  /// Seconds without commands before the droid goes to sleep by itself.
+  uint16_t inactivity_timeout_{600};
+  uint32_t liveness_interval_{60000};
+  bool inactivity_timeout_sent_{false};
+  bool inactivity_timeout_set_{false};
+  uint32_t current_interval_{50};
+  int8_t rssi_{0};
+
+  /// Shared by every hub on this controller.
+  static AirtimeArbiter airtime_arbiter_;
+  uint8_t airtime_client_{0};
+  uint32_t airtime_stagger_{0};
+  uint32_t airtime_interval_{10};
+
+  /// Largest batch written at once; a typical LE data length of 251 leaves 244 bytes of ATT payload.
+  static constexpr size_t MAX_BATCH_SIZE = 244;
+  bool batching_enabled_{true};
+  /// The BLE stack keeps the droid's GATT database in flash (cache_services).
+  bool cache_services_{false};
+  /// Cleared for the rest of the connection once the droid rejects a batch.
+  bool batching_{true};
+  bool batch_in_flight_{false};
+  uint8_t tx_batch_[MAX_BATCH_SIZE];
+
+  Metrics metrics_;
+  CaptureRing capture_;
+  DataStream data_stream_;
+  Odometry odometry_;
+  AsyncDispatcher async_dispatcher_;
+  uint32_t metrics_interval_{60000};
+  PacketAssembler rx_assembler_;
   bool auto_connect_{false};
   bool enabled_{true};
-  std::string last_status_str_{""};
 };
 
 class SpheroBB8Button : public button::Button, public Component {
@@ -119,6 +361,10 @@ class SpheroBB8Button : public button::Button, public Component {
       this->parent_->disconnect();
     } else if (this->type_ == "CENTER_HEAD") {
       this->parent_->center_head();
+    } else if (this->type_ == "DUMP_CAPTURE") {
+      this->parent_->dump_capture();
+    } else if (this->type_ == "RESET_ODOMETRY") {
+      this->parent_->reset_odometry();
     }
   }
 
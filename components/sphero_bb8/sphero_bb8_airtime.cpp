@@ -0,0 +1,53 @@
+#include "sphero_bb8_airtime.h"
+
+namespace esphome {
+namespace sphero_bb8 {
+
+uint8_t AirtimeArbiter::register_client() {
+  if (this->client_count_ >= MAX_CLIENTS)
+    return MAX_CLIENTS;
+  return this->client_count_++;
+}
+
+void AirtimeArbiter::set_interval(uint32_t interval_ms) {
+  if (interval_ms > this->interval_ms_)
+    this->interval_ms_ = interval_ms;
+}
+
+bool AirtimeArbiter::is_waiting_(uint8_t client, uint32_t now) const {
+  return this->waiting_[client] && now - this->last_request_[client] < STALE_MS;
+}
+
+bool AirtimeArbiter::request(uint8_t client, bool ready, uint32_t now) {
+  if (client >= MAX_CLIENTS)
+    return ready;
+  this->waiting_[client] = ready;
+  this->last_request_[client] = now;
+  if (!ready)
+    return false;
+  if (this->client_count_ <= 1) {
+    this->grants_[client]++;
+    return true;
+  }
+
+  if (now - this->last_grant_ < this->interval_ms_)
+    return false;
+
+  // The first waiting client at or after the round-robin position gets the slot
+  for (uint8_t i = 0; i < this->client_count_; i++) {
+    uint8_t candidate = (this->next_ + i) % this->client_count_;
+    if (!this->is_waiting_(candidate, now))
+      continue;
+    if (candidate != client)
+      return false;
+    this->waiting_[client] = false;
+    this->next_ = (client + 1) % this->client_count_;
+    this->last_grant_ = now;
+    this->grants_[client]++;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Shares the radio between the hubs running on one controller.
+///
+/// Each hub keeps its own per-link pacing; on top of that a hub must win a grant before each
+/// write. Grants are handed out round-robin among the hubs that have a packet ready, at most one
+/// per `interval`, so a busy droid cannot starve the others. With a single hub every request is
+/// granted immediately.
+class AirtimeArbiter {
+ public:
+  static const uint8_t MAX_CLIENTS = 8;
+  /// A client that has not asked for this long is treated as idle.
+  static const uint32_t STALE_MS = 100;
+  /// Offset between clients for periodic traffic, so pings and polls do not line up.
+  static const uint32_t STAGGER_MS = 250;
+
+  /// Returns the client slot, or MAX_CLIENTS when all slots are taken (the client is then never throttled).
+  uint8_t register_client();
+  /// The shared gap between writes; the largest interval requested by any client wins.
+  void set_interval(uint32_t interval_ms);
+  uint32_t get_interval() const { return this->interval_ms_; }
+  uint8_t get_client_count() const { return this->client_count_; }
+
+  /// Asks for a write slot at `now`. `ready` tells whether the client has a packet to send at all.
+  bool request(uint8_t client, bool ready, uint32_t now);
+  /// Fixed offset for the client's periodic traffic.
+  uint32_t get_stagger(uint8_t client) const { return client < MAX_CLIENTS ? client * STAGGER_MS : 0; }
+  uint32_t get_grants(uint8_t client) const { return client < MAX_CLIENTS ? this->grants_[client] : 0; }
+
+ protected:
+  bool is_waiting_(uint8_t client, uint32_t now) const;
+
+  uint8_t client_count_{0};
+  uint8_t next_{0};
+  uint32_t interval_ms_{0};
+  uint32_t last_grant_{0};
+  bool waiting_[MAX_CLIENTS]{};
+  uint32_t last_request_[MAX_CLIENTS]{};
+  uint32_t grants_[MAX_CLIENTS]{};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "sphero_bb8_parser.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+class SpheroBB8;
+
+/// Called with an async frame (`FF FE ID LEN_MSB LEN_LSB ...`) whose ID it was registered for.
+using AsyncHandler = void (SpheroBB8::*)(const FrameView &frame);
+
+/// Lookup table from async ID code to decoder. Dispatch is a single array index, however many IDs
+/// are registered; frames for IDs without a decoder are counted instead of being dropped silently.
+class AsyncDispatcher {
+ public:
+  /// Covers every ID the v1 firmware defines (0x01-0x11) with room to spare.
+  static const size_t ID_COUNT = 32;
+
+  void set_handler(uint8_t id, AsyncHandler handler) {
+    if (id < ID_COUNT)
+      this->handlers_[id] = handler;
+  }
+
+  /// Returns the decoder for `id`, or nullptr after counting the frame as unknown.
+  AsyncHandler find(uint8_t id) {
+    AsyncHandler handler = id < ID_COUNT ? this->handlers_[id] : nullptr;
+    if (handler == nullptr) {
+      this->unknown_++;
+      this->last_unknown_id_ = id;
+    }
+    return handler;
+  }
+
+  uint32_t get_unknown() const { return this->unknown_; }
+  uint8_t get_last_unknown_id() const { return this->last_unknown_id_; }
+
+ protected:
+  AsyncHandler handlers_[ID_COUNT]{};
+  uint32_t unknown_{0};
+  uint8_t last_unknown_id_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
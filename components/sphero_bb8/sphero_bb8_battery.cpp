@@ -0,0 +1,147 @@
+#include "sphero_bb8_battery.h"
+#include "sphero_bb8_protocol.h"
+
+#include <cmath>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+struct CurvePoint {
+  float voltage;
+  float soc;
+};
+
+// Resting LiPo cell voltage against state of charge
+static const CurvePoint LIPO_CURVE[] = {
+    {3.50f, 0.0f},  {3.61f, 5.0f},  {3.69f, 10.0f}, {3.71f, 15.0f}, {3.73f, 20.0f},
+    {3.75f, 25.0f}, {3.77f, 30.0f}, {3.79f, 40.0f}, {3.82f, 50.0f}, {3.87f, 60.0f},
+    {3.93f, 70.0f}, {4.00f, 80.0f}, {4.08f, 90.0f}, {4.15f, 97.0f}, {4.20f, 100.0f},
+};
+static const size_t LIPO_CURVE_SIZE = sizeof(LIPO_CURVE) / sizeof(LIPO_CURVE[0]);
+
+// Weight of a new reading in the voltage filter
+static const float FILTER_ALPHA = 0.3f;
+// The rate is only trusted once the samples cover this much time
+static const uint32_t MIN_RATE_WINDOW_MS = 5 * 60 * 1000;
+// Samples older than this no longer describe the current discharge
+static const uint32_t MAX_SAMPLE_GAP_MS = 30 * 60 * 1000;
+// Below this rate (in %/h) the droid is considered idle
+static const float STABLE_RATE = 2.0f;
+
+float BatteryMonitor::voltage_to_soc(float voltage) {
+  // BB-8 uses a 1S pack; 2S packs are detected by their voltage and scaled to one cell
+  float cell = voltage > 5.0f ? voltage / 2.0f : voltage;
+  if (cell <= LIPO_CURVE[0].voltage)
+    return 0.0f;
+  for (size_t i = 1; i < LIPO_CURVE_SIZE; i++) {
+    if (cell <= LIPO_CURVE[i].voltage) {
+      const CurvePoint &lo = LIPO_CURVE[i - 1];
+      const CurvePoint &hi = LIPO_CURVE[i];
+      return lo.soc + (cell - lo.voltage) / (hi.voltage - lo.voltage) * (hi.soc - lo.soc);
+    }
+  }
+  return 100.0f;
+}
+
+float BatteryMonitor::power_state_level(uint8_t power_state) {
+  switch (power_state) {
+    case POWER_STATE_CHARGING:
+    case POWER_STATE_OK:
+      return 100.0f;
+    case POWER_STATE_LOW:
+      return 10.0f;
+    case POWER_STATE_CRITICAL:
+      return 1.0f;
+    default:
+      return 0.0f;
+  }
+}
+
+float BatteryMonitor::add_sample(uint8_t power_state, float voltage, uint32_t now) {
+  this->set_power_state(power_state);
+
+  // Without a usable voltage fall back to the coarse power state
+  if (voltage < 1.0f)
+    return power_state_level(power_state);
+
+  if (this->count_ > 0 && now - this->sample_(this->count_ - 1).time > MAX_SAMPLE_GAP_MS)
+    this->clear_samples_();
+
+  if (this->count_ == 0) {
+    this->filtered_voltage_ = voltage;
+  } else {
+    this->filtered_voltage_ += FILTER_ALPHA * (voltage - this->filtered_voltage_);
+  }
+  this->soc_ = voltage_to_soc(this->filtered_voltage_);
+
+  this->samples_[this->head_] = Sample{now, this->soc_};
+  this->head_ = (this->head_ + 1) % SAMPLE_CAPACITY;
+  if (this->count_ < SAMPLE_CAPACITY)
+    this->count_++;
+  return this->soc_;
+}
+
+void BatteryMonitor::set_power_state(uint8_t power_state) {
+  // Charging lifts the pack voltage, so readings from either side of a change don't mix
+  if ((power_state == POWER_STATE_CHARGING) != (this->power_state_ == POWER_STATE_CHARGING))
+    this->clear_samples_();
+  this->power_state_ = power_state;
+}
+
+float BatteryMonitor::get_discharge_rate() const {
+  if (this->count_ < 3 || this->power_state_ == POWER_STATE_CHARGING)
+    return NAN;
+  uint32_t start = this->sample_(0).time;
+  if (this->sample_(this->count_ - 1).time - start < MIN_RATE_WINDOW_MS)
+    return NAN;
+
+  // Least-squares slope of charge over time, with time in hours relative to the oldest sample
+  float sum_t = 0.0f, sum_s = 0.0f, sum_tt = 0.0f, sum_ts = 0.0f;
+  for (size_t i = 0; i < this->count_; i++) {
+    const Sample &sample = this->sample_(i);
+    float t = (sample.time - start) / 3600000.0f;
+    sum_t += t;
+    sum_s += sample.soc;
+    sum_tt += t * t;
+    sum_ts += t * sample.soc;
+  }
+  float n = this->count_;
+  float denominator = n * sum_tt - sum_t * sum_t;
+  if (denominator <= 0.0f)
+    return NAN;
+  return -(n * sum_ts - sum_t * sum_s) / denominator;
+}
+
+float BatteryMonitor::get_time_remaining() const {
+  float rate = this->get_discharge_rate();
+  if (std::isnan(rate) || rate < 0.1f)
+    return NAN;
+  return this->soc_ / rate * 60.0f;
+}
+
+uint32_t BatteryMonitor::get_poll_interval() const {
+  switch (this->power_state_) {
+    case POWER_STATE_CHARGING:
+      return POLL_INTERVAL_CHARGING_MS;
+    case POWER_STATE_LOW:
+      return POLL_INTERVAL_LOW_MS;
+    case POWER_STATE_CRITICAL:
+      return POLL_INTERVAL_CRITICAL_MS;
+  }
+  float rate = this->get_discharge_rate();
+  if (!std::isnan(rate) && rate < STABLE_RATE)
+    return POLL_INTERVAL_STABLE_MS;
+  return POLL_INTERVAL_MS;
+}
+
+void BatteryMonitor::clear_samples_() {
+  this->head_ = 0;
+  this->count_ = 0;
+}
+
+const BatteryMonitor::Sample &BatteryMonitor::sample_(size_t index) const {
+  return this->samples_[(this->head_ + SAMPLE_CAPACITY - this->count_ + index) % SAMPLE_CAPACITY];
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Turns Get Power State readings into a state of charge, a discharge rate and a poll interval.
+///
+/// Voltage is smoothed with an exponential filter and mapped through a LiPo discharge curve per
+/// cell, since the pack voltage is far from linear in its charge. Recent readings are kept in a
+/// small ring; a least-squares fit over it gives the discharge rate in %/h.
+class BatteryMonitor {
+ public:
+  static const size_t SAMPLE_CAPACITY = 24;
+
+  static const uint32_t POLL_INTERVAL_MS = 60000;
+  static const uint32_t POLL_INTERVAL_CHARGING_MS = 300000;
+  static const uint32_t POLL_INTERVAL_STABLE_MS = 180000;
+  static const uint32_t POLL_INTERVAL_LOW_MS = 30000;
+  static const uint32_t POLL_INTERVAL_CRITICAL_MS = 15000;
+
+  /// Adds a polled reading and returns the state of charge (0-100). Returns a level derived from
+  /// the power state alone when the droid did not report a usable voltage.
+  float add_sample(uint8_t power_state, float voltage, uint32_t now);
+  /// Records a power state from an async notification.
+  void set_power_state(uint8_t power_state);
+
+  /// Discharge rate in %/h, or NAN until enough readings span a long enough window.
+  float get_discharge_rate() const;
+  /// Minutes until empty at the current discharge rate, or NAN when not discharging.
+  float get_time_remaining() const;
+  /// How long to wait before polling again, based on the power state and discharge rate.
+  uint32_t get_poll_interval() const;
+
+  static float voltage_to_soc(float voltage);
+  /// Coarse level implied by a power state alone.
+  static float power_state_level(uint8_t power_state);
+
+ protected:
+  struct Sample {
+    uint32_t time;
+    float soc;
+  };
+
+  void clear_samples_();
+  const Sample &sample_(size_t index) const;
+
+  Sample samples_[SAMPLE_CAPACITY]{};
+  size_t head_{0};
+  size_t count_{0};
+  float filtered_voltage_{0.0f};
+  float soc_{0.0f};
+  uint8_t power_state_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,33 @@
+#include "sphero_bb8_capture.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+void CaptureRing::record(CaptureDirection direction, uint16_t handle, const uint8_t *data, size_t len,
+                         uint32_t now) {
+  CaptureRecord &record = this->records_[this->head_];
+  record.time = now;
+  record.handle = handle;
+  record.len = len > UINT16_MAX ? UINT16_MAX : len;
+  record.direction = direction;
+  memcpy(record.data, data, len < CaptureRecord::DATA_SIZE ? len : CaptureRecord::DATA_SIZE);
+
+  this->head_ = (this->head_ + 1) % CAPACITY;
+  if (this->count_ < CAPACITY)
+    this->count_++;
+  this->total_++;
+}
+
+void CaptureRing::clear() {
+  this->head_ = 0;
+  this->count_ = 0;
+}
+
+const CaptureRecord &CaptureRing::get(size_t index) const {
+  return this->records_[(this->head_ + CAPACITY - this->count_ + index) % CAPACITY];
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
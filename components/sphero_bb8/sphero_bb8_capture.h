@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+enum CaptureDirection : uint8_t {
+  CAPTURE_TX = 0,
+  CAPTURE_RX,
+};
+
+/// One captured GATT write or notification. Only the first DATA_SIZE bytes are kept; `len` is the
+/// original length.
+struct CaptureRecord {
+  static const size_t DATA_SIZE = 23;
+
+  uint32_t time;
+  uint16_t handle;
+  uint16_t len;
+  CaptureDirection direction;
+  uint8_t data[DATA_SIZE];
+};
+
+/// Fixed-size ring of the most recent BLE traffic, kept in binary form so it can stay enabled.
+/// Recording is a copy of at most DATA_SIZE bytes; formatting only happens when the ring is dumped.
+class CaptureRing {
+ public:
+  static const size_t CAPACITY = 64;
+
+  void record(CaptureDirection direction, uint16_t handle, const uint8_t *data, size_t len, uint32_t now);
+  void clear();
+
+  size_t size() const { return this->count_; }
+  /// Record `index`, oldest first.
+  const CaptureRecord &get(size_t index) const;
+  /// Records captured since boot, including those already overwritten.
+  uint32_t get_total() const { return this->total_; }
+
+ protected:
+  CaptureRecord records_[CAPACITY]{};
+  size_t head_{0};
+  size_t count_{0};
+  uint32_t total_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
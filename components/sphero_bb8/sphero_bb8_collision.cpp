@@ -0,0 +1,58 @@
+#include "sphero_bb8_collision.h"
+
+#include <cmath>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+static int16_t read_int16(const uint8_t *data) { return static_cast<int16_t>((data[0] << 8) | data[1]); }
+
+float CollisionEvent::get_magnitude() const {
+  return std::sqrt((float) this->mag_x * this->mag_x + (float) this->mag_y * this->mag_y);
+}
+
+bool CollisionTracker::decode(const uint8_t *payload, size_t len, uint32_t now) {
+  if (len < MIN_PAYLOAD_SIZE)
+    return false;
+
+  CollisionEvent &event = this->events_[this->head_];
+  event.x = read_int16(payload);
+  event.y = read_int16(payload + 2);
+  event.z = read_int16(payload + 4);
+  event.axis = payload[6];
+  event.mag_x = read_int16(payload + 7);
+  event.mag_y = read_int16(payload + 9);
+  event.speed = payload[11];
+  event.droid_time = 0;
+  event.time = now;
+
+  if (len >= PAYLOAD_SIZE) {
+    event.droid_time = (uint32_t(payload[12]) << 24) | (uint32_t(payload[13]) << 16) | (uint32_t(payload[14]) << 8) |
+                       payload[15];
+    // A droid clock that went backwards means it rebooted
+    if (this->clock_synced_ && event.droid_time < this->last_droid_time_)
+      this->clock_synced_ = false;
+    uint32_t offset = now - event.droid_time;
+    if (!this->clock_synced_ || static_cast<int32_t>(offset - this->clock_offset_) < 0) {
+      this->clock_offset_ = offset;
+      this->clock_synced_ = true;
+    }
+    this->last_droid_time_ = event.droid_time;
+    event.time = event.droid_time + this->clock_offset_;
+  }
+
+  this->head_ = (this->head_ + 1) % CAPACITY;
+  if (this->count_ < CAPACITY)
+    this->count_++;
+  this->total_++;
+  return true;
+}
+
+void CollisionTracker::reset_clock() { this->clock_synced_ = false; }
+
+const CollisionEvent &CollisionTracker::get(size_t index) const {
+  return this->events_[(this->head_ + CAPACITY - this->count_ + index) % CAPACITY];
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
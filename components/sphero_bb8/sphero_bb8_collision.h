@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Thresholds sent with Config Collision. Dead time is in 10ms units.
+struct CollisionConfig {
+  uint8_t x_threshold{100};
+  uint8_t x_speed{100};
+  uint8_t y_threshold{100};
+  uint8_t y_speed{100};
+  uint8_t dead_time{50};
+};
+
+/// One decoded collision notification.
+struct CollisionEvent {
+  /// ESP `millis()` at which the droid detected the impact, mapped from the droid's clock.
+  uint32_t time;
+  /// Droid timestamp from the payload (ms since the droid booted), 0 if the payload had none.
+  uint32_t droid_time;
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  /// Bit 0: impact on the X axis, bit 1: on the Y axis.
+  uint8_t axis;
+  int16_t mag_x;
+  int16_t mag_y;
+  uint8_t speed;
+
+  float get_magnitude() const;
+};
+
+/// Decodes collision notifications into a small ring of recent events and maps droid timestamps
+/// onto the ESP clock.
+///
+/// The offset between the clocks is the smallest `receive time - droid time` seen since the
+/// connection was made: BLE latency only ever adds to it, so the minimum is the closest estimate.
+class CollisionTracker {
+ public:
+  static const size_t CAPACITY = 8;
+  /// X(2), Y(2), Z(2), Axis(1), MagX(2), MagY(2), Speed(1), Timestamp(4)
+  static const size_t PAYLOAD_SIZE = 16;
+  /// Payload bytes up to and including Speed; older firmware may not send the timestamp.
+  static const size_t MIN_PAYLOAD_SIZE = 12;
+
+  /// Decodes a collision payload received at `now`. Returns false if it is too short.
+  bool decode(const uint8_t *payload, size_t len, uint32_t now);
+  /// Forgets the clock offset, e.g. when the droid may have rebooted.
+  void reset_clock();
+
+  size_t size() const { return this->count_; }
+  /// Event `index`, oldest first.
+  const CollisionEvent &get(size_t index) const;
+  const CollisionEvent &get_latest() const { return this->get(this->count_ - 1); }
+  /// Collisions decoded since boot, including those already overwritten.
+  uint32_t get_total() const { return this->total_; }
+
+ protected:
+  CollisionEvent events_[CAPACITY]{};
+  size_t head_{0};
+  size_t count_{0};
+  uint32_t total_{0};
+
+  bool clock_synced_{false};
+  uint32_t clock_offset_{0};
+  uint32_t last_droid_time_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,44 @@
+#include "sphero_bb8_latency.h"
+
+namespace esphome {
+namespace sphero_bb8 {
+
+// Upper bounds in ms; the last bucket holds everything slower
+static const uint32_t BUCKET_BOUNDS_MS[LatencyHistogram::BUCKET_COUNT - 1] = {
+    5, 10, 20, 30, 50, 75, 100, 150, 200, 300, 500, 750, 1000, 1500, 2000,
+};
+
+void LatencyHistogram::add(uint32_t ms) {
+  size_t bucket = 0;
+  while (bucket < BUCKET_COUNT - 1 && ms > BUCKET_BOUNDS_MS[bucket])
+    bucket++;
+  this->buckets_[bucket]++;
+  this->count_++;
+  if (ms > this->max_)
+    this->max_ = ms;
+}
+
+uint32_t LatencyHistogram::get_percentile(float fraction) const {
+  if (this->count_ == 0)
+    return 0;
+  uint32_t rank = static_cast<uint32_t>(fraction * this->count_ + 0.5f);
+  if (rank == 0)
+    rank = 1;
+  uint32_t seen = 0;
+  for (size_t i = 0; i < BUCKET_COUNT - 1; i++) {
+    seen += this->buckets_[i];
+    if (seen >= rank)
+      return BUCKET_BOUNDS_MS[i] < this->max_ ? BUCKET_BOUNDS_MS[i] : this->max_;
+  }
+  return this->max_;
+}
+
+void LatencyHistogram::reset() {
+  for (auto &bucket : this->buckets_)
+    bucket = 0;
+  this->count_ = 0;
+  this->max_ = 0;
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Points on the path of an LED change, each measured from the set_rgb()/set_back_led() call.
+enum LatencyStage : uint8_t {
+  /// loop() queued the target.
+  LATENCY_SYNC = 0,
+  /// The command was handed to the BLE stack.
+  LATENCY_WRITE,
+  /// The droid acknowledged the command.
+  LATENCY_ACK,
+  LATENCY_STAGE_COUNT,
+};
+
+/// Published statistics of the end-to-end (ACK) latency.
+enum LatencySensor : uint8_t {
+  LATENCY_SENSOR_P50 = 0,
+  LATENCY_SENSOR_P95,
+  LATENCY_SENSOR_MAX,
+  LATENCY_SENSOR_COUNT,
+};
+
+/// Latency histogram with fixed millisecond buckets, so recording is a short scan and an increment.
+///
+/// Percentiles are reported as the upper bound of the bucket they fall in (the exact maximum for
+/// the last, open-ended bucket).
+class LatencyHistogram {
+ public:
+  static const size_t BUCKET_COUNT = 16;
+
+  void add(uint32_t ms);
+  /// Latency below which `fraction` (0-1) of the samples fall.
+  uint32_t get_percentile(float fraction) const;
+  uint32_t get_max() const { return this->max_; }
+  uint32_t get_count() const { return this->count_; }
+  void reset();
+
+ protected:
+  uint32_t buckets_[BUCKET_COUNT]{};
+  uint32_t count_{0};
+  uint32_t max_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
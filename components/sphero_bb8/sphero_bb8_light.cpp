@@ -1,14 +1,43 @@
 #include "sphero_bb8_light.h"
 #include "esphome/core/log.h"
 
+#include <algorithm>
+
 namespace esphome {
 namespace sphero_bb8 {
 
 static const char *const TAG = "sphero_bb8_light";
 
+// CIE L* lightness of each LED output level, scaled to 0-255. LED output is linear in luminance,
+// so equal steps in this table are roughly equally visible.
+static const uint8_t PERCEPTUAL_LUT[256] = {
+    0, 9, 18, 26, 33, 39, 44, 48, 52, 56, 60, 63, 66, 69, 72, 74,
+    77, 79, 81, 84, 86, 88, 90, 92, 94, 96, 97, 99, 101, 103, 104, 106,
+    107, 109, 110, 112, 113, 115, 116, 117, 119, 120, 121, 123, 124, 125, 126, 128,
+    129, 130, 131, 132, 133, 134, 136, 137, 138, 139, 140, 141, 142, 143, 144, 145,
+    146, 147, 148, 149, 150, 151, 151, 152, 153, 154, 155, 156, 157, 158, 159, 159,
+    160, 161, 162, 163, 163, 164, 165, 166, 167, 167, 168, 169, 170, 171, 171, 172,
+    173, 174, 174, 175, 176, 176, 177, 178, 179, 179, 180, 181, 181, 182, 183, 183,
+    184, 185, 185, 186, 187, 187, 188, 189, 189, 190, 191, 191, 192, 192, 193, 194,
+    194, 195, 196, 196, 197, 197, 198, 198, 199, 200, 200, 201, 201, 202, 203, 203,
+    204, 204, 205, 205, 206, 206, 207, 208, 208, 209, 209, 210, 210, 211, 211, 212,
+    212, 213, 213, 214, 215, 215, 216, 216, 217, 217, 218, 218, 219, 219, 220, 220,
+    221, 221, 222, 222, 223, 223, 224, 224, 225, 225, 225, 226, 226, 227, 227, 228,
+    228, 229, 229, 230, 230, 231, 231, 232, 232, 232, 233, 233, 234, 234, 235, 235,
+    236, 236, 236, 237, 237, 238, 238, 239, 239, 240, 240, 240, 241, 241, 242, 242,
+    242, 243, 243, 244, 244, 245, 245, 245, 246, 246, 247, 247, 247, 248, 248, 249,
+    249, 249, 250, 250, 251, 251, 251, 252, 252, 253, 253, 253, 254, 254, 255, 255,
+};
+
+/// Scales a 0-1 channel by an 8-bit level with integer rounding.
+static uint8_t scale_channel(float channel, uint8_t level) {
+  uint16_t value = static_cast<uint16_t>(channel * 255.0f + 0.5f);
+  return static_cast<uint8_t>((value * level + 127) / 255);
+}
+
 light::LightTraits SpheroBB8Light::get_traits() {
   auto traits = light::LightTraits();
-  if (this->type_ == "RGB") {
+  if (this->type_ == LIGHT_TYPE_RGB) {
     traits.set_supported_color_modes({light::ColorMode::RGB});
   } else {
     traits.set_supported_color_modes({light::ColorMode::BRIGHTNESS});
@@ -32,17 +61,81 @@ void SpheroBB8Light::write_state(light::LightState *state) {
   }
 
   auto current_vals = state->current_values;
-  if (this->type_ == "RGB") {
-    float r = current_vals.get_red();
-    float g = current_vals.get_green();
-    float b = current_vals.get_blue();
-    float br = current_vals.get_brightness() * current_vals.get_state();
-    this->parent_->set_rgb(r * br * 255, g * br * 255, b * br * 255);
-  } else if (this->type_ == "TAILLIGHT") {
-    float br = current_vals.get_brightness() * current_vals.get_state();
-    this->parent_->set_back_led(br * 255);
+  uint8_t level = scale_channel(current_vals.get_brightness() * current_vals.get_state(), 255);
+  // Intermediate transition frames may be skipped, the final target is always sent
+  bool final = !state->is_transformer_active();
+
+  switch (this->type_) {
+    case LIGHT_TYPE_RGB: {
+      uint8_t rgb[3] = {scale_channel(current_vals.get_red(), level), scale_channel(current_vals.get_green(), level),
+                        scale_channel(current_vals.get_blue(), level)};
+      if (this->should_send_(rgb, 3, final))
+        this->parent_->set_rgb(rgb[0], rgb[1], rgb[2]);
+      break;
+    }
+    case LIGHT_TYPE_TAILLIGHT:
+      if (this->should_send_(&level, 1, final))
+        this->parent_->set_back_led(level);
+      break;
   }
 }
 
+bool SpheroBB8Light::should_send_(const uint8_t *values, size_t count, bool final) {
+  bool changed = false;
+  uint8_t delta = 0;
+  for (size_t i = 0; i < count; i++) {
+    changed |= values[i] != this->last_sent_[i];
+    int diff = PERCEPTUAL_LUT[values[i]] - PERCEPTUAL_LUT[this->last_sent_[i]];
+    delta = std::max<uint8_t>(delta, diff < 0 ? -diff : diff);
+  }
+  if (!changed || (!final && delta < this->min_delta_)) {
+    if (changed)
+      ESP_LOGV(TAG, "Skipping transition frame, perceptual delta %u", delta);
+    return false;
+  }
+  for (size_t i = 0; i < count; i++)
+    this->last_sent_[i] = values[i];
+  return true;
+}
+
+SpheroBB8 *SpheroBB8MacroEffect::get_parent_() const {
+  return static_cast<SpheroBB8Light *>(this->state_->get_output())->get_parent();
+}
+
+void SpheroBB8MacroEffect::start() {
+  this->running_ = false;
+  this->run_count_ = 0;
+}
+
+void SpheroBB8MacroEffect::stop() {
+  this->running_ = false;
+  auto *parent = this->get_parent_();
+  if (parent != nullptr) {
+    parent->abort_macro();
+  }
+}
+
+void SpheroBB8MacroEffect::apply() {
+  auto *parent = this->get_parent_();
+  if (parent == nullptr || !parent->is_ready()) {
+    // The macro is uploaded and started from its first run once the droid is back
+    this->running_ = false;
+    this->run_count_ = 0;
+    return;
+  }
+
+  uint32_t now = millis();
+  if (this->running_ && now - this->started_at_ < this->duration_)
+    return;
+  if (this->runs_ != 0 && this->run_count_ >= this->runs_)
+    return;
+
+  ESP_LOGD(TAG, "Starting macro effect (run %u)", (unsigned) this->run_count_ + 1);
+  parent->run_macro(this->macro_.data(), this->macro_.size());
+  this->running_ = true;
+  this->started_at_ = now;
+  this->run_count_++;
+}
+
 }  // namespace sphero_bb8
 }  // namespace esphome
\ No newline at end of file
@@ -2,15 +2,26 @@
 
 #include "esphome/core/component.h"
 #include "esphome/components/light/light_output.h"
+#include "esphome/components/light/light_effect.h"
 #include "sphero_bb8.h"
 
+#include <vector>
+
 namespace esphome {
 namespace sphero_bb8 {
 
+enum LightType : uint8_t {
+  LIGHT_TYPE_RGB,
+  LIGHT_TYPE_TAILLIGHT,
+};
+
 class SpheroBB8Light : public light::LightOutput, public Component {
  public:
   void set_parent(SpheroBB8 *parent) { parent_ = parent; }
-  void set_type(const std::string &type) { type_ = type; }
+  void set_type(LightType type) { type_ = type; }
+  /// Smallest perceptual change (0-255 lightness steps) sent during a transition.
+  void set_min_delta(uint8_t min_delta) { min_delta_ = min_delta; }
+  SpheroBB8 *get_parent() const { return parent_; }
 
   void setup() override { this->parent_->register_light(this); }
   light::LightTraits get_traits() override;
@@ -19,8 +30,40 @@ class SpheroBB8Light : public light::LightOutput, public Component {
  protected:
   friend class SpheroBB8;
   SpheroBB8 *parent_{nullptr};
+  bool should_send_(const uint8_t *values, size_t count, bool final);
+
   light::LightState *light_state_{nullptr};
-  std::string type_;
+  LightType type_{LIGHT_TYPE_RGB};
+  uint8_t min_delta_{3};
+  /// Last values passed to the hub, for the perceptual dedupe.
+  uint8_t last_sent_[3]{};
+};
+
+/// Light effect that runs a LED sequence compiled into a Sphero macro, so the droid animates the
+/// LEDs itself instead of receiving a packet per frame.
+class SpheroBB8MacroEffect : public light::LightEffect {
+ public:
+  explicit SpheroBB8MacroEffect(const std::string &name) : LightEffect(name) {}
+
+  void set_macro(const std::vector<uint8_t> &macro) { macro_ = macro; }
+  /// Run time of the macro, after which the next run is started.
+  void set_duration(uint32_t duration) { duration_ = duration; }
+  /// How many times the macro is started, one run after the other; 0 keeps starting it forever.
+  void set_runs(uint8_t runs) { runs_ = runs; }
+
+  void start() override;
+  void stop() override;
+  void apply() override;
+
+ protected:
+  SpheroBB8 *get_parent_() const;
+
+  std::vector<uint8_t> macro_;
+  uint32_t duration_{0};
+  uint8_t runs_{0};
+  uint8_t run_count_{0};
+  bool running_{false};
+  uint32_t started_at_{0};
 };
 
 }  // namespace sphero_bb8
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Counters that can be published as diagnostic sensors.
+enum MetricSensor : uint8_t {
+  METRIC_PACKETS_SENT = 0,
+  METRIC_BYTES_SENT,
+  METRIC_NOTIFICATIONS_RECEIVED,
+  METRIC_BYTES_RECEIVED,
+  METRIC_FRAMES_PARSED,
+  METRIC_RESYNC_BYTES,
+  METRIC_CHECKSUM_FAILURES,
+  METRIC_WRITE_FAILURES,
+  METRIC_WRITE_TIMEOUTS,
+  METRIC_KEEPALIVE_PINGS,
+  METRIC_LED_UPDATES_COALESCED,
+  METRIC_BATCHED_WRITES,
+  METRIC_ASYNC_UNKNOWN,
+  METRIC_LED_TARGETS_OVERWRITTEN,
+  METRIC_COUNT,
+};
+
+struct CommandCounter {
+  uint8_t did;
+  uint8_t cid;
+  uint32_t packets;
+  uint32_t bytes;
+};
+
+/// Hot-path traffic counters. Every update is a plain increment, so they stay enabled permanently.
+struct Metrics {
+  static const size_t COMMAND_CAPACITY = 16;
+
+  uint32_t packets_sent{0};
+  uint32_t bytes_sent{0};
+  uint32_t notifications_received{0};
+  uint32_t bytes_received{0};
+  uint32_t frames_parsed{0};
+  uint32_t write_failures{0};
+  uint32_t write_timeouts{0};
+  uint32_t keepalive_pings{0};
+  /// Writes that carried more than one packet.
+  uint32_t batched_writes{0};
+  /// LED targets replaced by a newer one before loop() queued them.
+  uint32_t led_targets_overwritten{0};
+  /// loop() passes and the time spent in them since the last publish.
+  uint32_t loop_passes{0};
+  uint32_t loop_time_us{0};
+  uint32_t loop_time_max_us{0};
+
+  CommandCounter commands[COMMAND_CAPACITY]{};
+  size_t command_count{0};
+
+  void count_sent(uint8_t did, uint8_t cid, size_t len) {
+    this->packets_sent++;
+    this->bytes_sent += len;
+    for (size_t i = 0; i < this->command_count; i++) {
+      if (this->commands[i].did == did && this->commands[i].cid == cid) {
+        this->commands[i].packets++;
+        this->commands[i].bytes += len;
+        return;
+      }
+    }
+    if (this->command_count < COMMAND_CAPACITY) {
+      this->commands[this->command_count++] = CommandCounter{did, cid, 1, static_cast<uint32_t>(len)};
+    }
+  }
+
+  void count_loop(uint32_t us) {
+    this->loop_passes++;
+    this->loop_time_us += us;
+    if (us > this->loop_time_max_us)
+      this->loop_time_max_us = us;
+  }
+
+  void reset_loop() {
+    this->loop_passes = 0;
+    this->loop_time_us = 0;
+    this->loop_time_max_us = 0;
+  }
+
+  void count_received(size_t len) {
+    this->notifications_received++;
+    this->bytes_received += len;
+  }
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,81 @@
+#include "sphero_bb8_odometry.h"
+
+#include <cmath>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+static const float DEGREES_TO_RADIANS = 3.14159265f / 180.0f;
+/// Longest gap between two samples that is integrated, in sample periods. Notifications bunch up
+/// on connection events, which stays well inside this; a longer gap (a stall, lost frames) is
+/// not trusted with one velocity reading.
+static const float MAX_GAP_PERIODS = 4.0f;
+
+static float wrap_degrees(float degrees) {
+  degrees = std::fmod(degrees, 360.0f);
+  return degrees < 0.0f ? degrees + 360.0f : degrees;
+}
+
+void Odometry::update(float yaw, float velocity_x, float velocity_y, uint32_t now) {
+  // The first sample after a reset or reconnect has no predecessor and counts as one period
+  float dt = this->sample_period_;
+  if (!this->rebase_pending_) {
+    dt = (now - this->last_sample_at_) * 0.001f;
+    if (dt > this->sample_period_ * MAX_GAP_PERIODS)
+      dt = this->sample_period_ * MAX_GAP_PERIODS;
+  }
+  this->last_sample_at_ = now;
+
+  if (this->rebase_pending_) {
+    // Continue from the current heading, whatever the droid now calls yaw 0
+    this->yaw_offset_ = yaw - this->heading_;
+    this->offset_cos_ = std::cos(this->yaw_offset_ * DEGREES_TO_RADIANS);
+    this->offset_sin_ = std::sin(this->yaw_offset_ * DEGREES_TO_RADIANS);
+    this->rebase_pending_ = false;
+  }
+  this->heading_ = wrap_degrees(yaw - this->yaw_offset_);
+
+  // mm/s over dt, in cm
+  float scale = dt * 0.1f;
+  float dx = (velocity_x * this->offset_cos_ - velocity_y * this->offset_sin_) * scale;
+  float dy = (velocity_y * this->offset_cos_ + velocity_x * this->offset_sin_) * scale;
+  this->x_ += dx;
+  this->y_ += dy;
+  this->distance_ += std::sqrt(dx * dx + dy * dy);
+}
+
+void Odometry::reset() {
+  this->x_ = 0.0f;
+  this->y_ = 0.0f;
+  this->heading_ = 0.0f;
+  this->distance_ = 0.0f;
+  this->rebase_pending_ = true;
+  this->publish_pending_ = true;
+}
+
+void Odometry::publish() {
+  float moved_x = this->x_ - this->published_x_;
+  float moved_y = this->y_ - this->published_y_;
+  float turned = std::fabs(this->heading_ - this->published_heading_);
+  if (turned > 180.0f)
+    turned = 360.0f - turned;
+  bool moved = moved_x * moved_x + moved_y * moved_y >= this->min_distance_ * this->min_distance_;
+  if (!this->publish_pending_ && !moved && turned < this->min_heading_)
+    return;
+
+  this->publish_pending_ = false;
+  this->published_x_ = this->x_;
+  this->published_y_ = this->y_;
+  this->published_heading_ = this->heading_;
+  if (this->x_sensor_ != nullptr)
+    this->x_sensor_->publish_state(this->x_);
+  if (this->y_sensor_ != nullptr)
+    this->y_sensor_->publish_state(this->y_);
+  if (this->heading_sensor_ != nullptr)
+    this->heading_sensor_->publish_state(this->heading_);
+  if (this->distance_sensor_ != nullptr)
+    this->distance_sensor_->publish_state(this->distance_);
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
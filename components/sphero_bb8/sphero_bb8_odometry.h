@@ -0,0 +1,77 @@
+#pragma once
+
+#include "esphome/components/sensor/sensor.h"
+
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Dead-reckoning pose built from streamed velocity and yaw.
+///
+/// Each sample advances the position by the velocity times the time since the previous sample,
+/// so frames that arrive in bursts or go missing still add up to the time driven. The cost per
+/// sample is fixed and nothing is allocated. Position and heading are relative to where
+/// the droid was and which way it faced at the last reset: y points forward, x to the right.
+class Odometry {
+ public:
+  void set_x_sensor(sensor::Sensor *sensor) { this->x_sensor_ = sensor; }
+  void set_y_sensor(sensor::Sensor *sensor) { this->y_sensor_ = sensor; }
+  void set_heading_sensor(sensor::Sensor *sensor) { this->heading_sensor_ = sensor; }
+  void set_distance_sensor(sensor::Sensor *sensor) { this->distance_sensor_ = sensor; }
+  /// Smallest position change, in cm, that is published.
+  void set_min_distance(float min_distance) { this->min_distance_ = min_distance; }
+  /// Smallest heading change, in degrees, that is published.
+  void set_min_heading(float min_heading) { this->min_heading_ = min_heading; }
+  void set_sample_period(float period) { this->sample_period_ = period; }
+
+  bool is_enabled() const {
+    return this->x_sensor_ != nullptr || this->y_sensor_ != nullptr || this->heading_sensor_ != nullptr ||
+           this->distance_sensor_ != nullptr;
+  }
+
+  /// Integrates one sample received at `now` (ms): yaw in degrees, velocity in mm/s in the droid's
+  /// locator frame.
+  void update(float yaw, float velocity_x, float velocity_y, uint32_t now);
+  /// Zeroes the pose; the droid's current direction becomes heading 0 at the next sample.
+  void reset();
+  /// Keeps the pose but takes a new heading reference at the next sample. Used after a reconnect,
+  /// since the droid restarts its yaw and locator when it wakes.
+  void rebase() { this->rebase_pending_ = true; }
+  /// Publishes the pose if it moved or turned more than the configured minimum since the last publish.
+  void publish();
+
+  float get_x() const { return this->x_; }
+  float get_y() const { return this->y_; }
+  float get_heading() const { return this->heading_; }
+  float get_distance() const { return this->distance_; }
+
+ protected:
+  sensor::Sensor *x_sensor_{nullptr};
+  sensor::Sensor *y_sensor_{nullptr};
+  sensor::Sensor *heading_sensor_{nullptr};
+  sensor::Sensor *distance_sensor_{nullptr};
+  float min_distance_{5.0f};
+  float min_heading_{5.0f};
+  float sample_period_{0.05f};
+  uint32_t last_sample_at_{0};
+
+  float x_{0.0f};
+  float y_{0.0f};
+  float heading_{0.0f};
+  float distance_{0.0f};
+
+  /// Rotates the droid's frame into the frame fixed at the last reset.
+  float yaw_offset_{0.0f};
+  float offset_cos_{1.0f};
+  float offset_sin_{0.0f};
+  bool rebase_pending_{true};
+
+  float published_x_{0.0f};
+  float published_y_{0.0f};
+  float published_heading_{0.0f};
+  bool publish_pending_{true};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
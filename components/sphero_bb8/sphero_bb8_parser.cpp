@@ -0,0 +1,93 @@
+#include "sphero_bb8_parser.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+static inline bool is_sop2(uint8_t b) { return b == SOP2_SYNC || b == SOP2_ASYNC; }
+
+size_t PacketAssembler::push(const uint8_t *data, size_t len) {
+  size_t free = CAPACITY - this->count_;
+  if (len > free) len = free;
+
+  size_t tail = (this->head_ + this->count_) & (CAPACITY - 1);
+  size_t first = CAPACITY - tail;
+  if (first > len) first = len;
+  memcpy(this->buffer_ + tail, data, first);
+  memcpy(this->buffer_, data + first, len - first);
+  this->count_ += len;
+  return len;
+}
+
+void PacketAssembler::consume_(size_t count) {
+  this->head_ = (this->head_ + count) & (CAPACITY - 1);
+  this->count_ -= count;
+}
+
+void PacketAssembler::resync_() {
+  // Skip the current (bad) SOP and everything up to the next candidate. A trailing 0xFF is kept
+  // because its SOP2 may arrive with the next notification.
+  size_t skip = 1;
+  while (skip < this->count_) {
+    if (this->peek_(skip) == SOP1 && (skip + 1 == this->count_ || is_sop2(this->peek_(skip + 1))))
+      break;
+    skip++;
+  }
+  this->resync_bytes_ += skip;
+  this->consume_(skip);
+}
+
+bool PacketAssembler::pop(FrameView &frame) {
+  while (this->count_ > 0) {
+    if (this->peek_(0) != SOP1 || (this->count_ >= 2 && !is_sop2(this->peek_(1)))) {
+      this->resync_();
+      continue;
+    }
+    if (this->count_ < 5)
+      return false;
+
+    // Sync: [FF FF MRSP SEQ DLEN ...], Async: [FF FE ID DLEN_MSB DLEN_LSB ...]. DLEN includes CHK.
+    size_t dlen = this->peek_(1) == SOP2_SYNC ? this->peek_(4) : (this->peek_(3) << 8) | this->peek_(4);
+    size_t frame_len = 5 + dlen;
+    if (dlen == 0 || frame_len > CAPACITY) {
+      this->resync_();
+      continue;
+    }
+    if (this->count_ < frame_len)
+      return false;
+
+    const uint8_t *data;
+    size_t first = CAPACITY - this->head_;
+    if (frame_len <= first) {
+      data = this->buffer_ + this->head_;
+    } else {
+      memcpy(this->frame_, this->buffer_ + this->head_, first);
+      memcpy(this->frame_ + first, this->buffer_, frame_len - first);
+      data = this->frame_;
+    }
+
+    uint32_t sum = 0;
+    for (size_t i = 2; i < frame_len - 1; i++)
+      sum += data[i];
+    if ((~sum & 0xFF) != data[frame_len - 1]) {
+      this->checksum_failures_++;
+      this->resync_();
+      continue;
+    }
+
+    this->consume_(frame_len);
+    frame.data = data;
+    frame.len = frame_len;
+    return true;
+  }
+  return false;
+}
+
+void PacketAssembler::reset() {
+  this->head_ = 0;
+  this->count_ = 0;
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
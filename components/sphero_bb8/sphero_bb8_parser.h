@@ -0,0 +1,66 @@
+#pragma once
+
+#include "sphero_bb8_protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Non-owning view of one complete frame. It stays valid until the next call to `PacketAssembler::push()`.
+///
+/// The assembler only hands out frames whose length matches their DLEN / async length field, so the
+/// payload (everything between the 5-byte header and the checksum) can be sized from `len` alone.
+/// Decoders should bound fixed offsets by `payload_size()` rather than by the length byte.
+struct FrameView {
+  static const size_t HEADER_SIZE = 5;
+
+  const uint8_t *data{nullptr};
+  size_t len{0};
+
+  size_t size() const { return this->len; }
+  const uint8_t *payload() const { return this->data + HEADER_SIZE; }
+  size_t payload_size() const { return this->len > HEADER_SIZE ? this->len - HEADER_SIZE - 1 : 0; }
+  uint8_t operator[](size_t index) const { return this->data[index]; }
+  const uint8_t *begin() const { return this->data; }
+  const uint8_t *end() const { return this->data + this->len; }
+};
+
+/// Reassembles Sphero frames from BLE notifications in a fixed-size circular buffer.
+///
+/// Frames are validated (SOP, length and checksum) before they are handed out. On a bad SOP or
+/// checksum the assembler scans ahead to the next `0xFF 0xFF` / `0xFF 0xFE` candidate instead of
+/// shifting one byte at a time.
+class PacketAssembler {
+ public:
+  static const size_t CAPACITY = 256;
+
+  /// Appends received bytes and returns how many fitted into the buffer.
+  size_t push(const uint8_t *data, size_t len);
+  /// Extracts the next valid frame, returning false once no complete frame is buffered.
+  bool pop(FrameView &frame);
+  void reset();
+
+  uint32_t get_checksum_failures() const { return this->checksum_failures_; }
+  uint32_t get_resync_bytes() const { return this->resync_bytes_; }
+
+ protected:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+  uint8_t peek_(size_t offset) const { return this->buffer_[(this->head_ + offset) & (CAPACITY - 1)]; }
+  void consume_(size_t count);
+  void resync_();
+
+  uint8_t buffer_[CAPACITY];
+  /// Linear copy of a frame that wraps around the end of `buffer_`.
+  uint8_t frame_[CAPACITY];
+  size_t head_{0};
+  size_t count_{0};
+
+  uint32_t checksum_failures_{0};
+  uint32_t resync_bytes_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
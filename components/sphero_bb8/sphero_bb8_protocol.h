@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+// Packet framing: [SOP1, SOP2, DID, CID, SEQ, DLEN, <DATA...>, CHK]
+static const uint8_t SOP1 = 0xFF;
+static const uint8_t SOP2_SYNC = 0xFF;
+static const uint8_t SOP2_ASYNC = 0xFE;
+static const size_t PACKET_HEADER_SIZE = 6;
+static const size_t PACKET_OVERHEAD = PACKET_HEADER_SIZE + 1;
+// Large enough for a temporary LED macro; longer packets are split across several GATT writes.
+static const size_t MAX_PAYLOAD_SIZE = 96;
+static const size_t MAX_PACKET_SIZE = PACKET_OVERHEAD + MAX_PAYLOAD_SIZE;
+
+static const uint8_t DID_CORE = 0x00;
+static const uint8_t DID_SPHERO = 0x02;
+
+static const uint8_t CID_PING = 0x01;
+static const uint8_t CID_VERSION = 0x02;
+static const uint8_t CID_GET_POWER_STATE = 0x20;
+static const uint8_t CID_SET_POWER_NOTIFY = 0x21;
+static const uint8_t CID_SLEEP = 0x22;
+static const uint8_t CID_SET_INACTIVITY_TIMEOUT = 0x25;
+
+static const uint8_t CID_SET_SELF_LEVEL = 0x09;
+static const uint8_t CID_SET_DATA_STREAMING = 0x11;
+static const uint8_t CID_CONFIG_COLLISION = 0x12;
+static const uint8_t CID_SET_RGB = 0x20;
+static const uint8_t CID_SET_BACK_LED = 0x21;
+static const uint8_t CID_ROLL = 0x30;
+static const uint8_t CID_RUN_MACRO = 0x50;
+static const uint8_t CID_SAVE_TEMP_MACRO = 0x51;
+static const uint8_t CID_ABORT_MACRO = 0x55;
+
+// Async message ID codes
+static const uint8_t ASYNC_POWER_NOTIFICATION = 0x01;
+static const uint8_t ASYNC_LEVEL1_DIAGNOSTIC = 0x02;
+static const uint8_t ASYNC_SENSOR_DATA = 0x03;
+static const uint8_t ASYNC_PRE_SLEEP_WARNING = 0x05;
+static const uint8_t ASYNC_MACRO_MARKER = 0x06;
+static const uint8_t ASYNC_COLLISION = 0x07;
+
+// Power states reported by Get Power State and the async power notification
+static const uint8_t POWER_STATE_CHARGING = 0x01;
+static const uint8_t POWER_STATE_OK = 0x02;
+static const uint8_t POWER_STATE_LOW = 0x03;
+static const uint8_t POWER_STATE_CRITICAL = 0x04;
+
+/// Macro ID of the droid's temporary macro slot; it is kept in RAM until replaced or the droid sleeps.
+static const uint8_t TEMP_MACRO_ID = 0xFF;
+
+/// Sphero checksum: one's complement of the low byte of the summed DID, CID, SEQ, DLEN and payload.
+/// `header_sum` carries the bytes that are already known, so constant parts can be folded at compile time.
+inline uint8_t calculate_checksum(uint32_t header_sum, uint8_t seq, const uint8_t *data, size_t len) {
+  uint32_t sum = header_sum + seq;
+  for (size_t i = 0; i < len; i++)
+    sum += data[i];
+  return ~(sum % 256) & 0xFF;
+}
+
+/// Writes a complete command packet into `out` (at least `len + PACKET_OVERHEAD` bytes) and returns its size.
+inline size_t encode_packet(uint8_t *out, uint8_t did, uint8_t cid, uint8_t seq, const uint8_t *data, size_t len) {
+  uint8_t dlen = len + 1;
+  out[0] = SOP1;
+  out[1] = SOP2_SYNC;
+  out[2] = did;
+  out[3] = cid;
+  out[4] = seq;
+  out[5] = dlen;
+  for (size_t i = 0; i < len; i++)
+    out[PACKET_HEADER_SIZE + i] = data[i];
+  out[PACKET_HEADER_SIZE + len] = calculate_checksum(did + cid + dlen, seq, data, len);
+  return len + PACKET_OVERHEAD;
+}
+
+/// Compile-time descriptor for a command with a fixed `N` byte payload.
+/// Everything except SEQ and the payload is constant, so the header bytes and
+/// their contribution to the checksum are resolved by the compiler.
+template<uint8_t DID, uint8_t CID, size_t N> struct Command {
+  static_assert(N <= MAX_PAYLOAD_SIZE, "Sphero command payload too large");
+
+  static constexpr uint8_t DEVICE_ID = DID;
+  static constexpr uint8_t COMMAND_ID = CID;
+  static constexpr size_t PAYLOAD_SIZE = N;
+  static constexpr size_t PACKET_SIZE = N + PACKET_OVERHEAD;
+  static constexpr uint8_t DLEN = N + 1;
+  static constexpr uint32_t HEADER_SUM = DID + CID + DLEN;
+
+  using Payload = std::array<uint8_t, N>;
+  using Packet = std::array<uint8_t, PACKET_SIZE>;
+
+  static void encode(Packet &out, uint8_t seq, const Payload &payload) {
+    out[0] = SOP1;
+    out[1] = SOP2_SYNC;
+    out[2] = DID;
+    out[3] = CID;
+    out[4] = seq;
+    out[5] = DLEN;
+    for (size_t i = 0; i < N; i++)
+      out[PACKET_HEADER_SIZE + i] = payload[i];
+    out[PACKET_HEADER_SIZE + N] = calculate_checksum(HEADER_SUM, seq, payload.data(), N);
+  }
+};
+
+using CmdPing = Command<DID_CORE, CID_PING, 0>;
+using CmdGetVersion = Command<DID_CORE, CID_VERSION, 0>;
+using CmdGetPowerState = Command<DID_CORE, CID_GET_POWER_STATE, 0>;
+using CmdSetPowerNotify = Command<DID_CORE, CID_SET_POWER_NOTIFY, 1>;
+using CmdSleep = Command<DID_CORE, CID_SLEEP, 5>;
+using CmdSetInactivityTimeout = Command<DID_CORE, CID_SET_INACTIVITY_TIMEOUT, 2>;
+using CmdSetSelfLevel = Command<DID_SPHERO, CID_SET_SELF_LEVEL, 4>;
+using CmdSetDataStreaming = Command<DID_SPHERO, CID_SET_DATA_STREAMING, 13>;
+using CmdConfigCollision = Command<DID_SPHERO, CID_CONFIG_COLLISION, 6>;
+using CmdSetRGB = Command<DID_SPHERO, CID_SET_RGB, 4>;
+using CmdSetBackLED = Command<DID_SPHERO, CID_SET_BACK_LED, 1>;
+using CmdRoll = Command<DID_SPHERO, CID_ROLL, 4>;
+using CmdRunMacro = Command<DID_SPHERO, CID_RUN_MACRO, 1>;
+using CmdAbortMacro = Command<DID_SPHERO, CID_ABORT_MACRO, 0>;
+
+}  // namespace sphero_bb8
+}  // namespace esphome
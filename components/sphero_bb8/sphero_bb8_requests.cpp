@@ -0,0 +1,105 @@
+#include "sphero_bb8_requests.h"
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Whether anything besides the RTT statistics depends on the response.
+static bool is_awaited(const TxRequest &request) {
+  return request.on_response != nullptr || request.on_timeout != nullptr || request.traced_at != 0;
+}
+
+bool RequestTable::add(uint8_t seq, const TxRequest &request, uint32_t now, uint32_t timeout_ms) {
+  PendingRequest *target = nullptr;
+  PendingRequest *oldest_untracked = nullptr;
+  for (auto &entry : this->entries_) {
+    if (entry.used && entry.seq == seq) {
+      // The sequence number wrapped while this entry was still waiting; it can no longer be matched
+      LatencyStats *stats = this->stats_for_(entry.request.did, entry.request.cid);
+      if (stats != nullptr)
+        stats->timeouts++;
+      target = &entry;
+      break;
+    }
+    if (!entry.used) {
+      if (target == nullptr)
+        target = &entry;
+    } else if (!is_awaited(entry.request) &&
+               (oldest_untracked == nullptr || static_cast<int32_t>(entry.sent_at - oldest_untracked->sent_at) < 0)) {
+      oldest_untracked = &entry;
+    }
+  }
+  // Fire-and-forget frames only feed the RTT statistics, so one that is waiting gives up its slot
+  if (target == nullptr && is_awaited(request)) {
+    target = oldest_untracked;
+    if (target != nullptr)
+      this->evictions_++;
+  }
+  if (target == nullptr)
+    return false;
+
+  target->request = request;
+  target->sent_at = now;
+  target->deadline = now + timeout_ms;
+  target->seq = seq;
+  target->used = true;
+  return true;
+}
+
+bool RequestTable::complete(uint8_t seq, uint32_t now, PendingRequest &request) {
+  for (auto &entry : this->entries_) {
+    if (!entry.used || entry.seq != seq)
+      continue;
+    entry.used = false;
+    request = entry;
+
+    LatencyStats *stats = this->stats_for_(entry.request.did, entry.request.cid);
+    if (stats != nullptr) {
+      uint32_t rtt = now - entry.sent_at;
+      if (stats->responses == 0 || rtt < stats->min_ms)
+        stats->min_ms = rtt;
+      if (rtt > stats->max_ms)
+        stats->max_ms = rtt;
+      stats->last_ms = rtt;
+      stats->total_ms += rtt;
+      stats->responses++;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool RequestTable::expire(uint32_t now, PendingRequest &request) {
+  for (auto &entry : this->entries_) {
+    if (!entry.used || static_cast<int32_t>(now - entry.deadline) < 0)
+      continue;
+    entry.used = false;
+    request = entry;
+
+    LatencyStats *stats = this->stats_for_(entry.request.did, entry.request.cid);
+    if (stats != nullptr)
+      stats->timeouts++;
+    return true;
+  }
+  return false;
+}
+
+void RequestTable::clear() {
+  for (auto &entry : this->entries_)
+    entry.used = false;
+}
+
+LatencyStats *RequestTable::stats_for_(uint8_t did, uint8_t cid) {
+  for (size_t i = 0; i < this->stats_count_; i++) {
+    if (this->stats_[i].did == did && this->stats_[i].cid == cid)
+      return &this->stats_[i];
+  }
+  if (this->stats_count_ == STATS_CAPACITY)
+    return nullptr;
+  LatencyStats *stats = &this->stats_[this->stats_count_++];
+  stats->did = did;
+  stats->cid = cid;
+  return stats;
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
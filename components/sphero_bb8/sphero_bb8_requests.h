@@ -0,0 +1,68 @@
+#pragma once
+
+#include "sphero_bb8_scheduler.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// A sent command that is waiting for its sync response.
+struct PendingRequest {
+  TxRequest request;
+  uint32_t sent_at;
+  uint32_t deadline;
+  uint8_t seq;
+  bool used;
+};
+
+/// Round-trip statistics for one DID/CID pair.
+struct LatencyStats {
+  uint8_t did;
+  uint8_t cid;
+  uint32_t responses;
+  uint32_t timeouts;
+  uint32_t last_ms;
+  uint32_t min_ms;
+  uint32_t max_ms;
+  uint32_t total_ms;
+};
+
+/// Fixed-capacity table of in-flight requests keyed by sequence number.
+///
+/// Entries expire after their deadline, so a sequence number that wrapped around cannot match a
+/// stale request. Every sent frame is registered for its round-trip time, but when the table is
+/// full a request that is awaited (it has a response or timeout handler, or carries an LED trace)
+/// takes the slot of the oldest one that is not, so LED fades on a lossy link cannot crowd out
+/// polls and probes.
+class RequestTable {
+ public:
+  static const size_t CAPACITY = 16;
+  static const size_t STATS_CAPACITY = 16;
+  static const uint32_t DEFAULT_TIMEOUT_MS = 1000;
+
+  /// Registers a sent request. Fails when the table is full of requests that are at least as important.
+  bool add(uint8_t seq, const TxRequest &request, uint32_t now, uint32_t timeout_ms = DEFAULT_TIMEOUT_MS);
+  /// Removes the request matching `seq`, recording its round-trip time.
+  bool complete(uint8_t seq, uint32_t now, PendingRequest &request);
+  /// Removes one request whose deadline has passed.
+  bool expire(uint32_t now, PendingRequest &request);
+  void clear();
+
+  size_t get_stats_count() const { return this->stats_count_; }
+  const LatencyStats &get_stats(size_t index) const { return this->stats_[index]; }
+  /// Fire-and-forget requests dropped to make room for awaited ones.
+  uint32_t get_evictions() const { return this->evictions_; }
+
+ protected:
+  LatencyStats *stats_for_(uint8_t did, uint8_t cid);
+
+  PendingRequest entries_[CAPACITY]{};
+  LatencyStats stats_[STATS_CAPACITY]{};
+  size_t stats_count_{0};
+  uint32_t evictions_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,136 @@
+#include "sphero_bb8_scheduler.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+void TxScheduler::set_pacing(uint32_t interval_ms, uint8_t burst) {
+  this->interval_ms_ = interval_ms;
+  this->burst_ = burst > 0 ? burst : 1;
+  int32_t max_credit = this->interval_ms_ * this->burst_;
+  if (this->credit_ms_ > max_credit)
+    this->credit_ms_ = max_credit;
+}
+
+bool TxScheduler::enqueue(TxPriority priority, uint8_t did, uint8_t cid, const uint8_t *payload, size_t len,
+                          ResponseHandler on_response, uint32_t traced_at) {
+  if (len > MAX_PAYLOAD_SIZE)
+    return false;
+
+  TxRequest request;
+  request.did = did;
+  request.cid = cid;
+  request.priority = priority;
+  request.on_response = on_response;
+  request.on_timeout = nullptr;
+  request.retries = on_response != nullptr ? DEFAULT_RETRIES : 0;
+  request.traced_at = traced_at;
+  request.len = len;
+  memcpy(request.payload, payload, len);
+  return this->enqueue(request);
+}
+
+bool TxScheduler::enqueue(const TxRequest &request) {
+  Slot *target = nullptr;
+  for (auto &slot : this->slots_) {
+    if (slot.used && slot.request.did == request.did && slot.request.cid == request.cid) {
+      target = &slot;
+      this->coalesced_[request.priority]++;
+      break;
+    }
+    if (!slot.used && target == nullptr)
+      target = &slot;
+  }
+  if (target == nullptr) {
+    this->dropped_++;
+    return false;
+  }
+
+  TxPriority priority = request.priority;
+  uint32_t traced_at = request.traced_at;
+  if (!target->used) {
+    target->used = true;
+    target->ticket = this->next_ticket_++;
+    this->pending_++;
+  } else {
+    if (target->request.priority < priority)
+      priority = target->request.priority;
+    // Latency is measured from the oldest change the replaced command was carrying
+    if (target->request.traced_at != 0)
+      traced_at = target->request.traced_at;
+    // A plain resend must not drop the callbacks of the request it replaces
+    if (request.on_response == nullptr && target->request.on_response != nullptr) {
+      TxRequest merged = request;
+      merged.on_response = target->request.on_response;
+      merged.on_timeout = target->request.on_timeout;
+      merged.retries = target->request.retries;
+      merged.priority = priority;
+      merged.traced_at = traced_at;
+      target->request = merged;
+      return true;
+    }
+  }
+  target->request = request;
+  target->request.priority = priority;
+  target->request.traced_at = traced_at;
+  return true;
+}
+
+void TxScheduler::refill_(uint32_t now) {
+  int32_t max_credit = this->interval_ms_ * this->burst_;
+  uint32_t elapsed = now - this->last_refill_;
+  this->last_refill_ = now;
+  if (elapsed >= static_cast<uint32_t>(max_credit - this->credit_ms_)) {
+    this->credit_ms_ = max_credit;
+  } else {
+    this->credit_ms_ += elapsed;
+  }
+}
+
+TxScheduler::Slot *TxScheduler::next_() {
+  Slot *best = nullptr;
+  for (auto &slot : this->slots_) {
+    if (!slot.used)
+      continue;
+    if (best == nullptr || slot.request.priority < best->request.priority ||
+        (slot.request.priority == best->request.priority &&
+         static_cast<int32_t>(slot.ticket - best->ticket) < 0)) {
+      best = &slot;
+    }
+  }
+  return best;
+}
+
+bool TxScheduler::ready(uint32_t now) {
+  this->refill_(now);
+  if (this->pending_ == 0)
+    return false;
+
+  const Slot *next = this->next_();
+  int32_t required = next->request.priority == TX_PRIORITY_DRIVE ? 0 : static_cast<int32_t>(this->interval_ms_);
+  return this->credit_ms_ >= required;
+}
+
+bool TxScheduler::pop(uint32_t now, TxRequest &request, size_t max_len) {
+  if (!this->ready(now))
+    return false;
+
+  Slot *best = this->next_();
+  if (best->request.len > max_len)
+    return false;
+  request = best->request;
+  best->used = false;
+  this->pending_--;
+  this->credit_ms_ -= this->interval_ms_;
+  return true;
+}
+
+void TxScheduler::clear() {
+  for (auto &slot : this->slots_)
+    slot.used = false;
+  this->pending_ = 0;
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
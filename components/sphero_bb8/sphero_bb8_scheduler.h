@@ -0,0 +1,109 @@
+#pragma once
+
+#include "sphero_bb8_parser.h"
+#include "sphero_bb8_protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+class SpheroBB8;
+
+struct TxRequest;
+
+/// Called with the sync response frame that matches a request's sequence number.
+using ResponseHandler = void (SpheroBB8::*)(const FrameView &frame);
+/// Called when a request got no response, or an error response, and no retries are left.
+using TimeoutHandler = void (SpheroBB8::*)(const TxRequest &request);
+
+/// Outbound traffic classes, highest priority first.
+enum TxPriority : uint8_t {
+  TX_PRIORITY_DRIVE = 0,
+  TX_PRIORITY_CONTROL,
+  TX_PRIORITY_LED,
+  TX_PRIORITY_TELEMETRY,
+  TX_PRIORITY_KEEPALIVE,
+  TX_PRIORITY_COUNT,
+};
+
+struct TxRequest {
+  uint8_t did;
+  uint8_t cid;
+  TxPriority priority;
+  /// Optional response callback; requests with one are retried when the response times out or is an error.
+  ResponseHandler on_response;
+  TimeoutHandler on_timeout;
+  uint8_t retries;
+  /// millis() of the LED change this request carries, or 0 when it is not traced.
+  uint32_t traced_at;
+  uint8_t len;
+  uint8_t payload[MAX_PAYLOAD_SIZE];
+};
+
+/// Fixed-capacity outbound queue with per-class priorities and token-bucket pacing.
+///
+/// Only one command per DID/CID can be pending: queuing it again replaces the payload in place
+/// (latest wins) and keeps its position and the oldest trace timestamp. Within a class commands
+/// leave in FIFO order, so e.g. RGB and Back LED updates alternate instead of one starving the
+/// other. Drive commands may overdraw the bucket by one packet, so a setpoint never waits for the
+/// LED traffic to earn a token.
+class TxScheduler {
+ public:
+  static const size_t CAPACITY = 12;
+  static const uint8_t DEFAULT_RETRIES = 2;
+
+  /// Sustained budget of one packet per `interval_ms`, with up to `burst` packets sent back to back.
+  void set_pacing(uint32_t interval_ms, uint8_t burst);
+  uint32_t get_interval() const { return this->interval_ms_; }
+
+  bool enqueue(const TxRequest &request);
+  bool enqueue(TxPriority priority, uint8_t did, uint8_t cid, const uint8_t *payload, size_t len,
+               ResponseHandler on_response = nullptr, uint32_t traced_at = 0);
+  template<typename Cmd>
+  bool enqueue(TxPriority priority, const typename Cmd::Payload &payload = {}, ResponseHandler on_response = nullptr,
+               uint32_t traced_at = 0) {
+    return this->enqueue(priority, Cmd::DEVICE_ID, Cmd::COMMAND_ID, payload.data(), Cmd::PAYLOAD_SIZE, on_response,
+                         traced_at);
+  }
+
+  /// Whether the token bucket allows the next request to be sent at `now`.
+  bool ready(uint32_t now);
+  /// Removes the next request if the token bucket allows a send at `now` and its payload fits `max_len`.
+  bool pop(uint32_t now, TxRequest &request, size_t max_len = MAX_PAYLOAD_SIZE);
+  bool has_pending() const { return this->pending_ != 0; }
+  void clear();
+
+  /// Number of queued commands of a class that were replaced before being sent.
+  uint32_t get_coalesced_count(TxPriority priority) const { return this->coalesced_[priority]; }
+  uint32_t get_dropped_count() const { return this->dropped_; }
+
+ protected:
+  struct Slot {
+    TxRequest request;
+    uint32_t ticket;
+    bool used;
+  };
+
+  void refill_(uint32_t now);
+  /// Highest priority, oldest pending request, or nullptr.
+  Slot *next_();
+
+  Slot slots_[CAPACITY]{};
+  size_t pending_{0};
+  uint32_t next_ticket_{0};
+
+  uint32_t interval_ms_{50};
+  uint8_t burst_{3};
+  /// Bucket level expressed in milliseconds of earned send time; a send costs `interval_ms_`.
+  /// Negative while repaying a drive overdraft.
+  int32_t credit_ms_{0};
+  uint32_t last_refill_{0};
+
+  uint32_t coalesced_[TX_PRIORITY_COUNT]{};
+  uint32_t dropped_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,105 @@
+#include "sphero_bb8_stream.h"
+
+namespace esphome {
+namespace sphero_bb8 {
+
+struct StreamField {
+  uint32_t mask;
+  uint32_t mask2;
+  /// Converts the raw signed 16-bit value to the sensor's unit.
+  float scale;
+};
+
+// Filtered values only; raw sensor and motor fields are not exposed.
+static const StreamField STREAM_FIELDS[STREAM_CHANNEL_COUNT] = {
+    {0x00040000, 0, 1.0f},           // IMU pitch, degrees
+    {0x00020000, 0, 1.0f},           // IMU roll, degrees
+    {0x00010000, 0, 1.0f},           // IMU yaw, degrees
+    {0x00008000, 0, 1.0f / 4096.0f}, // Accelerometer X, 1/4096 G
+    {0x00004000, 0, 1.0f / 4096.0f}, // Accelerometer Y
+    {0x00002000, 0, 1.0f / 4096.0f}, // Accelerometer Z
+    {0x00001000, 0, 0.1f},           // Gyro X, 0.1 dps
+    {0x00000800, 0, 0.1f},           // Gyro Y
+    {0x00000400, 0, 0.1f},           // Gyro Z
+    {0, 0x08000000, 1.0f},           // Odometer X, cm
+    {0, 0x04000000, 1.0f},           // Odometer Y, cm
+    {0, 0x01000000, 1.0f},           // Velocity X, mm/s
+    {0, 0x00800000, 1.0f},           // Velocity Y, mm/s
+};
+
+void DataStream::setup() {
+  this->mask_ = 0;
+  this->mask2_ = 0;
+  this->channel_count_ = 0;
+  this->enabled_ = this->required_;
+  for (uint8_t i = 0; i < STREAM_CHANNEL_COUNT; i++) {
+    if (this->sensors_[i] != nullptr)
+      this->enabled_ |= 1u << i;
+    if ((this->enabled_ & (1u << i)) == 0)
+      continue;
+    this->mask_ |= STREAM_FIELDS[i].mask;
+    this->mask2_ |= STREAM_FIELDS[i].mask2;
+    this->channel_count_++;
+  }
+}
+
+uint16_t DataStream::get_divisor_() const {
+  uint16_t divisor = this->sample_rate_ > 0 ? BASE_RATE_HZ / this->sample_rate_ : BASE_RATE_HZ;
+  return divisor == 0 ? 1 : divisor;
+}
+
+void DataStream::build_config(uint8_t *payload) const {
+  uint16_t divisor = this->get_divisor_();
+  payload[0] = divisor >> 8;
+  payload[1] = divisor & 0xFF;
+  payload[2] = 0x00;  // M: one sample per packet
+  payload[3] = 0x01;
+  payload[4] = this->mask_ >> 24;
+  payload[5] = this->mask_ >> 16;
+  payload[6] = this->mask_ >> 8;
+  payload[7] = this->mask_;
+  payload[8] = 0x00;  // PCNT: stream until reconfigured
+  payload[9] = this->mask2_ >> 24;
+  payload[10] = this->mask2_ >> 16;
+  payload[11] = this->mask2_ >> 8;
+  payload[12] = this->mask2_;
+}
+
+size_t DataStream::decode(const uint8_t *payload, size_t len) {
+  size_t sample_size = this->channel_count_ * 2u;
+  if (sample_size == 0)
+    return 0;
+
+  // A frame holds M samples of every enabled field, in table order
+  size_t samples = 0;
+  for (size_t offset = 0; offset + sample_size <= len; offset += sample_size) {
+    const uint8_t *value = payload + offset;
+    for (uint8_t i = 0; i < STREAM_CHANNEL_COUNT; i++) {
+      if ((this->enabled_ & (1u << i)) == 0)
+        continue;
+      int16_t raw = static_cast<int16_t>((value[0] << 8) | value[1]);
+      value += 2;
+      this->values_[i] = raw * STREAM_FIELDS[i].scale;
+      if (this->sensors_[i] == nullptr)
+        continue;
+      this->sums_[i] += this->values_[i];
+      this->counts_[i]++;
+    }
+    samples++;
+  }
+  this->samples_ += samples;
+  return samples;
+}
+
+void DataStream::publish() {
+  for (uint8_t i = 0; i < STREAM_CHANNEL_COUNT; i++) {
+    if (this->sensors_[i] == nullptr || this->counts_[i] == 0)
+      continue;
+    this->sensors_[i]->publish_state(this->sums_[i] / this->counts_[i]);
+    this->sums_[i] = 0.0f;
+    this->counts_[i] = 0;
+  }
+}
+
+}  // namespace sphero_bb8
+}  // namespace esphome
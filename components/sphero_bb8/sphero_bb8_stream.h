@@ -0,0 +1,83 @@
+#pragma once
+
+#include "esphome/components/sensor/sensor.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace sphero_bb8 {
+
+/// Decodable data streaming channels, in the order the droid sends them (MASK bits high to low,
+/// then MASK2 bits high to low).
+enum StreamChannel : uint8_t {
+  STREAM_PITCH = 0,
+  STREAM_ROLL,
+  STREAM_YAW,
+  STREAM_ACCEL_X,
+  STREAM_ACCEL_Y,
+  STREAM_ACCEL_Z,
+  STREAM_GYRO_X,
+  STREAM_GYRO_Y,
+  STREAM_GYRO_Z,
+  STREAM_ODOMETER_X,
+  STREAM_ODOMETER_Y,
+  STREAM_VELOCITY_X,
+  STREAM_VELOCITY_Y,
+  STREAM_CHANNEL_COUNT,
+};
+
+/// Configures Set Data Streaming and turns async sensor data frames (ID 0x03) into sensor values.
+///
+/// Samples are decoded in place from the received frame and averaged per channel; the averages
+/// are published at `publish_interval`, independent of the streaming rate.
+class DataStream {
+ public:
+  /// The droid samples at 400Hz and sends every Nth sample.
+  static const uint16_t BASE_RATE_HZ = 400;
+
+  void set_sensor(StreamChannel channel, sensor::Sensor *sensor) { this->sensors_[channel] = sensor; }
+  /// Streams a channel that has no sensor, for on-device consumers such as odometry.
+  void require(StreamChannel channel) { this->required_ |= 1u << channel; }
+  void set_sample_rate(uint16_t rate) { this->sample_rate_ = rate; }
+  void set_publish_interval(uint32_t interval) { this->publish_interval_ = interval; }
+  uint16_t get_sample_rate() const { return this->sample_rate_; }
+  uint32_t get_publish_interval() const { return this->publish_interval_; }
+  /// Time between two streamed samples, in seconds.
+  float get_sample_period() const { return this->get_divisor_() / static_cast<float>(BASE_RATE_HZ); }
+
+  bool is_enabled() const { return this->mask_ != 0 || this->mask2_ != 0; }
+  /// Computes the field masks from the configured sensors and required channels.
+  void setup();
+  /// Fills the 13 byte Set Data Streaming payload: N, M, MASK, PCNT, MASK2.
+  void build_config(uint8_t *payload) const;
+  /// Decodes the payload of one async sensor data frame and returns the number of samples in it.
+  size_t decode(const uint8_t *payload, size_t len);
+  /// Channel value from the most recent sample.
+  float get_value(StreamChannel channel) const { return this->values_[channel]; }
+  /// Publishes and resets the averaged channels.
+  void publish();
+
+  uint32_t get_samples() const { return this->samples_; }
+
+ protected:
+  uint16_t get_divisor_() const;
+
+  sensor::Sensor *sensors_[STREAM_CHANNEL_COUNT]{};
+  float sums_[STREAM_CHANNEL_COUNT]{};
+  float values_[STREAM_CHANNEL_COUNT]{};
+  uint32_t counts_[STREAM_CHANNEL_COUNT]{};
+  uint8_t channel_count_{0};
+  /// Bit per channel: streamed without a sensor, and streamed at all.
+  uint16_t required_{0};
+  uint16_t enabled_{0};
+
+  uint32_t mask_{0};
+  uint32_t mask2_{0};
+  uint16_t sample_rate_{20};
+  uint32_t publish_interval_{1000};
+  uint32_t samples_{0};
+};
+
+}  // namespace sphero_bb8
+}  // namespace esphome
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Decode a sphero_bb8 capture dump into a readable trace.
+
+Press the DUMP_CAPTURE button, save the log output and run:
+
+    python3 scripts/decode_capture.py bb8.log
+
+Lines that are not capture records are ignored, so a whole `esphome logs` session can be passed in.
+"""
+
+import argparse
+import re
+import sys
+
+ANSI_ESCAPE = re.compile(r"\x1b\[[0-9;]*m")
+CAPTURE_LINE = re.compile(r"CAP (\d+) (TX|RX) 0x([0-9A-Fa-f]{4}) (\d+): ([0-9A-Fa-f ]*?)( \.\.)?\s*$")
+
+COMMANDS = {
+    (0x00, 0x01): "Ping",
+    (0x00, 0x02): "Get Version",
+    (0x00, 0x20): "Get Power State",
+    (0x00, 0x21): "Set Power Notify",
+    (0x00, 0x22): "Sleep",
+    (0x02, 0x09): "Set Self Level",
+    (0x02, 0x11): "Set Data Streaming",
+    (0x02, 0x12): "Config Collision",
+    (0x02, 0x20): "Set RGB",
+    (0x02, 0x21): "Set Back LED",
+    (0x02, 0x30): "Roll",
+    (0x02, 0x50): "Run Macro",
+    (0x02, 0x51): "Save Temp Macro",
+    (0x02, 0x55): "Abort Macro",
+}
+
+ASYNC_IDS = {
+    0x01: "Power Notification",
+    0x03: "Sensor Data",
+    0x07: "Collision",
+}
+
+RESPONSE_CODES = {
+    0x00: "OK",
+    0x01: "General Error",
+    0x02: "Checksum Error",
+    0x03: "Fragment Error",
+    0x04: "Bad Command",
+    0x05: "Unsupported",
+    0x06: "Bad Message",
+    0x07: "Bad Parameter",
+}
+
+
+def checksum(body):
+    return ~sum(body) & 0xFF
+
+
+def hex_bytes(data):
+    return " ".join(f"{b:02X}" for b in data)
+
+
+def describe_command(frame):
+    did, cid, seq, dlen = frame[2], frame[3], frame[4], frame[5]
+    name = COMMANDS.get((did, cid), f"DID=0x{did:02X} CID=0x{cid:02X}")
+    payload = frame[6 : 5 + dlen]
+    ok = "" if checksum(frame[2 : 5 + dlen]) == frame[5 + dlen] else " BAD CHECKSUM"
+    return f"{name} SEQ={seq} [{hex_bytes(payload)}]{ok}"
+
+
+def describe_response(frame):
+    if frame[1] == 0xFF:
+        mrsp, seq, dlen = frame[2], frame[3], frame[4]
+        code = RESPONSE_CODES.get(mrsp, f"0x{mrsp:02X}")
+        return f"Response SEQ={seq} {code} [{hex_bytes(frame[5 : 4 + dlen])}]"
+    id_code = frame[2]
+    dlen = (frame[3] << 8) | frame[4]
+    name = ASYNC_IDS.get(id_code, f"Async ID=0x{id_code:02X}")
+    return f"{name} [{hex_bytes(frame[5 : 4 + dlen])}]"
+
+
+def split_frames(stream, commands=False):
+    """Returns (frames, remainder) from a byte stream of Sphero packets."""
+    frames = []
+    while len(stream) >= 6:
+        if stream[0] != 0xFF or stream[1] not in (0xFF, 0xFE):
+            stream = stream[1:]
+            continue
+        if commands:
+            size = 6 + stream[5]
+        elif stream[1] == 0xFE:
+            size = 5 + ((stream[3] << 8) | stream[4])
+        else:
+            size = 5 + stream[4]
+        if len(stream) < size:
+            break
+        frames.append(stream[:size])
+        stream = stream[size:]
+    return frames, stream
+
+
+def decode(lines, out):
+    rx_stream = b""
+    start = None
+    for line in lines:
+        match = CAPTURE_LINE.search(ANSI_ESCAPE.sub("", line))
+        if match is None:
+            continue
+        time = int(match.group(1))
+        direction = match.group(2)
+        handle = int(match.group(3), 16)
+        length = int(match.group(4))
+        data = bytes.fromhex(match.group(5))
+        truncated = match.group(6) is not None
+        if start is None:
+            start = time
+        prefix = f"{time - start:>8}ms {direction} 0x{handle:04X}"
+        note = f" (truncated, {length} bytes)" if truncated else ""
+
+        if direction == "TX":
+            if len(data) >= 7 and data[0] == 0xFF and data[1] == 0xFF:
+                frames, _ = split_frames(data, commands=True)
+                for frame in frames:
+                    out.write(f"{prefix} {describe_command(frame)}{note}\n")
+                if not frames:
+                    out.write(f"{prefix} partial command [{hex_bytes(data)}]{note}\n")
+            elif data.isascii() and data.decode().isprintable():
+                out.write(f'{prefix} write "{data.decode()}"\n')
+            else:
+                out.write(f"{prefix} write [{hex_bytes(data)}]{note}\n")
+            continue
+
+        if truncated:
+            # The rest of the notification was not captured, so reassembly restarts
+            out.write(f"{prefix} [{hex_bytes(data)}]{note}\n")
+            rx_stream = b""
+            continue
+        frames, rx_stream = split_frames(rx_stream + data)
+        for frame in frames:
+            out.write(f"{prefix} {describe_response(frame)}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="log file (default: stdin)")
+    args = parser.parse_args()
+    if args.log:
+        with open(args.log, encoding="utf-8", errors="replace") as f:
+            decode(f, sys.stdout)
+    else:
+        decode(sys.stdin, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,148 @@
+// Link benchmark on the simulator: time from connection to READY and to the first correct LED
+// colour over a range of link latencies, against the fixed-wait handshake it replaced, and LED
+// command throughput while Home Assistant drives a continuous fade.
+//
+// All figures are simulated time except "host us/sim s", the CPU cost of running the hub.
+// Every row runs in its own process, so each hub starts as the only one on its controller.
+
+#include "droid_rig.h"
+#include "host_runtime.h"
+#include "host_test.h"
+
+#include "esphome/core/log.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace host;
+
+/// The handshake before it was chained on GATT confirms: 200ms before Anti-DOS, then 2000ms of
+/// READY_STABILIZE after the wake write instead of the readiness Ping.
+static const uint32_t BASELINE_ANTI_DOS_WAIT = 200;
+static const uint32_t BASELINE_STABILIZE = 2000;
+
+static void time_to_ready_row(uint32_t latency, int runs) {
+  LinkConfig config;
+  config.latency = latency;
+  config.jitter = latency / 2;
+  Simulator sim(latency);
+  sim.loop_interval = 1;
+  DroidRig rig(sim, 0xE8BCE1D6A001, config);
+  sim.setup();
+
+  uint32_t first = 0, reconnect_max = 0, ready_total = 0, colour_total = 0, baseline_total = 0;
+  for (int run = 0; run < runs; run++) {
+    if (!rig.wait_ready(20000)) {
+      printf("%10u droid did not become ready\n", (unsigned) latency);
+      host_test::failures()++;
+      return;
+    }
+    // From CONNECT_EVT, so scanning is left out; service discovery is included
+    uint32_t connected_at = sim.get_connected_at(rig.link);
+    uint32_t ready = esphome::millis() - connected_at;
+    // The lights go off with the link and are refused until READY, so the colour is picked again as
+    // soon as the hub reports it; it goes out behind the restore of the configuration
+    rig.set_color(1.0f, 0.0f, 1.0f);
+    if (!sim.run_until([&]() { return rig.droid.red == 255 && rig.droid.green == 0 && rig.droid.blue == 255; },
+                       5000)) {
+      printf("%10u colour was not restored\n", (unsigned) latency);
+      host_test::failures()++;
+      return;
+    }
+    uint32_t colour = esphome::millis() - connected_at;
+    // The old sequence reached the wake write later by its Anti-DOS wait, saw it confirmed one
+    // link latency after that, then waited out READY_STABILIZE; the restore after READY is the same
+    uint32_t baseline = rig.droid.woken_at - connected_at + BASELINE_ANTI_DOS_WAIT + latency + BASELINE_STABILIZE;
+
+    if (run == 0)
+      first = ready;
+    else
+      reconnect_max = std::max(reconnect_max, ready);
+    ready_total += ready;
+    colour_total += colour - ready;
+    baseline_total += baseline;
+    sim.drop_link(rig.link);
+    sim.run_for(20);
+  }
+  uint32_t ready_avg = ready_total / runs;
+  uint32_t baseline_avg = baseline_total / runs;
+  uint32_t restore_avg = colour_total / runs;
+  printf("%10u %8u %10u %10u %10u %10u %10u %10u\n", (unsigned) latency, (unsigned) config.jitter, (unsigned) first,
+         (unsigned) reconnect_max, (unsigned) ready_avg, (unsigned) (ready_avg + restore_avg), (unsigned) baseline_avg,
+         (unsigned) (baseline_avg + restore_avg));
+  // A reconnect repeats the first handshake; anything stuck from the old link (a write completion, a
+  // request) would show up as a wait of a whole timeout
+  uint32_t bound = first + 4 * (latency + config.jitter);
+  if (reconnect_max > bound) {
+    printf("%10u reconnect took %ums, more than %ums\n", (unsigned) latency, (unsigned) reconnect_max,
+           (unsigned) bound);
+    host_test::failures()++;
+  }
+}
+
+static void throughput_row(uint32_t interval, bool batching, uint32_t seconds) {
+  LinkConfig config;
+  config.mtu = 185;
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001, config);
+  rig.droid.record_commands = false;
+  rig.hub.set_pacing_interval(interval);
+  rig.hub.set_batching(batching);
+  sim.setup();
+  if (!rig.wait_ready()) {
+    printf("%10u droid did not become ready\n", (unsigned) interval);
+    host_test::failures()++;
+    return;
+  }
+  sim.run_for(1000);
+
+  uint32_t rgb_before = rig.droid.count(0x02, 0x20);
+  uint32_t writes_before = rig.droid.writes;
+  auto started = std::chrono::steady_clock::now();
+  uint32_t end = esphome::millis() + seconds * 1000;
+  uint32_t frame = 0;
+  while (static_cast<int32_t>(esphome::millis() - end) < 0) {
+    float phase = (frame++ % 200) / 200.0f;
+    rig.set_color(phase, 1.0f - phase, 0.5f);
+    sim.step();
+  }
+  auto wall = std::chrono::steady_clock::now() - started;
+  uint32_t rgb = rig.droid.count(0x02, 0x20) - rgb_before;
+  uint32_t writes = rig.droid.writes - writes_before;
+
+  // The last target of a fade must always land
+  rig.set_color(0.0f, 0.0f, 1.0f);
+  sim.run_for(500);
+  bool match = rig.droid.red == 0 && rig.droid.green == 0 && rig.droid.blue == 255;
+  if (!match)
+    host_test::failures()++;
+  long long wall_us = std::chrono::duration_cast<std::chrono::microseconds>(wall).count();
+  printf("%10u %10s %10.1f %10.1f %12s %14lld\n", (unsigned) interval, batching ? "on" : "off",
+         rgb / (float) seconds, writes / (float) seconds, match ? "yes" : "NO", wall_us / (long long) seconds);
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  set_log_level(ESPHOME_LOG_LEVEL_NONE);
+  bool ok = true;
+
+  int runs = quick ? 3 : 20;
+  printf("Time from connect to READY and to the droid showing a colour picked at READY, ms (%d connections per row)\n",
+         runs);
+  printf("Baseline: the fixed 200ms + 2000ms waits the handshake used before, modelled on the same link\n");
+  printf("%10s %8s %10s %10s %10s %10s %10s %10s\n", "latency", "jitter", "first", "reconn max", "ready avg",
+         "colour avg", "base ready", "base colour");
+  for (uint32_t latency : {5u, 15u, 30u, 60u, 100u})
+    ok &= host_test::isolated([=]() { time_to_ready_row(latency, runs); });
+
+  uint32_t seconds = quick ? 2 : 30;
+  printf("\nLED throughput during a continuous fade (%us, new colour every loop pass)\n", (unsigned) seconds);
+  printf("%10s %10s %10s %10s %12s %14s\n", "pacing ms", "batching", "rgb/s", "writes/s", "final lands",
+         "host us/sim s");
+  for (uint32_t interval : {20u, 50u, 100u}) {
+    for (bool batching : {false, true})
+      ok &= host_test::isolated([=]() { throughput_row(interval, batching, seconds); });
+  }
+  return ok ? 0 : 1;
+}
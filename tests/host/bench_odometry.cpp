@@ -0,0 +1,238 @@
+// Odometry replay benchmark: a drive recorded as 20Hz sensor data samples is replayed with the
+// frame arrival patterns a BLE link produces, through Odometry alone and through the hub's
+// notification handler on a READY hub.
+//
+// For each pattern it prints the final position error against the driven track, for the
+// measured time step and for a fixed one (one sample period per frame, regardless of arrival),
+// and the cost per sample. Host figures only; compare rows and runs, not against the ESP32.
+
+#include "parser_rig.h"
+
+#include "host_runtime.h"
+#include "sphero_bb8_odometry.h"
+
+#include "esphome/core/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using esphome::sphero_bb8::Odometry;
+using esphome::sphero_bb8::STREAM_CHANNEL_COUNT;
+using esphome::sphero_bb8::STREAM_VELOCITY_X;
+using esphome::sphero_bb8::STREAM_VELOCITY_Y;
+using esphome::sphero_bb8::STREAM_YAW;
+
+/// The ParserRig's stream runs at the default 20Hz.
+static const uint32_t SAMPLE_PERIOD_MS = 50;
+static const float DEGREES_TO_RADIANS = 3.14159265f / 180.0f;
+
+/// One leg of the drive: speed in mm/s and turn rate in degrees/s, held for `duration` ms.
+struct Leg {
+  uint32_t duration;
+  float speed;
+  float turn_rate;
+};
+
+// Laps of a square, a slalom and a stop, about 45s
+static const Leg DRIVE[] = {
+    {3000, 600, 0},  {1000, 200, 90}, {3000, 600, 0},   {1000, 200, 90},  {3000, 600, 0},  {1000, 200, 90},
+    {3000, 600, 0},  {1000, 200, 90}, {2000, 400, 45},  {2000, 400, -45}, {2000, 400, 45}, {2000, 400, -45},
+    {4000, 800, 10}, {1500, 0, 120},  {5000, 500, -20}, {2500, 300, 60},  {3000, 700, 0},  {3000, 0, 0},
+};
+
+struct Sample {
+  uint32_t at;
+  int16_t yaw;
+  int16_t velocity_x;
+  int16_t velocity_y;
+};
+
+struct Track {
+  std::vector<Sample> samples;
+  /// Position at the end of the drive, in cm.
+  float x{0.0f};
+  float y{0.0f};
+  float distance{0.0f};
+};
+
+/// Drives the legs in 1ms steps for the true track and takes a sample every period, like the droid.
+static Track record_drive() {
+  Track track;
+  float heading = 0.0f, x = 0.0f, y = 0.0f, distance = 0.0f;
+  uint32_t t = 0;
+  for (const auto &leg : DRIVE) {
+    for (uint32_t ms = 0; ms < leg.duration; ms++, t++) {
+      heading += leg.turn_rate * 0.001f;
+      float vx = leg.speed * std::sin(heading * DEGREES_TO_RADIANS);
+      float vy = leg.speed * std::cos(heading * DEGREES_TO_RADIANS);
+      x += vx * 0.001f;
+      y += vy * 0.001f;
+      distance += leg.speed * 0.001f;
+      if (t % SAMPLE_PERIOD_MS == SAMPLE_PERIOD_MS - 1) {
+        float yaw = std::fmod(heading, 360.0f);
+        track.samples.push_back({t + 1, static_cast<int16_t>(std::lround(yaw < 0.0f ? yaw + 360.0f : yaw)),
+                                 static_cast<int16_t>(std::lround(vx)), static_cast<int16_t>(std::lround(vy))});
+      }
+    }
+  }
+  track.x = x * 0.1f;
+  track.y = y * 0.1f;
+  track.distance = distance * 0.1f;
+  return track;
+}
+
+/// A sample as it reaches the hub: arrival time in ms since the drive started.
+struct Delivery {
+  const Sample *sample;
+  uint32_t at;
+};
+
+static const uint32_t CONNECTION_INTERVAL_MS = 45;
+
+static std::vector<Delivery> steady(const Track &track) {
+  std::vector<Delivery> out;
+  for (const auto &sample : track.samples)
+    out.push_back({&sample, sample.at + 10});
+  return out;
+}
+
+/// Notifications wait for the next connection event, so frames arrive in pairs and singles.
+static std::vector<Delivery> bunched(const Track &track) {
+  std::vector<Delivery> out;
+  for (const auto &sample : track.samples)
+    out.push_back({&sample, (sample.at / CONNECTION_INTERVAL_MS + 1) * CONNECTION_INTERVAL_MS});
+  return out;
+}
+
+static std::vector<Delivery> jittered(const Track &track) {
+  std::mt19937 random(1);
+  std::vector<Delivery> out;
+  uint32_t last = 0;
+  for (const auto &sample : track.samples) {
+    last = std::max(last, sample.at + static_cast<uint32_t>(random() % 40));
+    out.push_back({&sample, last});
+  }
+  return out;
+}
+
+/// Bunched, and 5% of the frames never arrive.
+static std::vector<Delivery> lossy(const Track &track) {
+  std::mt19937 random(2);
+  std::vector<Delivery> out;
+  for (const auto &delivery : bunched(track))
+    if (random() % 100 >= 5)
+      out.push_back(delivery);
+  return out;
+}
+
+static float error(const Odometry &odometry, const Track &track) {
+  float dx = odometry.get_x() - track.x;
+  float dy = odometry.get_y() - track.y;
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+/// Replays through Odometry alone and returns the ns per sample.
+static double replay(Odometry &odometry, const std::vector<Delivery> &deliveries, bool fixed_step, uint32_t rounds) {
+  auto started = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    odometry.reset();
+    uint32_t fixed_at = 0;
+    for (const auto &delivery : deliveries) {
+      fixed_at += SAMPLE_PERIOD_MS;
+      const Sample &sample = *delivery.sample;
+      odometry.update(sample.yaw, sample.velocity_x, sample.velocity_y, fixed_step ? fixed_at : delivery.at);
+    }
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  return elapsed * 1e9 / (static_cast<double>(rounds) * deliveries.size());
+}
+
+/// Replays through the hub's notification handler in simulated time and returns the ns per sample.
+static double replay_hub(host::ParserRig &rig, const std::vector<Delivery> &deliveries) {
+  rig.hub.reset_odometry();
+  uint32_t start = esphome::millis();
+  double elapsed = 0.0;
+  uint8_t frame[5 + STREAM_CHANNEL_COUNT * 2 + 1];
+  for (const auto &delivery : deliveries) {
+    uint32_t now = esphome::millis() - start;
+    if (delivery.at > now)
+      host::advance_time(delivery.at - now);
+
+    int16_t values[STREAM_CHANNEL_COUNT]{};
+    values[STREAM_YAW] = delivery.sample->yaw;
+    values[STREAM_VELOCITY_X] = delivery.sample->velocity_x;
+    values[STREAM_VELOCITY_Y] = delivery.sample->velocity_y;
+    size_t len = STREAM_CHANNEL_COUNT * 2 + 1;
+    frame[0] = 0xFF;
+    frame[1] = 0xFE;
+    frame[2] = 0x03;
+    frame[3] = len >> 8;
+    frame[4] = len & 0xFF;
+    for (uint8_t i = 0; i < STREAM_CHANNEL_COUNT; i++) {
+      frame[5 + i * 2] = static_cast<uint16_t>(values[i]) >> 8;
+      frame[6 + i * 2] = values[i] & 0xFF;
+    }
+    uint32_t sum = 0;
+    for (size_t i = 2; i < sizeof(frame) - 1; i++)
+      sum += frame[i];
+    frame[sizeof(frame) - 1] = ~sum & 0xFF;
+
+    auto started = std::chrono::steady_clock::now();
+    rig.hub.notify(frame, sizeof(frame));
+    elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  }
+  return elapsed * 1e9 / deliveries.size();
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  host::set_log_level(ESPHOME_LOG_LEVEL_NONE);
+  host::ParserRig rig;
+  if (!rig.ready) {
+    printf("droid did not become ready\n");
+    return 1;
+  }
+
+  Track track = record_drive();
+  uint32_t rounds = quick ? 10 : 10000;
+  printf("Odometry replay, %zu samples at %ums, %.0fcm driven, end at (%.0f, %.0f)cm\n", track.samples.size(),
+         (unsigned) SAMPLE_PERIOD_MS, track.distance, track.x, track.y);
+  printf("%-10s %8s %12s %12s %12s %12s\n", "arrival", "frames", "error cm", "fixed cm", "ns/sample", "hub ns/sample");
+
+  struct Pattern {
+    const char *name;
+    std::vector<Delivery> (*deliver)(const Track &);
+  };
+  const Pattern patterns[] = {{"steady", steady}, {"bunched", bunched}, {"jittered", jittered}, {"lossy", lossy}};
+  bool ok = true;
+  for (const auto &pattern : patterns) {
+    std::vector<Delivery> deliveries = pattern.deliver(track);
+    Odometry fixed;
+    fixed.set_sample_period(SAMPLE_PERIOD_MS * 0.001f);
+    replay(fixed, deliveries, true, 1);
+    Odometry measured;
+    measured.set_sample_period(SAMPLE_PERIOD_MS * 0.001f);
+    double ns = replay(measured, deliveries, false, rounds);
+    double hub_ns = replay_hub(rig, deliveries);
+
+    float measured_error = error(measured, track);
+    float hub_error = error(rig.hub.get_odometry(), track);
+    printf("%-10s %8zu %12.1f %12.1f %12.1f %12.1f\n", pattern.name, deliveries.size(), measured_error,
+           error(fixed, track), ns, hub_ns);
+    // The hub integrates the same samples at the same times, so it must land in the same place
+    if (std::fabs(hub_error - measured_error) > 0.5f) {
+      printf("%-10s hub ended %.1fcm off the track, Odometry alone %.1fcm\n", pattern.name, hub_error, measured_error);
+      ok = false;
+    }
+    if (measured_error > track.distance * 0.02f) {
+      printf("%-10s error above 2%% of the distance driven\n", pattern.name);
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
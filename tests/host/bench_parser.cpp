@@ -0,0 +1,137 @@
+// Receive path benchmark: frames/s and bytes/s through PacketAssembler alone, and through the
+// hub's notification handler (assembler, process_packet_() and the decoders) on a READY hub.
+//
+// Streams are cut into 20 byte notifications like the default MTU, so most frames arrive split.
+// Host figures only; compare rows and runs, not against the ESP32.
+
+#include "parser_rig.h"
+
+#include "host_runtime.h"
+#include "sphero_bb8_parser.h"
+
+#include "esphome/core/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using esphome::sphero_bb8::FrameView;
+using esphome::sphero_bb8::PacketAssembler;
+
+static const size_t NOTIFICATION_SIZE = 20;
+
+static void append_frame(std::vector<uint8_t> &stream, uint8_t sop2, uint8_t b2, uint8_t b3, uint8_t b4,
+                         const std::vector<uint8_t> &payload) {
+  size_t start = stream.size();
+  stream.insert(stream.end(), {0xFF, sop2, b2, b3, b4});
+  stream.insert(stream.end(), payload.begin(), payload.end());
+  uint32_t sum = 0;
+  for (size_t i = start + 2; i < stream.size(); i++)
+    sum += stream[i];
+  stream.push_back(~sum & 0xFF);
+}
+
+static void append_ack(std::vector<uint8_t> &stream, uint8_t seq) { append_frame(stream, 0xFF, 0x00, seq, 0x01, {}); }
+
+static void append_async(std::vector<uint8_t> &stream, uint8_t id, const std::vector<uint8_t> &payload) {
+  size_t len = payload.size() + 1;
+  append_frame(stream, 0xFE, id, len >> 8, len & 0xFF, payload);
+}
+
+static const std::vector<uint8_t> COLLISION = {0x00, 0x78, 0xFF, 0xB0, 0x00, 0x00, 0x01, 0x01,
+                                               0x2C, 0xFF, 0x6A, 0x5A, 0x00, 0x01, 0xE2, 0x40};
+static const std::vector<uint8_t> SENSOR_DATA = {0x00, 0x05, 0xFF, 0xFD, 0x01, 0x0E, 0x00, 0x64, 0xFF,
+                                                 0x38, 0x10, 0x00, 0x00, 0x0A, 0xFF, 0xF6, 0x00, 0x00,
+                                                 0x00, 0x96, 0xFF, 0xB5, 0x01, 0x90, 0xFF, 0xEC};
+
+/// Repeats `pattern` until the stream holds at least `bytes`, returning the number of frames.
+static uint32_t build_stream(std::vector<uint8_t> &stream, size_t bytes, void (*pattern)(std::vector<uint8_t> &)) {
+  uint32_t frames = 0;
+  std::vector<uint8_t> once;
+  pattern(once);
+  FrameView frame;
+  PacketAssembler counter;
+  counter.push(once.data(), once.size());
+  uint32_t per_pattern = 0;
+  while (counter.pop(frame))
+    per_pattern++;
+  while (stream.size() < bytes) {
+    stream.insert(stream.end(), once.begin(), once.end());
+    frames += per_pattern;
+  }
+  return frames;
+}
+
+static void acks(std::vector<uint8_t> &stream) {
+  for (uint8_t seq = 0; seq < 8; seq++)
+    append_ack(stream, 0x80 + seq);
+}
+static void collisions(std::vector<uint8_t> &stream) { append_async(stream, 0x07, COLLISION); }
+static void sensor_data(std::vector<uint8_t> &stream) { append_async(stream, 0x03, SENSOR_DATA); }
+static void mixed(std::vector<uint8_t> &stream) {
+  sensor_data(stream);
+  append_ack(stream, 0x80);
+  sensor_data(stream);
+  append_async(stream, 0x01, {0x02});
+  collisions(stream);
+  append_ack(stream, 0x81);
+}
+
+template<typename F> static double seconds(F body) {
+  auto started = std::chrono::steady_clock::now();
+  body();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+static bool row(host::ParserRig &rig, const char *name, void (*pattern)(std::vector<uint8_t> &), size_t bytes) {
+  std::vector<uint8_t> stream;
+  uint32_t frames = build_stream(stream, bytes, pattern);
+
+  PacketAssembler assembler;
+  uint32_t popped = 0;
+  double assembler_s = seconds([&]() {
+    FrameView frame;
+    for (size_t pos = 0; pos < stream.size(); pos += NOTIFICATION_SIZE) {
+      assembler.push(stream.data() + pos, std::min(NOTIFICATION_SIZE, stream.size() - pos));
+      while (assembler.pop(frame))
+        popped++;
+    }
+  });
+
+  uint32_t parsed_before = rig.hub.get_metrics().frames_parsed;
+  double hub_s = seconds([&]() {
+    for (size_t pos = 0; pos < stream.size(); pos += NOTIFICATION_SIZE)
+      rig.hub.notify(stream.data() + pos, std::min(NOTIFICATION_SIZE, stream.size() - pos));
+  });
+  uint32_t parsed = rig.hub.get_metrics().frames_parsed - parsed_before;
+  if (popped != frames || parsed != frames) {
+    printf("%-12s expected %u frames, assembler found %u, hub %u\n", name, (unsigned) frames, (unsigned) popped,
+           (unsigned) parsed);
+    return false;
+  }
+
+  printf("%-12s %10u %14.0f %10.1f %14.0f %10.1f\n", name, (unsigned) frames, frames / assembler_s,
+         stream.size() / assembler_s / 1e6, frames / hub_s, stream.size() / hub_s / 1e6);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  host::set_log_level(ESPHOME_LOG_LEVEL_NONE);
+  host::ParserRig rig;
+  if (!rig.ready) {
+    printf("droid did not become ready\n");
+    return 1;
+  }
+
+  size_t bytes = quick ? 64 * 1024 : 16 * 1024 * 1024;
+  printf("Receive path, %zu byte notifications (%zu KiB per row)\n", NOTIFICATION_SIZE, bytes / 1024);
+  printf("%-12s %10s %14s %10s %14s %10s\n", "stream", "frames", "assembler f/s", "MB/s", "hub f/s", "MB/s");
+  bool ok = row(rig, "acks", acks, bytes);
+  ok &= row(rig, "collisions", collisions, bytes);
+  ok &= row(rig, "sensor_data", sensor_data, bytes);
+  ok &= row(rig, "mixed", mixed, bytes);
+  return ok ? 0 : 1;
+}
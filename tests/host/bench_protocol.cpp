@@ -0,0 +1,62 @@
+// Encoder micro-benchmark: ns per packet for the std::vector encoder, encode_packet() and
+// Command<>::encode(), for a Ping (no payload), Set RGB (4 bytes) and Set Data Streaming (13 bytes).
+//
+// Host figures only; they show the relative cost of the allocation and the runtime header sum,
+// not what the ESP32 will measure.
+
+#include "host_test.h"
+#include "legacy_encoder.h"
+
+#include "sphero_bb8_protocol.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace esphome::sphero_bb8;
+
+// Keeps the compiler from dropping the encoded bytes
+static volatile uint8_t sink;
+
+template<typename F> static double ns_per_op(uint32_t iterations, F encode) {
+  auto started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++)
+    encode(static_cast<uint8_t>(i));
+  auto elapsed = std::chrono::steady_clock::now() - started;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+template<typename Cmd> static void row(const char *name, uint32_t iterations) {
+  typename Cmd::Payload payload;
+  for (size_t i = 0; i < payload.size(); i++)
+    payload[i] = i * 37;
+  std::vector<uint8_t> data(payload.begin(), payload.end());
+
+  double vector_ns = ns_per_op(iterations, [&](uint8_t seq) {
+    std::vector<uint8_t> packet = legacy::encode(Cmd::DEVICE_ID, Cmd::COMMAND_ID, seq, data);
+    sink = packet.back();
+  });
+  double buffer_ns = ns_per_op(iterations, [&](uint8_t seq) {
+    uint8_t out[MAX_PACKET_SIZE];
+    size_t size = encode_packet(out, Cmd::DEVICE_ID, Cmd::COMMAND_ID, seq, payload.data(), payload.size());
+    sink = out[size - 1];
+  });
+  double command_ns = ns_per_op(iterations, [&](uint8_t seq) {
+    typename Cmd::Packet packet;
+    Cmd::encode(packet, seq, payload);
+    sink = packet.back();
+  });
+  printf("%-18s %8zu %12.1f %14.1f %12.1f\n", name, Cmd::PAYLOAD_SIZE, vector_ns, buffer_ns, command_ns);
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  uint32_t iterations = quick ? 100000 : 10000000;
+
+  printf("Packet encoding, ns/op (%u packets per cell)\n", (unsigned) iterations);
+  printf("%-18s %8s %12s %14s %12s\n", "command", "payload", "vector", "encode_packet", "Command<>");
+  row<CmdPing>("Ping", iterations);
+  row<CmdSetRGB>("SetRGB", iterations);
+  row<CmdSetDataStreaming>("SetDataStreaming", iterations);
+  return 0;
+}
@@ -0,0 +1,199 @@
+// Fuzz target for the receive path: PacketAssembler::push()/pop() on their own, and the hub's
+// notification handler (assembler, process_packet_() and every decoder) on a READY hub.
+//
+// An input is a series of notifications, each a length byte followed by that many bytes (fewer
+// for the last one), so the fuzzer controls where frames are split as well as their content.
+//
+// Built with -fsanitize=fuzzer when the compiler has libFuzzer:
+//   fuzz_parser -max_len=1024 build/host/corpus tests/host/corpus
+// Otherwise main() below replays the seed corpus, every truncation and byte flip of each seed and
+// a fixed number of random mutations; ctest runs that form.
+
+#include "parser_rig.h"
+
+#include "host_runtime.h"
+#include "sphero_bb8_parser.h"
+
+#include "esphome/core/log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using esphome::sphero_bb8::FrameView;
+using esphome::sphero_bb8::PacketAssembler;
+
+#define FUZZ_CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: FUZZ_CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      abort(); \
+    } \
+  } while (0)
+
+/// Everything the assembler hands out must be a complete frame with a valid checksum.
+static void check_frame(const FrameView &frame) {
+  FUZZ_CHECK(frame.size() > FrameView::HEADER_SIZE);
+  FUZZ_CHECK(frame.size() <= PacketAssembler::CAPACITY);
+  FUZZ_CHECK(frame[0] == 0xFF);
+  FUZZ_CHECK(frame[1] == 0xFF || frame[1] == 0xFE);
+  size_t dlen = frame[1] == 0xFF ? frame[4] : (frame[3] << 8) | frame[4];
+  FUZZ_CHECK(frame.size() == FrameView::HEADER_SIZE + dlen);
+  uint32_t sum = 0;
+  for (size_t i = 2; i < frame.size() - 1; i++)
+    sum += frame[i];
+  FUZZ_CHECK((~sum & 0xFF) == frame[frame.size() - 1]);
+}
+
+static host::ParserRig *rig = nullptr;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (rig == nullptr) {
+    // Quiet unless SPHERO_LOG asks for the log, e.g. to follow a crashing input
+    if (getenv("SPHERO_LOG") == nullptr)
+      host::set_log_level(ESPHOME_LOG_LEVEL_NONE);
+    rig = new host::ParserRig();
+    FUZZ_CHECK(rig->ready);
+  }
+  rig->hub.expect_responses();
+  uint32_t parsed_before = rig->hub.get_metrics().frames_parsed;
+
+  PacketAssembler assembler;
+  uint32_t frames = 0;
+  size_t pos = 0;
+  while (pos < size) {
+    size_t len = data[pos++];
+    if (len > size - pos)
+      len = size - pos;
+    const uint8_t *chunk = data + pos;
+    pos += len;
+
+    // The same loop as SpheroBB8::handle_packet_()
+    const uint8_t *rest = chunk;
+    size_t left = len;
+    while (left > 0) {
+      size_t accepted = assembler.push(rest, left);
+      FUZZ_CHECK(accepted <= left);
+      rest += accepted;
+      left -= accepted;
+      FrameView frame;
+      while (assembler.pop(frame)) {
+        check_frame(frame);
+        frames++;
+      }
+      if (accepted == 0 && left > 0)
+        assembler.reset();
+    }
+
+    rig->hub.notify(chunk, len);
+  }
+
+  // The hub's assembler started empty too, so it must have found the same frames
+  FUZZ_CHECK(rig->hub.get_metrics().frames_parsed - parsed_before == frames);
+  host::advance_time(1);
+  return 0;
+}
+
+#ifndef SPHERO_LIBFUZZER
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using Input = std::vector<uint8_t>;
+
+static void run(const Input &input) { LLVMFuzzerTestOneInput(input.data(), input.size()); }
+
+static bool load(const std::string &path, std::vector<Input> &seeds) {
+  namespace fs = std::filesystem;
+  std::error_code error;
+  if (fs::is_directory(path, error)) {
+    std::vector<std::string> files;
+    for (const auto &entry : fs::directory_iterator(path))
+      if (entry.is_regular_file())
+        files.push_back(entry.path().string());
+    std::sort(files.begin(), files.end());
+    for (const auto &file : files)
+      if (!load(file, seeds))
+        return false;
+    return true;
+  }
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) {
+    fprintf(stderr, "Cannot read %s\n", path.c_str());
+    return false;
+  }
+  seeds.emplace_back(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+  return true;
+}
+
+int main(int argc, char **argv) {
+  uint32_t mutations = 20000;
+  std::vector<Input> seeds;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--mutations=", 12) == 0) {
+      mutations = strtoul(argv[i] + 12, nullptr, 10);
+    } else if (!load(argv[i], seeds)) {
+      return 1;
+    }
+  }
+  if (seeds.empty()) {
+    fprintf(stderr, "usage: %s [--mutations=N] <corpus dir or file>...\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t inputs = 0;
+  for (const auto &seed : seeds) {
+    run(seed);
+    for (size_t len = 0; len < seed.size(); len++) {
+      run(Input(seed.begin(), seed.begin() + len));
+      Input flipped = seed;
+      flipped[len] ^= 0xFF;
+      run(flipped);
+      inputs += 2;
+    }
+    inputs++;
+  }
+
+  std::mt19937 random(1);
+  for (uint32_t i = 0; i < mutations; i++) {
+    Input input = seeds[random() % seeds.size()];
+    int edits = 1 + random() % 8;
+    for (int edit = 0; edit < edits; edit++) {
+      size_t at = input.empty() ? 0 : random() % input.size();
+      switch (random() % 4) {
+        case 0:
+          if (!input.empty())
+            input[at] ^= 1 << (random() % 8);
+          break;
+        case 1:
+          input.insert(input.begin() + at, static_cast<uint8_t>(random()));
+          break;
+        case 2:
+          if (!input.empty())
+            input.erase(input.begin() + at);
+          break;
+        default: {
+          // Splice in part of another seed
+          const Input &other = seeds[random() % seeds.size()];
+          size_t from = other.empty() ? 0 : random() % other.size();
+          input.insert(input.begin() + at, other.begin() + from, other.end());
+          break;
+        }
+      }
+    }
+    run(input);
+    inputs++;
+  }
+
+  printf("%u seeds, %u inputs, %u frames parsed, %u checksum failures, %u resync bytes\n",
+         (unsigned) seeds.size(), (unsigned) inputs, (unsigned) rig->hub.get_metrics().frames_parsed,
+         (unsigned) rig->hub.get_checksum_failures(), (unsigned) rig->hub.get_resync_bytes());
+  return 0;
+}
+
+#endif  // SPHERO_LIBFUZZER
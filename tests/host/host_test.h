@@ -0,0 +1,96 @@
+#pragma once
+
+// Minimal test runner for the host tests: TEST() registers a case, CHECK*() record failures and
+// keep going, and main() runs every case (or those whose name contains argv[1]).
+//
+// Each case runs in a forked child, so static state in the component (the airtime arbiter shared
+// by all hubs, parsed UUIDs, saved preferences) starts fresh as it would after a reboot.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace host_test {
+
+struct Case {
+  const char *name;
+  void (*run)();
+};
+
+inline std::vector<Case> &cases() {
+  static std::vector<Case> all;
+  return all;
+}
+
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+struct Registrar {
+  Registrar(const char *name, void (*run)()) { cases().push_back(Case{name, run}); }
+};
+
+/// Runs `body` in a child process and returns whether it finished without failed checks.
+inline bool isolated(const std::function<void()> &body) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    body();
+    fflush(stdout);
+    _exit(failures() == 0 ? 0 : 1);
+  }
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid)
+    return false;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+inline int run_all(int argc, char **argv) {
+  int ran = 0;
+  int failed = 0;
+  for (const auto &test : cases()) {
+    if (argc > 1 && strstr(test.name, argv[1]) == nullptr)
+      continue;
+    bool ok = isolated(test.run);
+    printf("%s %s\n", ok ? "[ OK ]" : "[FAIL]", test.name);
+    ran++;
+    failed += ok ? 0 : 1;
+  }
+  printf("%d tests, %d failed\n", ran, failed);
+  return failed == 0 && ran > 0 ? 0 : 1;
+}
+
+}  // namespace host_test
+
+#define TEST(name) \
+  static void test_##name(); \
+  static host_test::Registrar registrar_##name(#name, test_##name); \
+  static void test_##name()
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      host_test::failures()++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long actual_value = (long long) (actual); \
+    long long expected_value = (long long) (expected); \
+    if (actual_value != expected_value) { \
+      printf("  %s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #actual, #expected, \
+             actual_value, expected_value); \
+      host_test::failures()++; \
+    } \
+  } while (0)
+
+#define TEST_MAIN() \
+  int main(int argc, char **argv) { return host_test::run_all(argc, argv); }
@@ -0,0 +1,30 @@
+#pragma once
+
+// The std::vector packet encoder that send_packet() used before the fixed-buffer encoder, kept as
+// the reference for test_protocol and bench_protocol.
+
+#include <cstdint>
+#include <vector>
+
+namespace legacy {
+
+inline uint8_t calculate_checksum(uint8_t did, uint8_t cid, uint8_t seq, const std::vector<uint8_t> &data) {
+  uint32_t sum = did + cid + seq + (data.size() + 1);
+  for (uint8_t b : data) sum += b;
+  return ~(sum % 256) & 0xFF;
+}
+
+inline std::vector<uint8_t> encode(uint8_t did, uint8_t cid, uint8_t seq, const std::vector<uint8_t> &data) {
+  uint8_t dlen = data.size() + 1;
+  uint8_t checksum = calculate_checksum(did, cid, seq, data);
+
+  std::vector<uint8_t> packet;
+  packet.push_back(0xFF); packet.push_back(0xFF);
+  packet.push_back(did); packet.push_back(cid);
+  packet.push_back(seq); packet.push_back(dlen);
+  packet.insert(packet.end(), data.begin(), data.end());
+  packet.push_back(checksum);
+  return packet;
+}
+
+}  // namespace legacy
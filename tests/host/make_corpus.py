@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Write the seed corpus of the parser fuzzer (tests/host/corpus/).
+
+Each seed is a series of notifications in the fuzz_parser input format: a length byte followed by
+that many bytes. The frames are the ones a BB-8 sends (power state, version, collision, ACK and
+so on), split at different points: whole, byte by byte, at the 20 byte notification size, at
+odd boundaries and several frames to a notification. Sync responses use the sequence numbers
+ParserHub::expect_responses() registers.
+
+    python3 tests/host/make_corpus.py
+"""
+
+import os
+
+CORPUS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "corpus")
+
+SEQ_POWER_STATE = 0
+SEQ_VERSION = 1
+SEQ_INACTIVITY_TIMEOUT = 2
+SEQ_LINK_PROBE = 3
+SEQ_ACK = 4
+
+
+def checksum(data):
+    return ~sum(data) & 0xFF
+
+
+def response(seq, payload=b"", mrsp=0x00):
+    body = bytes([mrsp, seq, len(payload) + 1]) + bytes(payload)
+    return b"\xff\xff" + body + bytes([checksum(body)])
+
+
+def async_frame(id_code, payload=b""):
+    length = len(payload) + 1
+    body = bytes([id_code, length >> 8, length & 0xFF]) + bytes(payload)
+    return b"\xff\xfe" + body + bytes([checksum(body)])
+
+
+def s16(value):
+    return (value & 0xFFFF).to_bytes(2, "big")
+
+
+POWER_STATE = response(SEQ_POWER_STATE, [0x01, 0x02, 0x03, 0x0C, 0x00, 0x10, 0x00, 0x3C])
+VERSION = response(SEQ_VERSION, [0x02, 0x07, 0x01, 0x04, 0x45, 0x33, 0x40, 0x04, 0x01, 0x0A])
+INACTIVITY_ACK = response(SEQ_INACTIVITY_TIMEOUT)
+PROBE_ACK = response(SEQ_LINK_PROBE)
+ACK = response(SEQ_ACK)
+ERROR = response(SEQ_ACK, mrsp=0x05)
+UNSOLICITED = response(0x80)
+POWER_NOTIFICATION = async_frame(0x01, [0x01])
+COLLISION = async_frame(
+    0x07, s16(120) + s16(-80) + s16(0) + bytes([0x01]) + s16(300) + s16(-150) + bytes([90]) + (123456).to_bytes(4, "big")
+)
+SENSOR_DATA = async_frame(0x03, b"".join(s16(v) for v in [5, -3, 270, 100, -200, 4096, 10, -10, 0, 150, -75, 400, -20]))
+PRE_SLEEP = async_frame(0x05)
+MACRO_MARKER = async_frame(0x06, [0x01, 0xFF, 0x00, 0x02])
+UNKNOWN_ASYNC = async_frame(0x42, [0x00, 0x01, 0x02])
+
+
+def split(data, sizes):
+    """Splits `data` into notifications of the given sizes, repeating the last size."""
+    chunks = []
+    pos = 0
+    index = 0
+    while pos < len(data):
+        size = sizes[min(index, len(sizes) - 1)]
+        chunks.append(data[pos : pos + size])
+        pos += size
+        index += 1
+    return chunks
+
+
+def encode(chunks):
+    return b"".join(bytes([len(chunk)]) + chunk for chunk in chunks)
+
+
+SEEDS = {
+    "power_state_whole": [POWER_STATE],
+    "power_state_bytewise": split(POWER_STATE, [1]),
+    "version_whole": [VERSION],
+    "version_split_3_5": split(VERSION, [3, 5]),
+    "collision_mtu20": split(COLLISION, [20]),
+    "collision_split_header": split(COLLISION, [2, 3, 7]),
+    "sensor_data_mtu20": split(SENSOR_DATA, [20]),
+    "acks_in_one_notification": [ACK + INACTIVITY_ACK + PROBE_ACK],
+    "ack_split_after_sop": split(ACK, [1, 5]),
+    "power_notification": [POWER_NOTIFICATION],
+    "mixed_stream_mtu20": split(POWER_STATE + COLLISION + VERSION + ACK + POWER_NOTIFICATION, [20]),
+    "mixed_stream_odd_splits": split(SENSOR_DATA + ACK + COLLISION + POWER_STATE, [7, 13, 1, 19]),
+    "garbage_before_frame": [b"\x00\x12\xff\x34", ACK],
+    "bad_checksum_then_frame": [VERSION[:-1] + bytes([VERSION[-1] ^ 0xFF]) + POWER_STATE],
+    "error_and_unsolicited": [ERROR, UNSOLICITED],
+    "async_without_decoder": [UNKNOWN_ASYNC, PRE_SLEEP, MACRO_MARKER],
+    "trailing_sop": [ACK + b"\xff", b"\xff" + POWER_STATE[2:]],
+}
+
+
+def main():
+    os.makedirs(CORPUS_DIR, exist_ok=True)
+    for name, chunks in SEEDS.items():
+        with open(os.path.join(CORPUS_DIR, name + ".bin"), "wb") as out:
+            out.write(encode(chunks))
+
+
+if __name__ == "__main__":
+    main()
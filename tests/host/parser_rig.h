@@ -0,0 +1,113 @@
+#pragma once
+
+// A hub brought to READY on the simulator whose receive path is then fed directly, for the
+// parser fuzzer and the receive path benchmarks. Notifications go through gattc_event_handler() like the stack's,
+// so the whole path (capture, metrics, PacketAssembler, process_packet_() and the decoders) runs.
+
+#include "simulator.h"
+#include "virtual_bb8.h"
+
+#include "sphero_bb8.h"
+
+namespace host {
+
+/// SpheroBB8 with its receive path and request table opened up for tests.
+class ParserHub : public esphome::sphero_bb8::SpheroBB8 {
+ public:
+  /// Sequence numbers expect_responses() registers, one per response decoder.
+  static const uint8_t SEQ_POWER_STATE = 0;
+  static const uint8_t SEQ_VERSION = 1;
+  static const uint8_t SEQ_INACTIVITY_TIMEOUT = 2;
+  static const uint8_t SEQ_LINK_PROBE = 3;
+  static const uint8_t SEQ_ACK = 4;
+
+  const esphome::sphero_bb8::Odometry &get_odometry() const { return this->odometry_; }
+
+  /// Delivers `data` as one notification on the responses characteristic.
+  void notify(const uint8_t *data, size_t len) {
+    esp_ble_gattc_cb_param_t param{};
+    param.notify.conn_id = this->parent()->get_conn_id();
+    param.notify.handle = this->char_handle_responses_;
+    param.notify.value = const_cast<uint8_t *>(data);
+    param.notify.value_len = len;
+    this->gattc_event_handler(ESP_GATTC_NOTIFY_EVT, this->parent()->get_gattc_if(), &param);
+  }
+
+  /// Drops buffered bytes and in-flight requests, then registers one request per response
+  /// decoder so that sync responses reach the decoders as well as the request table.
+  void expect_responses() {
+    using esphome::sphero_bb8::TxRequest;
+    this->rx_assembler_.reset();
+    this->requests_.clear();
+    struct Expected {
+      uint8_t seq;
+      uint8_t did;
+      uint8_t cid;
+      esphome::sphero_bb8::ResponseHandler handler;
+    };
+    const Expected expected[] = {
+        {SEQ_POWER_STATE, 0x00, 0x20, &ParserHub::handle_power_state_},
+        {SEQ_VERSION, 0x00, 0x02, &ParserHub::handle_version_},
+        {SEQ_INACTIVITY_TIMEOUT, 0x00, 0x25, &ParserHub::handle_inactivity_timeout_},
+        {SEQ_LINK_PROBE, 0x00, 0x01, &ParserHub::handle_link_probe_},
+        {SEQ_ACK, 0x02, 0x20, nullptr},
+    };
+    for (const auto &entry : expected) {
+      TxRequest request{};
+      request.did = entry.did;
+      request.cid = entry.cid;
+      request.on_response = entry.handler;
+      this->requests_.add(entry.seq, request, esphome::millis());
+    }
+  }
+};
+
+/// A READY hub with every sensor the decoders publish to, including all stream channels and
+/// the odometry, and a virtual droid on a default link.
+struct ParserRig {
+  ParserRig() {
+    using namespace esphome::sphero_bb8;
+    this->client.set_address(0xE8BCE1D6A001);
+    this->client.register_ble_node(&this->hub);
+    this->sim.add_link(&this->client, &this->droid);
+
+    this->hub.set_auto_connect(true);
+    this->hub.set_status_sensor(&this->status);
+    this->hub.set_battery_sensor(&this->battery);
+    this->hub.set_version_sensor(&this->version);
+    this->hub.set_charging_status_sensor(&this->charging);
+    this->hub.set_collision_sensor(&this->collision);
+    this->hub.set_collision_speed_sensor(&this->collision_speed);
+    this->hub.set_collision_magnitude_sensor(&this->collision_magnitude);
+    this->hub.set_link_rtt_sensor(&this->link_rtt);
+    for (uint8_t channel = 0; channel < STREAM_CHANNEL_COUNT; channel++)
+      this->hub.set_stream_sensor(static_cast<StreamChannel>(channel), &this->stream[channel]);
+    this->hub.set_odometry_x_sensor(&this->odometry[0]);
+    this->hub.set_odometry_y_sensor(&this->odometry[1]);
+    this->hub.set_odometry_heading_sensor(&this->odometry[2]);
+    this->hub.set_odometry_distance_sensor(&this->odometry[3]);
+    this->sim.add_component(&this->hub);
+
+    this->sim.setup();
+    this->ready = this->sim.run_until([this]() { return this->hub.is_ready(); }, 5000);
+  }
+
+  Simulator sim;
+  esphome::ble_client::BLEClient client;
+  ParserHub hub;
+  VirtualBB8 droid;
+  bool ready{false};
+
+  esphome::text_sensor::TextSensor status;
+  esphome::text_sensor::TextSensor version;
+  esphome::text_sensor::TextSensor charging;
+  esphome::sensor::Sensor battery;
+  esphome::binary_sensor::BinarySensor collision;
+  esphome::sensor::Sensor collision_speed;
+  esphome::sensor::Sensor collision_magnitude;
+  esphome::sensor::Sensor link_rtt;
+  esphome::sensor::Sensor stream[esphome::sphero_bb8::STREAM_CHANNEL_COUNT];
+  esphome::sensor::Sensor odometry[4];
+};
+
+}  // namespace host
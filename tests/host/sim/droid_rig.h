@@ -0,0 +1,67 @@
+#pragma once
+
+#include "simulator.h"
+#include "virtual_bb8.h"
+
+#include "sphero_bb8.h"
+#include "sphero_bb8_light.h"
+
+namespace host {
+
+/// A hub wired up like the example configuration: BLE client, RGB and tail lights, the common
+/// sensors, and a virtual droid on its own simulated link. Adjust `hub` before Simulator::setup().
+struct DroidRig {
+  DroidRig(Simulator &sim, uint64_t address, const LinkConfig &config = {}) : sim(sim) {
+    this->client.set_address(address);
+    this->client.register_ble_node(&this->hub);
+    this->link = sim.add_link(&this->client, &this->droid, config);
+
+    this->hub.set_auto_connect(true);
+    this->hub.set_status_sensor(&this->status);
+    this->hub.set_battery_sensor(&this->battery);
+    this->hub.set_version_sensor(&this->version);
+    this->hub.set_charging_status_sensor(&this->charging);
+    this->hub.set_collision_sensor(&this->collision);
+    this->hub.set_handshake_time_sensor(&this->handshake_time);
+    sim.add_component(&this->hub);
+
+    this->rgb_output.set_parent(&this->hub);
+    this->rgb_output.set_type(esphome::sphero_bb8::LIGHT_TYPE_RGB);
+    this->tail_output.set_parent(&this->hub);
+    this->tail_output.set_type(esphome::sphero_bb8::LIGHT_TYPE_TAILLIGHT);
+    sim.add_component(&this->rgb_output);
+    sim.add_component(&this->tail_output);
+    sim.add_component(&this->rgb);
+    sim.add_component(&this->tail);
+  }
+
+  bool wait_ready(uint32_t timeout = 5000) {
+    return this->sim.run_until([this]() { return this->hub.is_ready(); }, timeout);
+  }
+
+  /// Turns the RGB light on with the given colour, as a Home Assistant light call would.
+  void set_color(float red, float green, float blue, uint32_t transition = 0) {
+    this->rgb.make_call().set_state(true).set_brightness(1.0f).set_rgb(red, green, blue)
+        .set_transition_length(transition).perform();
+  }
+
+  Simulator &sim;
+  esphome::ble_client::BLEClient client;
+  esphome::sphero_bb8::SpheroBB8 hub;
+  VirtualBB8 droid;
+  size_t link{0};
+
+  esphome::sphero_bb8::SpheroBB8Light rgb_output;
+  esphome::sphero_bb8::SpheroBB8Light tail_output;
+  esphome::light::LightState rgb{&rgb_output};
+  esphome::light::LightState tail{&tail_output};
+
+  esphome::text_sensor::TextSensor status;
+  esphome::text_sensor::TextSensor version;
+  esphome::text_sensor::TextSensor charging;
+  esphome::sensor::Sensor battery;
+  esphome::sensor::Sensor handshake_time;
+  esphome::binary_sensor::BinarySensor collision;
+};
+
+}  // namespace host
@@ -0,0 +1,361 @@
+#include "simulator.h"
+
+#include "host_runtime.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace host {
+
+using esphome::ble_client::BLEClient;
+namespace espbt = esphome::esp32_ble_tracker;
+
+Simulator::Simulator(uint32_t seed) : rng_(seed) {
+  reset_timers();
+  set_ble_backend(this);
+}
+
+Simulator::~Simulator() {
+  set_ble_backend(nullptr);
+  reset_timers();
+}
+
+size_t Simulator::add_link(BLEClient *client, VirtualBB8 *droid, const LinkConfig &config) {
+  Link link{};
+  link.client = client;
+  link.droid = droid;
+  link.config = config;
+  link.state = LINK_IDLE;
+  this->links_.push_back(link);
+  this->add_component(client);
+  return this->links_.size() - 1;
+}
+
+void Simulator::add_component(esphome::Component *component) { this->components_.push_back(component); }
+
+void Simulator::setup() {
+  std::stable_sort(this->components_.begin(), this->components_.end(),
+                   [](esphome::Component *a, esphome::Component *b) {
+                     return a->get_setup_priority() > b->get_setup_priority();
+                   });
+  for (auto *component : this->components_)
+    this->call_component_([component]() { component->setup(); });
+}
+
+void Simulator::step() {
+  this->call_component_([]() { run_timers(); });
+  for (size_t i = 0; i < this->links_.size(); i++)
+    this->update_link_(i);
+  this->deliver_events_();
+  for (auto *component : this->components_) {
+    if (component->is_loop_enabled())
+      this->call_component_([component]() { component->loop(); });
+  }
+  this->loop_passes++;
+  advance_time(this->loop_interval);
+}
+
+void Simulator::run_for(uint32_t ms) {
+  uint32_t end = esphome::millis() + ms;
+  while (static_cast<int32_t>(esphome::millis() - end) < 0)
+    this->step();
+}
+
+bool Simulator::run_until(const std::function<bool()> &condition, uint32_t timeout_ms) {
+  uint32_t end = esphome::millis() + timeout_ms;
+  while (!condition()) {
+    if (static_cast<int32_t>(esphome::millis() - end) >= 0)
+      return false;
+    this->step();
+  }
+  return true;
+}
+
+void Simulator::drop_link(size_t link) {
+  if (this->links_[link].state != LINK_IDLE)
+    this->disconnect_(link);
+}
+
+bool Simulator::is_connected(size_t link) const { return this->links_[link].state == LINK_CONNECTED; }
+
+void Simulator::call_component_(const std::function<void()> &call) {
+  this->in_component_ = true;
+  if (this->guard_)
+    this->guard_(true);
+  call();
+  if (this->guard_)
+    this->guard_(false);
+  this->in_component_ = false;
+}
+
+void Simulator::update_link_(size_t index) {
+  Link &link = this->links_[index];
+  uint32_t now = esphome::millis();
+  BLEClient *client = link.client;
+  esp_ble_gattc_cb_param_t param{};
+
+  switch (link.state) {
+    case LINK_IDLE:
+      if (client->enabled && client->get_auto_connect()) {
+        link.state = LINK_CONNECTING;
+        link.state_at = now;
+      }
+      break;
+    case LINK_CONNECTING:
+      if (!client->enabled) {
+        link.state = LINK_IDLE;
+      } else if (now - link.state_at >= link.config.connect_delay) {
+        link.conn_id = ++this->next_conn_id_;
+        link.state = LINK_DISCOVERING;
+        link.state_at = now;
+        link.connected_at = now;
+        link.last_arrival = now;
+        client->host_set_connection(true, link.conn_id);
+        param.connect.conn_id = link.conn_id;
+        memcpy(param.connect.remote_bda, client->get_remote_bda(), sizeof(esp_bd_addr_t));
+        this->queue_event_(index, now, ESP_GATTC_CONNECT_EVT, param);
+      }
+      break;
+    case LINK_DISCOVERING:
+      if (!client->enabled) {
+        this->disconnect_(index);
+      } else if (now - link.state_at >= link.config.discovery_delay) {
+        for (size_t i = 0; i < VirtualBB8::CHARACTERISTIC_COUNT; i++) {
+          const auto &characteristic = VirtualBB8::CHARACTERISTICS[i];
+          if (characteristic.handle == VirtualBB8::HANDLE_TX_POWER && !link.droid->has_tx_power)
+            continue;
+          client->host_add_characteristic(espbt::ESPBTUUID::from_raw(characteristic.service),
+                                          espbt::ESPBTUUID::from_raw(characteristic.uuid), characteristic.handle);
+        }
+        link.state = LINK_CONNECTED;
+        param.search_cmpl.status = ESP_GATT_OK;
+        param.search_cmpl.conn_id = link.conn_id;
+        this->queue_event_(index, now, ESP_GATTC_SEARCH_CMPL_EVT, param);
+      }
+      break;
+    case LINK_CONNECTED:
+      if (!client->enabled) {
+        this->disconnect_(index);
+      } else {
+        // Notifications the droid sent on its own, e.g. collisions or power changes
+        this->queue_frames_(index, link.config.latency);
+      }
+      break;
+  }
+}
+
+void Simulator::disconnect_(size_t index) {
+  Link &link = this->links_[index];
+  uint32_t now = esphome::millis();
+  // Nothing of the old connection arrives after the disconnect
+  this->events_.erase(std::remove_if(this->events_.begin(), this->events_.end(),
+                                     [index](const Event &event) { return event.link == index; }),
+                      this->events_.end());
+  link.droid->take_outbox();
+  link.droid->on_disconnect();
+  link.state = LINK_IDLE;
+  link.client->host_set_connection(false, 0);
+
+  esp_ble_gattc_cb_param_t param{};
+  param.disconnect.conn_id = link.conn_id;
+  param.disconnect.reason = 0x13;
+  memcpy(param.disconnect.remote_bda, link.client->get_remote_bda(), sizeof(esp_bd_addr_t));
+  this->queue_event_(index, now, ESP_GATTC_DISCONNECT_EVT, param);
+}
+
+Simulator::Link *Simulator::find_link_(uint16_t conn_id) {
+  for (auto &link : this->links_) {
+    if (link.state != LINK_IDLE && link.state != LINK_CONNECTING && link.conn_id == conn_id)
+      return &link;
+  }
+  return nullptr;
+}
+
+Simulator::Link *Simulator::find_link_(const uint8_t *bda) {
+  for (auto &link : this->links_) {
+    if (link.state != LINK_IDLE && link.state != LINK_CONNECTING &&
+        memcmp(link.client->get_remote_bda(), bda, sizeof(esp_bd_addr_t)) == 0)
+      return &link;
+  }
+  return nullptr;
+}
+
+size_t Simulator::index_of_(const Link *link) const { return static_cast<size_t>(link - this->links_.data()); }
+
+uint32_t Simulator::arrival_(Link &link, uint32_t delay) {
+  uint32_t at = esphome::millis() + delay;
+  if (link.config.jitter > 0)
+    at += this->rng_() % (link.config.jitter + 1);
+  if (static_cast<int32_t>(at - link.last_arrival) < 0)
+    at = link.last_arrival;
+  link.last_arrival = at;
+  return at;
+}
+
+void Simulator::queue_event_(size_t link, uint32_t at, esp_gattc_cb_event_t event,
+                             const esp_ble_gattc_cb_param_t &param, std::vector<uint8_t> value) {
+  Event queued{};
+  queued.at = at;
+  queued.order = this->next_order_++;
+  queued.link = link;
+  queued.gap = false;
+  queued.event = event;
+  queued.param = param;
+  queued.value = std::move(value);
+  this->events_.push_back(std::move(queued));
+}
+
+void Simulator::queue_frames_(size_t index, uint32_t delay) {
+  Link &link = this->links_[index];
+  std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+  for (auto &frame : link.droid->take_outbox()) {
+    if (link.config.loss > 0.0f && chance(this->rng_) < link.config.loss) {
+      this->frames_lost++;
+      continue;
+    }
+    for (size_t offset = 0; offset < frame.size();) {
+      size_t piece = std::min(frame.size() - offset, link.config.fragment);
+      if (link.config.random_fragments)
+        piece = std::min(piece, static_cast<size_t>(1 + this->rng_() % link.config.fragment));
+      esp_ble_gattc_cb_param_t param{};
+      param.notify.conn_id = link.conn_id;
+      memcpy(param.notify.remote_bda, link.client->get_remote_bda(), sizeof(esp_bd_addr_t));
+      param.notify.handle = VirtualBB8::HANDLE_RESPONSES;
+      param.notify.is_notify = true;
+      this->queue_event_(index, this->arrival_(link, delay), ESP_GATTC_NOTIFY_EVT, param,
+                         std::vector<uint8_t>(frame.begin() + offset, frame.begin() + offset + piece));
+      offset += piece;
+    }
+  }
+}
+
+void Simulator::deliver_events_() {
+  uint32_t now = esphome::millis();
+  while (true) {
+    auto next = this->events_.end();
+    for (auto it = this->events_.begin(); it != this->events_.end(); ++it) {
+      if (static_cast<int32_t>(now - it->at) < 0)
+        continue;
+      if (next == this->events_.end() || it->at < next->at || (it->at == next->at && it->order < next->order))
+        next = it;
+    }
+    if (next == this->events_.end())
+      return;
+
+    Event event = std::move(*next);
+    this->events_.erase(next);
+    BLEClient *client = this->links_[event.link].client;
+    this->events_delivered++;
+    if (event.gap) {
+      this->call_component_([&]() { client->gap_event_handler(event.gap_event, &event.gap_param); });
+      continue;
+    }
+    if (event.event == ESP_GATTC_NOTIFY_EVT) {
+      event.param.notify.value = event.value.data();
+      event.param.notify.value_len = static_cast<uint16_t>(event.value.size());
+      this->notifications_delivered++;
+    }
+    this->call_component_([&]() { client->gattc_event_handler(event.event, client->get_gattc_if(), &event.param); });
+  }
+}
+
+esp_err_t Simulator::write_char(uint16_t conn_id, uint16_t handle, const uint8_t *data, size_t len,
+                                bool with_response) {
+  BackendScope scope(this);
+  Link *link = this->find_link_(conn_id);
+  if (link == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  size_t index = this->index_of_(link);
+  uint32_t now = esphome::millis();
+
+  esp_ble_gattc_cb_param_t param{};
+  param.write.status = link->droid->on_write(handle, data, len, now + link->config.latency);
+  param.write.conn_id = conn_id;
+  param.write.handle = handle;
+  if (with_response) {
+    this->queue_event_(index, this->arrival_(*link, 2 * link->config.latency), ESP_GATTC_WRITE_CHAR_EVT, param);
+  } else {
+    // The stack reports a write without response as soon as it is handed to the controller
+    param.write.status = ESP_GATT_OK;
+    this->queue_event_(index, now + link->config.write_cmd_delay, ESP_GATTC_WRITE_CHAR_EVT, param);
+  }
+  // The droid answers once the command has reached it
+  this->queue_frames_(index, 2 * link->config.latency);
+  return ESP_OK;
+}
+
+esp_err_t Simulator::register_for_notify(const uint8_t *bda, uint16_t handle) {
+  BackendScope scope(this);
+  Link *link = this->find_link_(bda);
+  if (link == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  esp_ble_gattc_cb_param_t param{};
+  param.reg_for_notify.status = link->droid->on_subscribe(handle) ? ESP_GATT_OK : ESP_GATT_INVALID_HANDLE;
+  param.reg_for_notify.handle = handle;
+  this->queue_event_(this->index_of_(link), this->arrival_(*link, 2 * link->config.latency),
+                     ESP_GATTC_REG_FOR_NOTIFY_EVT, param);
+  return ESP_OK;
+}
+
+esp_err_t Simulator::send_mtu_req(uint16_t conn_id) {
+  BackendScope scope(this);
+  Link *link = this->find_link_(conn_id);
+  if (link == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  esp_ble_gattc_cb_param_t param{};
+  param.cfg_mtu.status = ESP_GATT_OK;
+  param.cfg_mtu.conn_id = conn_id;
+  param.cfg_mtu.mtu = link->config.mtu;
+  this->queue_event_(this->index_of_(link), this->arrival_(*link, 2 * link->config.latency), ESP_GATTC_CFG_MTU_EVT,
+                     param);
+  return ESP_OK;
+}
+
+esp_err_t Simulator::read_rssi(const uint8_t *bda) {
+  BackendScope scope(this);
+  Link *link = this->find_link_(bda);
+  if (link == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  Event event{};
+  event.at = this->arrival_(*link, link->config.latency);
+  event.order = this->next_order_++;
+  event.link = this->index_of_(link);
+  event.gap = true;
+  event.gap_event = ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT;
+  event.gap_param.read_rssi_cmpl.status = ESP_BT_STATUS_SUCCESS;
+  event.gap_param.read_rssi_cmpl.rssi = link->config.rssi;
+  memcpy(event.gap_param.read_rssi_cmpl.remote_addr, bda, sizeof(esp_bd_addr_t));
+  this->events_.push_back(std::move(event));
+  return ESP_OK;
+}
+
+esp_err_t Simulator::cache_clean(const uint8_t *bda) {
+  BackendScope scope(this);
+  this->cache_cleans++;
+  return ESP_OK;
+}
+
+esp_gatt_status_t Simulator::get_db(uint16_t conn_id, uint16_t start_handle, uint16_t end_handle,
+                                    esp_gattc_db_elem_t *db, uint16_t *count) {
+  BackendScope scope(this);
+  Link *link = this->find_link_(conn_id);
+  if (link == nullptr || link->state != LINK_CONNECTED)
+    return ESP_GATT_ERROR;
+  uint16_t found = 0;
+  for (size_t i = 0; i < VirtualBB8::CHARACTERISTIC_COUNT && found < *count; i++) {
+    const auto &characteristic = VirtualBB8::CHARACTERISTICS[i];
+    if (characteristic.handle < start_handle || characteristic.handle > end_handle)
+      continue;
+    if (characteristic.handle == VirtualBB8::HANDLE_TX_POWER && !link->droid->has_tx_power)
+      continue;
+    esp_gattc_db_elem_t &elem = db[found++];
+    elem = esp_gattc_db_elem_t{};
+    elem.type = ESP_GATT_DB_CHARACTERISTIC;
+    elem.attribute_handle = characteristic.handle;
+    elem.uuid = espbt::ESPBTUUID::from_raw(characteristic.uuid).get_uuid();
+  }
+  *count = found;
+  return found > 0 ? ESP_GATT_OK : ESP_GATT_INVALID_HANDLE;
+}
+
+}  // namespace host
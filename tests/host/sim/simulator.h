@@ -0,0 +1,154 @@
+#pragma once
+
+#include "host_ble.h"
+#include "virtual_bb8.h"
+
+#include "esphome/components/ble_client/ble_client.h"
+#include "esphome/core/component.h"
+
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace host {
+
+/// Transport between the ESP32 and one droid.
+struct LinkConfig {
+  /// From auto-connect to CONNECT_EVT (scan plus connection setup).
+  uint32_t connect_delay{150};
+  /// From CONNECT_EVT to SEARCH_CMPL_EVT.
+  uint32_t discovery_delay{250};
+  /// One-way delay of every GATT operation and notification.
+  uint32_t latency{15};
+  /// Extra random delay of up to this many ms; order on the link is kept.
+  uint32_t jitter{0};
+  /// Probability that a droid frame never arrives.
+  float loss{0.0f};
+  /// Largest notification payload; frames are split into pieces of at most this size.
+  size_t fragment{20};
+  /// Split frames at random points (1..fragment bytes) instead of filling each notification.
+  bool random_fragments{false};
+  /// ATT MTU the droid accepts.
+  uint16_t mtu{23};
+  /// Time until the stack reports a write without response as done.
+  uint32_t write_cmd_delay{2};
+  int8_t rssi{-60};
+};
+
+/// Drives components, timers and simulated BLE links on the host clock.
+///
+/// Each step() is one pass of the ESPHome main loop: due timers, then the link (connects,
+/// disconnects, GATT events and notifications), then the loop() of every component whose loop is
+/// enabled. Time advances by `loop_interval` between passes.
+class Simulator : public BleBackend {
+ public:
+  explicit Simulator(uint32_t seed = 1);
+  ~Simulator() override;
+
+  /// Adds a droid behind `client`. The client is registered as a component; returns the link index.
+  size_t add_link(esphome::ble_client::BLEClient *client, VirtualBB8 *droid, const LinkConfig &config = {});
+  void add_component(esphome::Component *component);
+  /// Calls setup() on every component, highest setup priority first.
+  void setup();
+
+  void step();
+  void run_for(uint32_t ms);
+  /// Steps until `condition` holds; false if it still does not after `timeout_ms`.
+  bool run_until(const std::function<bool()> &condition, uint32_t timeout_ms);
+
+  /// The droid drops the connection, as on a link loss.
+  void drop_link(size_t link);
+  bool is_connected(size_t link) const;
+  LinkConfig &config(size_t link) { return this->links_[link].config; }
+  /// Time of the last CONNECT_EVT on the link.
+  uint32_t get_connected_at(size_t link) const { return this->links_[link].connected_at; }
+
+  /// Called around every call into component code, e.g. to count allocations made by it alone.
+  /// The guard is lifted while the simulator handles the component's BLE calls.
+  void set_component_guard(std::function<void(bool)> guard) { this->guard_ = std::move(guard); }
+
+  uint32_t loop_interval{16};
+  uint32_t loop_passes{0};
+  uint32_t events_delivered{0};
+  uint32_t notifications_delivered{0};
+  uint32_t frames_lost{0};
+
+  // BleBackend
+  esp_err_t write_char(uint16_t conn_id, uint16_t handle, const uint8_t *data, size_t len,
+                       bool with_response) override;
+  esp_err_t register_for_notify(const uint8_t *bda, uint16_t handle) override;
+  esp_err_t send_mtu_req(uint16_t conn_id) override;
+  esp_err_t read_rssi(const uint8_t *bda) override;
+  esp_err_t cache_clean(const uint8_t *bda) override;
+  esp_gatt_status_t get_db(uint16_t conn_id, uint16_t start_handle, uint16_t end_handle, esp_gattc_db_elem_t *db,
+                           uint16_t *count) override;
+
+  uint32_t cache_cleans{0};
+
+ protected:
+  enum LinkState { LINK_IDLE, LINK_CONNECTING, LINK_DISCOVERING, LINK_CONNECTED };
+
+  struct Link {
+    esphome::ble_client::BLEClient *client;
+    VirtualBB8 *droid;
+    LinkConfig config;
+    LinkState state;
+    uint32_t state_at;
+    uint32_t connected_at;
+    uint16_t conn_id;
+    /// Arrival time of the last thing queued on the link, to keep jittered events in order.
+    uint32_t last_arrival;
+  };
+
+  struct Event {
+    uint32_t at;
+    uint64_t order;
+    size_t link;
+    bool gap;
+    esp_gattc_cb_event_t event;
+    esp_gap_ble_cb_event_t gap_event;
+    esp_ble_gattc_cb_param_t param;
+    esp_ble_gap_cb_param_t gap_param;
+    std::vector<uint8_t> value;
+  };
+
+  Link *find_link_(uint16_t conn_id);
+  Link *find_link_(const uint8_t *bda);
+  size_t index_of_(const Link *link) const;
+  uint32_t arrival_(Link &link, uint32_t delay);
+  void queue_event_(size_t link, uint32_t at, esp_gattc_cb_event_t event, const esp_ble_gattc_cb_param_t &param,
+                    std::vector<uint8_t> value = {});
+  void queue_frames_(size_t link, uint32_t delay);
+  void update_link_(size_t index);
+  void disconnect_(size_t index);
+  void deliver_events_();
+  void call_component_(const std::function<void()> &call);
+
+  /// Lifts the component guard while a BleBackend call from component code runs simulator code.
+  class BackendScope {
+   public:
+    explicit BackendScope(Simulator *sim) : sim_(sim), suspended_(sim->in_component_ && sim->guard_) {
+      if (this->suspended_)
+        this->sim_->guard_(false);
+    }
+    ~BackendScope() {
+      if (this->suspended_)
+        this->sim_->guard_(true);
+    }
+
+   protected:
+    Simulator *sim_;
+    bool suspended_;
+  };
+
+  std::vector<Link> links_;
+  std::vector<esphome::Component *> components_;
+  std::vector<Event> events_;
+  uint64_t next_order_{0};
+  uint16_t next_conn_id_{0};
+  std::mt19937 rng_;
+  std::function<void(bool)> guard_;
+  bool in_component_{false};
+};
+
+}  // namespace host
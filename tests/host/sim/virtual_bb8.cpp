@@ -0,0 +1,268 @@
+#include "virtual_bb8.h"
+
+#include <cstring>
+
+namespace host {
+
+static const char *const SERVICE_BLE = "22bb746f-2bb0-7554-2d6f-726568705327";
+static const char *const SERVICE_CONTROL = "22bb746f-2ba0-7554-2d6f-726568705327";
+
+const VirtualBB8::Characteristic VirtualBB8::CHARACTERISTICS[] = {
+    {SERVICE_BLE, "22bb746f-2bbd-7554-2d6f-726568705327", HANDLE_ANTI_DOS},
+    {SERVICE_BLE, "22bb746f-2bb2-7554-2d6f-726568705327", HANDLE_TX_POWER},
+    {SERVICE_BLE, "22bb746f-2bbf-7554-2d6f-726568705327", HANDLE_WAKE},
+    {SERVICE_CONTROL, "22bb746f-2ba1-7554-2d6f-726568705327", HANDLE_COMMANDS},
+    {SERVICE_CONTROL, "22bb746f-2ba6-7554-2d6f-726568705327", HANDLE_RESPONSES},
+};
+const size_t VirtualBB8::CHARACTERISTIC_COUNT = sizeof(CHARACTERISTICS) / sizeof(CHARACTERISTICS[0]);
+
+static const uint8_t ANTI_DOS_KEY[] = {'0', '1', '1', 'i', '3'};
+
+// Written independently of the component's encoder, so the two check each other
+static uint8_t checksum(const uint8_t *data, size_t len) {
+  unsigned sum = 0;
+  for (size_t i = 0; i < len; i++)
+    sum += data[i];
+  return static_cast<uint8_t>(~sum);
+}
+
+esp_gatt_status_t VirtualBB8::on_write(uint16_t handle, const uint8_t *data, size_t len, uint32_t now) {
+  this->writes++;
+  switch (handle) {
+    case HANDLE_ANTI_DOS:
+      this->anti_dos_ok = len == sizeof(ANTI_DOS_KEY) && memcmp(data, ANTI_DOS_KEY, len) == 0;
+      return ESP_GATT_OK;
+    case HANDLE_TX_POWER:
+      if (!this->has_tx_power)
+        return ESP_GATT_INVALID_HANDLE;
+      if (len >= 1)
+        this->tx_power = data[0];
+      return ESP_GATT_OK;
+    case HANDLE_WAKE:
+      // The droid only wakes up for a client that passed the anti-DOS check
+      if (this->anti_dos_ok && len >= 1 && data[0] == 0x01) {
+        this->awake = true;
+        this->woken_at = now;
+      }
+      return ESP_GATT_OK;
+    case HANDLE_COMMANDS:
+      break;
+    default:
+      return ESP_GATT_INVALID_HANDLE;
+  }
+
+  // Count the frames of this write before acting on them, so a rejected batch leaves no trace
+  size_t frames_in_write = 0;
+  for (size_t pos = 0; pos + 6 <= len && data[pos] == 0xFF;) {
+    size_t frame_len = 6u + data[pos + 5];
+    if (pos + frame_len > len)
+      break;
+    frames_in_write++;
+    pos += frame_len;
+  }
+  if (frames_in_write > 1) {
+    this->batched_writes++;
+    if (this->reject_batches)
+      return ESP_GATT_ERROR;
+  }
+
+  this->rx_.insert(this->rx_.end(), data, data + len);
+  size_t pos = 0;
+  while (this->rx_.size() - pos >= 6) {
+    const uint8_t *frame = this->rx_.data() + pos;
+    if (frame[0] != 0xFF || (frame[1] != 0xFF && frame[1] != 0xFE)) {
+      pos++;
+      continue;
+    }
+    size_t frame_len = 6u + frame[5];
+    if (frame[5] == 0) {
+      this->bad_frames++;
+      pos++;
+      continue;
+    }
+    if (this->rx_.size() - pos < frame_len)
+      break;
+    if (checksum(frame + 2, frame_len - 3) != frame[frame_len - 1]) {
+      this->bad_frames++;
+      pos++;
+      continue;
+    }
+    this->handle_command_(frame[1], frame[2], frame[3], frame[4], frame + 6, frame[5] - 1u, now);
+    pos += frame_len;
+  }
+  this->rx_.erase(this->rx_.begin(), this->rx_.begin() + pos);
+  return ESP_GATT_OK;
+}
+
+bool VirtualBB8::on_subscribe(uint16_t handle) {
+  if (handle != HANDLE_RESPONSES)
+    return false;
+  this->subscribed = true;
+  this->connections++;
+  return true;
+}
+
+void VirtualBB8::on_disconnect() {
+  this->subscribed = false;
+  this->anti_dos_ok = false;
+  this->awake = false;
+  this->red = this->green = this->blue = 0;
+  this->back_led = 0;
+  this->power_notify = false;
+  this->collision_enabled = false;
+  this->stream_divisor = 0;
+  this->stream_mask = this->stream_mask2 = 0;
+  this->macro_running = false;
+  this->temp_macro.clear();
+  this->rx_.clear();
+}
+
+std::vector<std::vector<uint8_t>> VirtualBB8::take_outbox() {
+  std::vector<std::vector<uint8_t>> out;
+  out.swap(this->outbox_);
+  return out;
+}
+
+void VirtualBB8::handle_command_(uint8_t sop2, uint8_t did, uint8_t cid, uint8_t seq, const uint8_t *data, size_t len,
+                                 uint32_t now) {
+  if (!this->is_ready()) {
+    this->ignored_frames++;
+    return;
+  }
+  this->frames++;
+  this->counts_[(did << 8) | cid]++;
+  if (this->record_commands)
+    this->commands.push_back(DroidCommand{now, did, cid, seq, std::vector<uint8_t>(data, data + len)});
+
+  std::vector<uint8_t> response;
+  if (did == 0x00) {
+    switch (cid) {
+      case 0x02:  // Get Versioning: RECV, MDL, HW, MSA-ver, MSA-rev, BL, BAS, MACRO, API major, API minor
+        response = {0x02, 0x07, 0x01, this->msa_version, this->msa_revision, 0x33, 0x40, 0x04, 0x01, 0x0A};
+        break;
+      case 0x20:  // Get Power State: RecVer, state, voltage, charges, seconds awake
+        response = {0x01, this->power_state, static_cast<uint8_t>(this->voltage >> 8),
+                    static_cast<uint8_t>(this->voltage & 0xFF), 0x00, 0x10, 0x00, 0x3C};
+        break;
+      case 0x21:
+        this->power_notify = len >= 1 && data[0] != 0;
+        break;
+      case 0x22:
+        this->sleeps++;
+        this->awake = false;
+        break;
+      case 0x25:
+        if (len >= 2)
+          this->inactivity_timeout = (data[0] << 8) | data[1];
+        break;
+      default:
+        break;
+    }
+  } else if (did == 0x02) {
+    switch (cid) {
+      case 0x11:
+        if (len >= 13) {
+          this->stream_divisor = (data[0] << 8) | data[1];
+          this->stream_mask = (uint32_t(data[4]) << 24) | (uint32_t(data[5]) << 16) | (data[6] << 8) | data[7];
+          this->stream_mask2 = (uint32_t(data[9]) << 24) | (uint32_t(data[10]) << 16) | (data[11] << 8) | data[12];
+        }
+        break;
+      case 0x12:
+        this->collision_enabled = len >= 1 && data[0] == 0x01;
+        break;
+      case 0x20:
+        if (len >= 3) {
+          this->red = data[0];
+          this->green = data[1];
+          this->blue = data[2];
+        }
+        break;
+      case 0x21:
+        if (len >= 1)
+          this->back_led = data[0];
+        break;
+      case 0x30:
+        if (len >= 3) {
+          this->roll_speed = data[0];
+          this->roll_heading = (data[1] << 8) | data[2];
+        }
+        break;
+      case 0x50:
+        this->macro_running = true;
+        break;
+      case 0x51:
+        this->temp_macro.assign(data, data + len);
+        break;
+      case 0x55:
+        this->macro_running = false;
+        break;
+      default:
+        break;
+    }
+  }
+
+  // SOP2 0xFE asks for no answer
+  if (sop2 != 0xFF || !this->answer_commands)
+    return;
+  if (did == this->error_did && cid == this->error_cid && this->error_count > 0) {
+    this->error_count--;
+    this->respond_(this->error_code, seq, nullptr, 0);
+    return;
+  }
+  this->respond_(0x00, seq, response.data(), response.size());
+}
+
+void VirtualBB8::respond_(uint8_t mrsp, uint8_t seq, const uint8_t *data, size_t len) {
+  std::vector<uint8_t> frame = {0xFF, 0xFF, mrsp, seq, static_cast<uint8_t>(len + 1)};
+  frame.insert(frame.end(), data, data + len);
+  frame.push_back(checksum(frame.data() + 2, frame.size() - 2));
+  this->outbox_.push_back(std::move(frame));
+}
+
+void VirtualBB8::send_async(uint8_t id, const uint8_t *data, size_t len) {
+  uint16_t len_field = static_cast<uint16_t>(len + 1);
+  std::vector<uint8_t> frame = {0xFF, 0xFE, id, static_cast<uint8_t>(len_field >> 8),
+                                static_cast<uint8_t>(len_field & 0xFF)};
+  frame.insert(frame.end(), data, data + len);
+  frame.push_back(checksum(frame.data() + 2, frame.size() - 2));
+  this->outbox_.push_back(std::move(frame));
+}
+
+void VirtualBB8::send_power_notification(uint8_t state) {
+  this->power_state = state;
+  if (this->power_notify)
+    this->send_async(0x01, &state, 1);
+}
+
+void VirtualBB8::send_collision(int16_t x, int16_t y, int16_t z, uint8_t axis, int16_t mag_x, int16_t mag_y,
+                                uint8_t speed, uint32_t timestamp) {
+  if (!this->collision_enabled)
+    return;
+  uint8_t payload[16] = {
+      static_cast<uint8_t>(x >> 8),        static_cast<uint8_t>(x),         static_cast<uint8_t>(y >> 8),
+      static_cast<uint8_t>(y),             static_cast<uint8_t>(z >> 8),    static_cast<uint8_t>(z),
+      axis,                                static_cast<uint8_t>(mag_x >> 8), static_cast<uint8_t>(mag_x),
+      static_cast<uint8_t>(mag_y >> 8),    static_cast<uint8_t>(mag_y),     speed,
+      static_cast<uint8_t>(timestamp >> 24), static_cast<uint8_t>(timestamp >> 16),
+      static_cast<uint8_t>(timestamp >> 8), static_cast<uint8_t>(timestamp),
+  };
+  this->send_async(0x07, payload, sizeof(payload));
+}
+
+void VirtualBB8::send_sensor_sample(const std::vector<int16_t> &values) {
+  if (this->stream_divisor == 0)
+    return;
+  std::vector<uint8_t> payload;
+  for (int16_t value : values) {
+    payload.push_back(static_cast<uint8_t>(value >> 8));
+    payload.push_back(static_cast<uint8_t>(value & 0xFF));
+  }
+  this->send_async(0x03, payload.data(), payload.size());
+}
+
+uint32_t VirtualBB8::count(uint8_t did, uint8_t cid) const {
+  auto it = this->counts_.find((did << 8) | cid);
+  return it == this->counts_.end() ? 0 : it->second;
+}
+
+}  // namespace host
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "esp_gattc_api.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace host {
+
+/// One command frame the droid accepted.
+struct DroidCommand {
+  uint32_t time;
+  uint8_t did;
+  uint8_t cid;
+  uint8_t seq;
+  std::vector<uint8_t> data;
+};
+
+/// Simulated BB-8: the GATT characteristics of the handshake, the command stream with its sync
+/// responses, and async notifications on demand.
+///
+/// Only the droid's behaviour lives here. Latency, loss and fragmentation of the link are applied
+/// by the Simulator to whatever the droid queues in its outbox.
+class VirtualBB8 {
+ public:
+  struct Characteristic {
+    const char *service;
+    const char *uuid;
+    uint16_t handle;
+  };
+  static const Characteristic CHARACTERISTICS[];
+  static const size_t CHARACTERISTIC_COUNT;
+  static const uint16_t HANDLE_ANTI_DOS = 0x002A;
+  static const uint16_t HANDLE_TX_POWER = 0x001C;
+  static const uint16_t HANDLE_WAKE = 0x002F;
+  static const uint16_t HANDLE_COMMANDS = 0x000E;
+  static const uint16_t HANDLE_RESPONSES = 0x0010;
+
+  /// A GATT write from the hub. Returns the status the write completes with.
+  esp_gatt_status_t on_write(uint16_t handle, const uint8_t *data, size_t len, uint32_t now);
+  /// A notification subscription; false for a handle that cannot notify.
+  bool on_subscribe(uint16_t handle);
+  /// The link went away: the droid needs the handshake again and its LEDs go dark.
+  void on_disconnect();
+
+  /// Frames queued for the hub since the last call.
+  std::vector<std::vector<uint8_t>> take_outbox();
+
+  void send_async(uint8_t id, const uint8_t *data, size_t len);
+  void send_power_notification(uint8_t state);
+  /// Collision payload as documented: X, Y, Z, axis, X/Y magnitude, speed and timestamp.
+  void send_collision(int16_t x, int16_t y, int16_t z, uint8_t axis, int16_t mag_x, int16_t mag_y, uint8_t speed,
+                      uint32_t timestamp);
+  /// One data streaming sample with the values of the enabled channels, in stream order.
+  void send_sensor_sample(const std::vector<int16_t> &values);
+
+  /// Commands with this DID/CID that were accepted.
+  uint32_t count(uint8_t did, uint8_t cid) const;
+  bool is_ready() const { return this->subscribed && this->anti_dos_ok && this->awake; }
+
+  // Behaviour
+  bool has_tx_power{true};
+  /// Answer a write that carries more than one frame with a GATT error, as some firmware does.
+  bool reject_batches{false};
+  /// Send sync responses at all; when false every request times out.
+  bool answer_commands{true};
+  /// Answer the next `error_count` commands with this DID/CID with MRSP `error_code` instead of a response.
+  uint8_t error_did{0xFF};
+  uint8_t error_cid{0xFF};
+  uint32_t error_count{0};
+  uint8_t error_code{0x01};
+  /// Keep every accepted command in `commands` (off for long runs).
+  bool record_commands{true};
+  uint8_t power_state{0x02};
+  uint16_t voltage{780};
+  uint8_t msa_version{4};
+  uint8_t msa_revision{69};
+
+  // Observed state
+  bool subscribed{false};
+  bool anti_dos_ok{false};
+  bool awake{false};
+  /// When the wake write arrived, in simulated ms.
+  uint32_t woken_at{0};
+  uint8_t tx_power{0};
+  uint8_t red{0}, green{0}, blue{0};
+  uint8_t back_led{0};
+  bool power_notify{false};
+  uint16_t inactivity_timeout{0};
+  bool collision_enabled{false};
+  uint16_t stream_divisor{0};
+  uint32_t stream_mask{0};
+  uint32_t stream_mask2{0};
+  uint8_t roll_speed{0};
+  uint16_t roll_heading{0};
+  std::vector<uint8_t> temp_macro;
+  bool macro_running{false};
+
+  uint32_t writes{0};
+  uint32_t batched_writes{0};
+  uint32_t frames{0};
+  uint32_t bad_frames{0};
+  uint32_t ignored_frames{0};
+  uint32_t sleeps{0};
+  uint32_t connections{0};
+  std::vector<DroidCommand> commands;
+
+ protected:
+  void handle_command_(uint8_t sop2, uint8_t did, uint8_t cid, uint8_t seq, const uint8_t *data, size_t len,
+                       uint32_t now);
+  void respond_(uint8_t mrsp, uint8_t seq, const uint8_t *data, size_t len);
+  void queue_frame_(uint8_t sop2, uint8_t b2, uint8_t b3, uint16_t len_field, const uint8_t *data, size_t len);
+
+  std::vector<uint8_t> rx_;
+  std::vector<std::vector<uint8_t>> outbox_;
+  std::map<uint16_t, uint32_t> counts_;
+};
+
+}  // namespace host
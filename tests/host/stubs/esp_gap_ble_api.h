@@ -0,0 +1,23 @@
+#pragma once
+
+#include "esp_gattc_api.h"
+
+typedef enum {
+  ESP_BT_STATUS_SUCCESS = 0,
+  ESP_BT_STATUS_FAIL,
+} esp_bt_status_t;
+
+typedef enum {
+  ESP_GAP_BLE_SCAN_RESULT_EVT = 3,
+  ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT = 21,
+} esp_gap_ble_cb_event_t;
+
+typedef union {
+  struct {
+    esp_bt_status_t status;
+    int8_t rssi;
+    esp_bd_addr_t remote_addr;
+  } read_rssi_cmpl;
+} esp_ble_gap_cb_param_t;
+
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr);
@@ -0,0 +1,126 @@
+#pragma once
+
+// Host stand-in for the parts of the ESP-IDF Bluedroid GATT client API the component uses. The
+// calls are forwarded to the simulated link registered with host::set_ble_backend().
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef uint8_t esp_gatt_if_t;
+typedef uint8_t esp_bd_addr_t[6];
+
+typedef enum {
+  ESP_GATTC_REG_EVT = 0,
+  ESP_GATTC_UNREG_EVT = 1,
+  ESP_GATTC_OPEN_EVT = 2,
+  ESP_GATTC_READ_CHAR_EVT = 3,
+  ESP_GATTC_WRITE_CHAR_EVT = 4,
+  ESP_GATTC_CLOSE_EVT = 5,
+  ESP_GATTC_SEARCH_CMPL_EVT = 6,
+  ESP_GATTC_NOTIFY_EVT = 10,
+  ESP_GATTC_CFG_MTU_EVT = 18,
+  ESP_GATTC_REG_FOR_NOTIFY_EVT = 38,
+  ESP_GATTC_CONNECT_EVT = 40,
+  ESP_GATTC_DISCONNECT_EVT = 41,
+} esp_gattc_cb_event_t;
+
+typedef enum {
+  ESP_GATT_OK = 0x00,
+  ESP_GATT_INVALID_HANDLE = 0x01,
+  ESP_GATT_ERROR = 0x85,
+} esp_gatt_status_t;
+
+typedef enum {
+  ESP_GATT_WRITE_TYPE_NO_RSP = 1,
+  ESP_GATT_WRITE_TYPE_RSP,
+} esp_gatt_write_type_t;
+
+typedef enum {
+  ESP_GATT_AUTH_REQ_NONE = 0,
+} esp_gatt_auth_req_t;
+
+typedef struct {
+  uint16_t len;
+  union {
+    uint16_t uuid16;
+    uint32_t uuid32;
+    uint8_t uuid128[16];
+  } uuid;
+} esp_bt_uuid_t;
+
+typedef enum {
+  ESP_GATT_DB_PRIMARY_SERVICE,
+  ESP_GATT_DB_SECONDARY_SERVICE,
+  ESP_GATT_DB_CHARACTERISTIC,
+  ESP_GATT_DB_DESCRIPTOR,
+  ESP_GATT_DB_INCLUDED_SERVICE,
+  ESP_GATT_DB_ALL,
+} esp_gatt_db_attr_type_t;
+
+typedef struct {
+  esp_gatt_db_attr_type_t type;
+  uint16_t attribute_handle;
+  uint16_t start_handle;
+  uint16_t end_handle;
+  uint8_t properties;
+  esp_bt_uuid_t uuid;
+} esp_gattc_db_elem_t;
+
+typedef union {
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    uint16_t mtu;
+  } open;
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+  } connect;
+  struct {
+    int reason;
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+  } disconnect;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    uint16_t handle;
+    uint16_t offset;
+  } write;
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    uint16_t handle;
+    uint16_t value_len;
+    uint8_t *value;
+    bool is_notify;
+  } notify;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t handle;
+  } reg_for_notify;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    uint16_t mtu;
+  } cfg_mtu;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+  } search_cmpl;
+} esp_ble_gattc_cb_param_t;
+
+esp_err_t esp_ble_gattc_write_char(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle, uint16_t value_len,
+                                   uint8_t *value, esp_gatt_write_type_t write_type, esp_gatt_auth_req_t auth_req);
+esp_err_t esp_ble_gattc_register_for_notify(esp_gatt_if_t gattc_if, esp_bd_addr_t server_bda, uint16_t handle);
+esp_err_t esp_ble_gattc_send_mtu_req(esp_gatt_if_t gattc_if, uint16_t conn_id);
+esp_err_t esp_ble_gattc_cache_clean(esp_bd_addr_t remote_bda);
+esp_gatt_status_t esp_ble_gattc_get_db(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t start_handle,
+                                       uint16_t end_handle, esp_gattc_db_elem_t *db, uint16_t *count);
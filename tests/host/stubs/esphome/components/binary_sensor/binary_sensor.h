@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace binary_sensor {
+
+class BinarySensor : public EntityBase {
+ public:
+  void publish_state(bool state) {
+    // Like ESPHome, only changes reach the frontend
+    if (this->has_state_ && state == this->state)
+      return;
+    this->state = state;
+    this->has_state_ = true;
+    this->publish_count_++;
+  }
+  bool has_state() const { return this->has_state_; }
+  uint32_t get_publish_count() const { return this->publish_count_; }
+
+  bool state{false};
+
+ protected:
+  bool has_state_{false};
+  uint32_t publish_count_{0};
+};
+
+}  // namespace binary_sensor
+}  // namespace esphome
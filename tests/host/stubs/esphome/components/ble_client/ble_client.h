@@ -0,0 +1,85 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/components/esp32_ble_tracker/esp32_ble_tracker.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gattc_api.h"
+
+#include <vector>
+
+namespace esphome {
+namespace ble_client {
+
+namespace espbt = esphome::esp32_ble_tracker;
+
+class BLEClient;
+
+class BLECharacteristic {
+ public:
+  espbt::ESPBTUUID service;
+  espbt::ESPBTUUID uuid;
+  uint16_t handle{0};
+};
+
+class BLEClientNode {
+ public:
+  virtual ~BLEClientNode() = default;
+  virtual void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
+                                   esp_ble_gattc_cb_param_t *param) = 0;
+  virtual void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {}
+  virtual void loop() {}
+
+  BLEClient *parent() { return this->parent_; }
+  void set_ble_client_parent(BLEClient *parent) { this->parent_ = parent; }
+
+ protected:
+  BLEClient *parent_{nullptr};
+};
+
+/// Host stand-in for ESPHome's BLE client. The simulator owns the connection: it reads
+/// `enabled`/auto-connect to decide when to connect, fills in the discovered characteristics and
+/// delivers GATT events through gattc_event_handler(), which forwards them to the nodes.
+class BLEClient : public Component {
+ public:
+  void register_ble_node(BLEClientNode *node) {
+    node->set_ble_client_parent(this);
+    this->nodes_.push_back(node);
+  }
+
+  void set_address(uint64_t address);
+  uint64_t get_address() const { return this->address_; }
+  const char *address_str() const { return this->address_str_; }
+  uint8_t *get_remote_bda() { return this->remote_bda_; }
+
+  void set_enabled(bool enabled) { this->enabled = enabled; }
+  void set_auto_connect(bool auto_connect) { this->auto_connect_ = auto_connect; }
+  bool get_auto_connect() const { return this->auto_connect_; }
+  bool connected() const { return this->connected_; }
+  esp_gatt_if_t get_gattc_if() const { return 3; }
+  uint16_t get_conn_id() const { return this->conn_id_; }
+
+  BLECharacteristic *get_characteristic(espbt::ESPBTUUID service, espbt::ESPBTUUID chr);
+
+  void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
+  void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+  /// Host only: connection state and service discovery results, set by the simulator.
+  void host_set_connection(bool connected, uint16_t conn_id);
+  void host_add_characteristic(const espbt::ESPBTUUID &service, const espbt::ESPBTUUID &uuid, uint16_t handle);
+  void host_clear_characteristics() { this->characteristics_.clear(); }
+
+  bool enabled{true};
+
+ protected:
+  std::vector<BLEClientNode *> nodes_;
+  std::vector<BLECharacteristic> characteristics_;
+  uint64_t address_{0};
+  char address_str_[18]{};
+  esp_bd_addr_t remote_bda_{};
+  bool auto_connect_{true};
+  bool connected_{false};
+  uint16_t conn_id_{0};
+};
+
+}  // namespace ble_client
+}  // namespace esphome
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esp_gattc_api.h"
+
+#include <string>
+
+namespace esphome {
+namespace esp32_ble_tracker {
+
+class ESPBTUUID {
+ public:
+  static ESPBTUUID from_uint16(uint16_t uuid);
+  /// Parses "0000180a-0000-1000-8000-00805f9b34fb" style 128-bit UUIDs.
+  static ESPBTUUID from_raw(const std::string &data);
+  static ESPBTUUID from_raw(const char *data) { return from_raw(std::string(data)); }
+  static ESPBTUUID from_uuid(esp_bt_uuid_t uuid);
+
+  esp_bt_uuid_t get_uuid() const { return this->uuid_; }
+  bool operator==(const ESPBTUUID &other) const;
+  bool operator!=(const ESPBTUUID &other) const { return !(*this == other); }
+
+ protected:
+  esp_bt_uuid_t uuid_{};
+};
+
+}  // namespace esp32_ble_tracker
+}  // namespace esphome
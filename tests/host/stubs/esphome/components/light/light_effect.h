@@ -0,0 +1,32 @@
+#pragma once
+
+#include "light_output.h"
+
+#include <string>
+
+namespace esphome {
+namespace light {
+
+class LightEffect {
+ public:
+  explicit LightEffect(const std::string &name) : name_(name) {}
+  virtual ~LightEffect() = default;
+
+  virtual void start() {}
+  virtual void stop() {}
+  virtual void apply() = 0;
+  virtual void init() {}
+
+  const std::string &get_name() const { return this->name_; }
+  void init_internal(LightState *state) {
+    this->state_ = state;
+    this->init();
+  }
+
+ protected:
+  LightState *state_{nullptr};
+  std::string name_;
+};
+
+}  // namespace light
+}  // namespace esphome
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "esphome/core/component.h"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace light {
+
+enum class ColorMode : uint8_t {
+  UNKNOWN,
+  ON_OFF,
+  BRIGHTNESS,
+  RGB,
+};
+
+class LightTraits {
+ public:
+  void set_supported_color_modes(std::set<ColorMode> modes) { this->modes_ = std::move(modes); }
+  const std::set<ColorMode> &get_supported_color_modes() const { return this->modes_; }
+
+ protected:
+  std::set<ColorMode> modes_;
+};
+
+class LightColorValues {
+ public:
+  float get_state() const { return this->state_; }
+  float get_brightness() const { return this->brightness_; }
+  float get_red() const { return this->red_; }
+  float get_green() const { return this->green_; }
+  float get_blue() const { return this->blue_; }
+  void set_state(float state) { this->state_ = state; }
+  void set_brightness(float brightness) { this->brightness_ = brightness; }
+  void set_red(float red) { this->red_ = red; }
+  void set_green(float green) { this->green_ = green; }
+  void set_blue(float blue) { this->blue_ = blue; }
+
+  /// Linear blend from `start` to `end`, as the default transition does.
+  static LightColorValues lerp(const LightColorValues &start, const LightColorValues &end, float completion);
+
+ protected:
+  float state_{0.0f};
+  float brightness_{1.0f};
+  float red_{1.0f};
+  float green_{1.0f};
+  float blue_{1.0f};
+};
+
+class LightState;
+class LightEffect;
+
+class LightCall {
+ public:
+  explicit LightCall(LightState *parent) : parent_(parent) {}
+  LightCall &set_state(bool state);
+  LightCall &set_brightness(float brightness);
+  LightCall &set_rgb(float red, float green, float blue);
+  LightCall &set_transition_length(uint32_t transition_length);
+  /// Starts the named effect, or stops the running one for "None".
+  LightCall &set_effect(const std::string &effect);
+  void perform();
+
+ protected:
+  LightState *parent_;
+  bool has_state_{false};
+  bool state_{false};
+  bool has_brightness_{false};
+  float brightness_{1.0f};
+  bool has_rgb_{false};
+  float red_{1.0f}, green_{1.0f}, blue_{1.0f};
+  uint32_t transition_length_{0};
+  bool has_effect_{false};
+  std::string effect_;
+};
+
+class LightOutput {
+ public:
+  virtual ~LightOutput() = default;
+  virtual LightTraits get_traits() = 0;
+  virtual void setup_state(LightState *state) {}
+  virtual void write_state(LightState *state) = 0;
+};
+
+/// Host stand-in for ESPHome's LightState: holds remote (target) and current values, runs the
+/// linear transition and the active effect from loop(), and writes the output like the real one.
+class LightState : public Component {
+ public:
+  explicit LightState(LightOutput *output) : output_(output) {}
+
+  void setup() override;
+  void loop() override;
+
+  LightOutput *get_output() const { return this->output_; }
+  LightCall make_call() { return LightCall(this); }
+  bool is_transformer_active() const { return this->transition_length_ != 0; }
+  void add_effect(LightEffect *effect) { this->effects_.push_back(effect); }
+  LightEffect *get_active_effect() const { return this->active_effect_; }
+
+  LightColorValues remote_values;
+  LightColorValues current_values;
+
+ protected:
+  friend class LightCall;
+
+  void start_transition_(const LightColorValues &target, uint32_t length);
+  void start_effect_(LightEffect *effect);
+  void stop_effect_();
+
+  LightOutput *output_;
+  LightColorValues transition_start_;
+  uint32_t transition_started_{0};
+  uint32_t transition_length_{0};
+  bool next_write_{false};
+  std::vector<LightEffect *> effects_;
+  LightEffect *active_effect_{nullptr};
+};
+
+}  // namespace light
+}  // namespace esphome
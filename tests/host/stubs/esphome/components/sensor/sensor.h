@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esphome/core/component.h"
+
+#include <cmath>
+
+namespace esphome {
+namespace sensor {
+
+class Sensor : public EntityBase {
+ public:
+  void publish_state(float state) {
+    this->state = state;
+    this->has_state_ = true;
+    this->publish_count_++;
+  }
+  bool has_state() const { return this->has_state_; }
+  /// Host only: number of publish_state() calls.
+  uint32_t get_publish_count() const { return this->publish_count_; }
+
+  float state{NAN};
+
+ protected:
+  bool has_state_{false};
+  uint32_t publish_count_{0};
+};
+
+}  // namespace sensor
+}  // namespace esphome
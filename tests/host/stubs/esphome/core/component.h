@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace esphome {
+
+namespace setup_priority {
+extern const float BUS;
+extern const float DATA;
+extern const float AFTER_BLUETOOTH;
+extern const float HARDWARE;
+}  // namespace setup_priority
+
+/// Host stand-in for ESPHome's Component. Timers are kept by the host runtime and run from
+/// host::run_timers(); the loop flag is honoured by the simulator.
+class Component {
+ public:
+  virtual ~Component();
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const { return setup_priority::DATA; }
+
+  void set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f);
+  void set_timeout(uint32_t timeout, std::function<void()> &&f);
+  bool cancel_timeout(const std::string &name);
+  void set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f);
+  void set_interval(uint32_t interval, std::function<void()> &&f);
+  bool cancel_interval(const std::string &name);
+
+  void disable_loop() { this->loop_enabled_ = false; }
+  void enable_loop() { this->loop_enabled_ = true; }
+  void enable_loop_soon_any_context() { this->loop_enabled_ = true; }
+  bool is_loop_enabled() const { return this->loop_enabled_; }
+
+  void status_set_warning() { this->warning_ = true; }
+  void status_clear_warning() { this->warning_ = false; }
+  bool status_has_warning() const { return this->warning_; }
+
+ protected:
+  bool loop_enabled_{true};
+  bool warning_{false};
+};
+
+class PollingComponent : public Component {
+ public:
+  virtual void update() = 0;
+  void set_update_interval(uint32_t interval) { this->update_interval_ = interval; }
+
+ protected:
+  uint32_t update_interval_{60000};
+};
+
+class EntityBase {
+ public:
+  void set_name(const char *name) { this->name_ = name; }
+  const char *get_name() const { return this->name_; }
+
+ protected:
+  const char *name_{""};
+};
+
+}  // namespace esphome
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+
+uint32_t fnv1_hash(const std::string &str);
+std::string format_hex_pretty(const uint8_t *data, size_t length);
+
+template<typename T> T clamp(T value, T min, T max) {
+  if (value < min)
+    return min;
+  if (value > max)
+    return max;
+  return value;
+}
+
+}  // namespace esphome
@@ -0,0 +1,42 @@
+#pragma once
+
+// Host stand-in for ESPHome's logger. As on the device, levels above ESPHOME_LOG_LEVEL are
+// compiled out; the rest are filtered at runtime by host::set_log_level().
+
+#define ESPHOME_LOG_LEVEL_NONE 0
+#define ESPHOME_LOG_LEVEL_ERROR 1
+#define ESPHOME_LOG_LEVEL_WARN 2
+#define ESPHOME_LOG_LEVEL_INFO 3
+#define ESPHOME_LOG_LEVEL_CONFIG 4
+#define ESPHOME_LOG_LEVEL_DEBUG 5
+#define ESPHOME_LOG_LEVEL_VERBOSE 6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+
+#ifndef ESPHOME_LOG_LEVEL
+#define ESPHOME_LOG_LEVEL ESPHOME_LOG_LEVEL_DEBUG
+#endif
+
+namespace esphome {
+void host_log(int level, const char *tag, int line, const char *format, ...) __attribute__((format(printf, 4, 5)));
+}  // namespace esphome
+
+#define ESPHOME_HOST_LOG(level, tag, format, ...) ::esphome::host_log(level, tag, __LINE__, format, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESPHOME_HOST_LOG(ESPHOME_LOG_LEVEL_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESPHOME_HOST_LOG(ESPHOME_LOG_LEVEL_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESPHOME_HOST_LOG(ESPHOME_LOG_LEVEL_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGCONFIG(tag, format, ...) ESPHOME_HOST_LOG(ESPHOME_LOG_LEVEL_CONFIG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESPHOME_HOST_LOG(ESPHOME_LOG_LEVEL_DEBUG, tag, format, ##__VA_ARGS__)
+
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERBOSE
+#define ESP_LOGV(tag, format, ...) ESPHOME_HOST_LOG(ESPHOME_LOG_LEVEL_VERBOSE, tag, format, ##__VA_ARGS__)
+#else
+#define ESP_LOGV(tag, format, ...) \
+  do { \
+  } while (0)
+#endif
+
+#define LOG_SENSOR(prefix, type, obj) (void) (obj)
+#define LOG_TEXT_SENSOR(prefix, type, obj) (void) (obj)
+#define LOG_BINARY_SENSOR(prefix, type, obj) (void) (obj)
+#define LOG_UPDATE_INTERVAL(obj) (void) (obj)
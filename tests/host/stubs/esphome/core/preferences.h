@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+
+/// In-memory stand-in for a flash/RTC preference slot.
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  ESPPreferenceObject(uint32_t type, size_t size) : type_(type), size_(size) {}
+
+  template<typename T> bool save(const T *src) { return this->save_(src, sizeof(T)); }
+  template<typename T> bool load(T *dest) { return this->load_(dest, sizeof(T)); }
+
+ protected:
+  bool save_(const void *data, size_t len);
+  bool load_(void *data, size_t len);
+
+  uint32_t type_{0};
+  size_t size_{0};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type, bool in_flash = false) {
+    return ESPPreferenceObject(type, sizeof(T));
+  }
+  bool sync() { return true; }
+  /// Forgets everything saved, as after erasing flash.
+  void reset();
+};
+
+extern ESPPreferences *global_preferences;
+
+}  // namespace esphome
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "esp_gap_ble_api.h"
+#include "esp_gattc_api.h"
+
+namespace host {
+
+/// Receives the GATT client calls made through the ESP-IDF shims, routed by connection ID.
+/// The simulator implements it for its virtual droids.
+class BleBackend {
+ public:
+  virtual ~BleBackend() = default;
+  virtual esp_err_t write_char(uint16_t conn_id, uint16_t handle, const uint8_t *data, size_t len,
+                               bool with_response) = 0;
+  virtual esp_err_t register_for_notify(const uint8_t *bda, uint16_t handle) = 0;
+  virtual esp_err_t send_mtu_req(uint16_t conn_id) = 0;
+  virtual esp_err_t read_rssi(const uint8_t *bda) = 0;
+  virtual esp_err_t cache_clean(const uint8_t *bda) = 0;
+  virtual esp_gatt_status_t get_db(uint16_t conn_id, uint16_t start_handle, uint16_t end_handle,
+                                   esp_gattc_db_elem_t *db, uint16_t *count) = 0;
+};
+
+/// Without a backend every call fails with ESP_ERR_INVALID_STATE, like a stack that is not up.
+void set_ble_backend(BleBackend *backend);
+
+}  // namespace host
@@ -0,0 +1,488 @@
+// Implementations behind the host stand-in headers: clock, timers, logger, preferences, UUIDs,
+// the BLE client and the ESP-IDF GATT shims, and the light state.
+
+#include "host_ble.h"
+#include "host_runtime.h"
+
+#include "esphome/components/ble_client/ble_client.h"
+#include "esphome/components/light/light_effect.h"
+#include "esphome/components/light/light_output.h"
+#include "esphome/core/component.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace esphome {
+
+namespace setup_priority {
+const float BUS = 1000.0f;
+const float HARDWARE = 800.0f;
+const float DATA = 600.0f;
+const float AFTER_BLUETOOTH = 300.0f;
+}  // namespace setup_priority
+
+// ---- Clock ----
+
+static uint32_t current_time = 0;
+
+uint32_t millis() { return current_time; }
+uint32_t micros() { return current_time * 1000u; }
+void delay(uint32_t ms) { current_time += ms; }
+
+// ---- Logger ----
+
+static int parse_log_level() {
+  const char *env = getenv("SPHERO_LOG");
+  if (env == nullptr)
+    return ESPHOME_LOG_LEVEL_WARN;
+  static const char *const NAMES[] = {"none", "error", "warn", "info", "config", "debug", "verbose", "very_verbose"};
+  for (int i = 0; i < 8; i++) {
+    if (strcmp(env, NAMES[i]) == 0)
+      return i;
+  }
+  return ESPHOME_LOG_LEVEL_WARN;
+}
+
+static int log_level = parse_log_level();
+
+void host_log(int level, const char *tag, int line, const char *format, ...) {
+  if (level > log_level)
+    return;
+  static const char LETTERS[] = "-EWICDVV";
+  printf("%7u [%c][%s:%d]: ", (unsigned) current_time, LETTERS[level], tag, line);
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  printf("\n");
+}
+
+// ---- Timers ----
+
+namespace {
+
+struct Timer {
+  Component *component;
+  std::string name;
+  uint32_t next;
+  uint32_t interval;
+  bool repeat;
+  bool removed;
+  std::function<void()> callback;
+};
+
+std::list<Timer> timers;
+
+bool cancel_timer(Component *component, const std::string &name, bool repeat) {
+  bool found = false;
+  for (auto &timer : timers) {
+    if (!timer.removed && timer.component == component && timer.repeat == repeat && timer.name == name) {
+      timer.removed = true;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void add_timer(Component *component, const std::string &name, uint32_t delay, bool repeat,
+               std::function<void()> &&callback) {
+  if (!name.empty())
+    cancel_timer(component, name, repeat);
+  timers.push_back(Timer{component, name, current_time + delay, delay, repeat, false, std::move(callback)});
+}
+
+}  // namespace
+
+Component::~Component() {
+  for (auto &timer : timers) {
+    if (timer.component == this)
+      timer.removed = true;
+  }
+}
+
+void Component::set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f) {
+  add_timer(this, name, timeout, false, std::move(f));
+}
+void Component::set_timeout(uint32_t timeout, std::function<void()> &&f) {
+  add_timer(this, "", timeout, false, std::move(f));
+}
+bool Component::cancel_timeout(const std::string &name) { return cancel_timer(this, name, false); }
+void Component::set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f) {
+  add_timer(this, name, interval, true, std::move(f));
+}
+void Component::set_interval(uint32_t interval, std::function<void()> &&f) {
+  add_timer(this, "", interval, true, std::move(f));
+}
+bool Component::cancel_interval(const std::string &name) { return cancel_timer(this, name, true); }
+
+// ---- Helpers ----
+
+uint32_t fnv1_hash(const std::string &str) {
+  uint32_t hash = 2166136261UL;
+  for (char c : str) {
+    hash *= 16777619UL;
+    hash ^= static_cast<uint8_t>(c);
+  }
+  return hash;
+}
+
+std::string format_hex_pretty(const uint8_t *data, size_t length) {
+  std::string out;
+  char byte[4];
+  for (size_t i = 0; i < length; i++) {
+    snprintf(byte, sizeof(byte), i == 0 ? "%02X" : ".%02X", data[i]);
+    out += byte;
+  }
+  return out;
+}
+
+// ---- Preferences ----
+
+static std::map<uint32_t, std::vector<uint8_t>> &preference_store() {
+  static std::map<uint32_t, std::vector<uint8_t>> store;
+  return store;
+}
+
+bool ESPPreferenceObject::save_(const void *data, size_t len) {
+  auto *bytes = static_cast<const uint8_t *>(data);
+  preference_store()[this->type_].assign(bytes, bytes + len);
+  return true;
+}
+
+bool ESPPreferenceObject::load_(void *data, size_t len) {
+  auto it = preference_store().find(this->type_);
+  if (it == preference_store().end() || it->second.size() != len)
+    return false;
+  memcpy(data, it->second.data(), len);
+  return true;
+}
+
+void ESPPreferences::reset() { preference_store().clear(); }
+
+static ESPPreferences host_preferences;
+ESPPreferences *global_preferences = &host_preferences;
+
+// ---- UUIDs ----
+
+namespace esp32_ble_tracker {
+
+ESPBTUUID ESPBTUUID::from_uint16(uint16_t uuid) {
+  ESPBTUUID ret;
+  ret.uuid_.len = 2;
+  ret.uuid_.uuid.uuid16 = uuid;
+  return ret;
+}
+
+ESPBTUUID ESPBTUUID::from_raw(const std::string &data) {
+  ESPBTUUID ret;
+  ret.uuid_.len = 16;
+  // The stack keeps 128-bit UUIDs little endian, so the last hex pair is byte 0
+  size_t index = 0;
+  for (size_t i = data.size(); i >= 2 && index < 16;) {
+    if (data[i - 1] == '-') {
+      i--;
+      continue;
+    }
+    ret.uuid_.uuid.uuid128[index++] = static_cast<uint8_t>(strtoul(data.substr(i - 2, 2).c_str(), nullptr, 16));
+    i -= 2;
+  }
+  return ret;
+}
+
+ESPBTUUID ESPBTUUID::from_uuid(esp_bt_uuid_t uuid) {
+  ESPBTUUID ret;
+  ret.uuid_ = uuid;
+  return ret;
+}
+
+bool ESPBTUUID::operator==(const ESPBTUUID &other) const {
+  if (this->uuid_.len != other.uuid_.len)
+    return false;
+  switch (this->uuid_.len) {
+    case 2:
+      return this->uuid_.uuid.uuid16 == other.uuid_.uuid.uuid16;
+    case 4:
+      return this->uuid_.uuid.uuid32 == other.uuid_.uuid.uuid32;
+    default:
+      return memcmp(this->uuid_.uuid.uuid128, other.uuid_.uuid.uuid128, 16) == 0;
+  }
+}
+
+}  // namespace esp32_ble_tracker
+
+// ---- BLE client ----
+
+namespace ble_client {
+
+void BLEClient::set_address(uint64_t address) {
+  this->address_ = address;
+  for (int i = 0; i < 6; i++)
+    this->remote_bda_[i] = static_cast<uint8_t>(address >> (8 * (5 - i)));
+  snprintf(this->address_str_, sizeof(this->address_str_), "%02X:%02X:%02X:%02X:%02X:%02X", this->remote_bda_[0],
+           this->remote_bda_[1], this->remote_bda_[2], this->remote_bda_[3], this->remote_bda_[4],
+           this->remote_bda_[5]);
+}
+
+BLECharacteristic *BLEClient::get_characteristic(espbt::ESPBTUUID service, espbt::ESPBTUUID chr) {
+  for (auto &characteristic : this->characteristics_) {
+    if (characteristic.service == service && characteristic.uuid == chr)
+      return &characteristic;
+  }
+  return nullptr;
+}
+
+void BLEClient::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
+                                    esp_ble_gattc_cb_param_t *param) {
+  for (auto *node : this->nodes_)
+    node->gattc_event_handler(event, gattc_if, param);
+}
+
+void BLEClient::gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+  for (auto *node : this->nodes_)
+    node->gap_event_handler(event, param);
+}
+
+void BLEClient::host_set_connection(bool connected, uint16_t conn_id) {
+  this->connected_ = connected;
+  this->conn_id_ = conn_id;
+  if (!connected)
+    this->characteristics_.clear();
+}
+
+void BLEClient::host_add_characteristic(const espbt::ESPBTUUID &service, const espbt::ESPBTUUID &uuid,
+                                        uint16_t handle) {
+  BLECharacteristic characteristic;
+  characteristic.service = service;
+  characteristic.uuid = uuid;
+  characteristic.handle = handle;
+  this->characteristics_.push_back(characteristic);
+}
+
+}  // namespace ble_client
+
+// ---- Light ----
+
+namespace light {
+
+LightColorValues LightColorValues::lerp(const LightColorValues &start, const LightColorValues &end,
+                                        float completion) {
+  LightColorValues ret;
+  auto mix = [completion](float a, float b) { return a + (b - a) * completion; };
+  ret.state_ = mix(start.state_, end.state_);
+  ret.brightness_ = mix(start.brightness_, end.brightness_);
+  ret.red_ = mix(start.red_, end.red_);
+  ret.green_ = mix(start.green_, end.green_);
+  ret.blue_ = mix(start.blue_, end.blue_);
+  return ret;
+}
+
+LightCall &LightCall::set_state(bool state) {
+  this->has_state_ = true;
+  this->state_ = state;
+  return *this;
+}
+
+LightCall &LightCall::set_brightness(float brightness) {
+  this->has_brightness_ = true;
+  this->brightness_ = brightness;
+  return *this;
+}
+
+LightCall &LightCall::set_rgb(float red, float green, float blue) {
+  this->has_rgb_ = true;
+  this->red_ = red;
+  this->green_ = green;
+  this->blue_ = blue;
+  return *this;
+}
+
+LightCall &LightCall::set_transition_length(uint32_t transition_length) {
+  this->transition_length_ = transition_length;
+  return *this;
+}
+
+LightCall &LightCall::set_effect(const std::string &effect) {
+  this->has_effect_ = true;
+  this->effect_ = effect;
+  return *this;
+}
+
+void LightCall::perform() {
+  LightState *state = this->parent_;
+  LightColorValues target = state->remote_values;
+  if (this->has_state_)
+    target.set_state(this->state_ ? 1.0f : 0.0f);
+  if (this->has_brightness_)
+    target.set_brightness(this->brightness_);
+  if (this->has_rgb_) {
+    target.set_red(this->red_);
+    target.set_green(this->green_);
+    target.set_blue(this->blue_);
+  }
+
+  if (this->has_effect_ || (this->has_state_ && !this->state_))
+    state->stop_effect_();
+  if (this->has_effect_) {
+    for (auto *effect : state->effects_) {
+      if (effect->get_name() == this->effect_)
+        state->start_effect_(effect);
+    }
+  }
+
+  state->remote_values = target;
+  if (this->transition_length_ > 0) {
+    state->start_transition_(target, this->transition_length_);
+  } else {
+    state->transition_length_ = 0;
+    state->current_values = target;
+    state->output_->write_state(state);
+  }
+}
+
+void LightState::setup() {
+  this->output_->setup_state(this);
+  this->current_values = this->remote_values;
+  this->output_->write_state(this);
+}
+
+void LightState::loop() {
+  if (this->active_effect_ != nullptr)
+    this->active_effect_->apply();
+
+  if (this->transition_length_ != 0) {
+    uint32_t elapsed = millis() - this->transition_started_;
+    if (elapsed >= this->transition_length_) {
+      this->current_values = this->remote_values;
+      this->transition_length_ = 0;
+    } else {
+      float completion = static_cast<float>(elapsed) / this->transition_length_;
+      this->current_values = LightColorValues::lerp(this->transition_start_, this->remote_values, completion);
+    }
+    this->next_write_ = true;
+  }
+  if (this->next_write_) {
+    this->next_write_ = false;
+    this->output_->write_state(this);
+  }
+}
+
+void LightState::start_transition_(const LightColorValues &target, uint32_t length) {
+  this->transition_start_ = this->current_values;
+  this->transition_started_ = millis();
+  this->transition_length_ = length;
+  this->next_write_ = true;
+}
+
+void LightState::start_effect_(LightEffect *effect) {
+  this->active_effect_ = effect;
+  effect->init_internal(this);
+  effect->start();
+}
+
+void LightState::stop_effect_() {
+  if (this->active_effect_ == nullptr)
+    return;
+  LightEffect *effect = this->active_effect_;
+  this->active_effect_ = nullptr;
+  effect->stop();
+}
+
+}  // namespace light
+}  // namespace esphome
+
+// ---- Host runtime ----
+
+namespace host {
+
+void set_time(uint32_t ms) { esphome::current_time = ms; }
+void advance_time(uint32_t ms) { esphome::current_time += ms; }
+
+void run_timers() {
+  using esphome::timers;
+  for (auto it = timers.begin(); it != timers.end();) {
+    if (it->removed) {
+      it = timers.erase(it);
+      continue;
+    }
+    if (static_cast<int32_t>(esphome::current_time - it->next) >= 0) {
+      if (it->repeat) {
+        it->next += it->interval > 0 ? it->interval : 1;
+      } else {
+        // Stays in the list until the next pass, so the callback may replace or cancel it
+        it->removed = true;
+      }
+      it->callback();
+    }
+    ++it;
+  }
+}
+
+void reset_timers() { esphome::timers.clear(); }
+
+bool next_timer(uint32_t &at) {
+  bool found = false;
+  for (const auto &timer : esphome::timers) {
+    if (timer.removed)
+      continue;
+    if (!found || static_cast<int32_t>(timer.next - at) < 0)
+      at = timer.next;
+    found = true;
+  }
+  return found;
+}
+
+void set_log_level(int level) { esphome::log_level = level; }
+int get_log_level() { return esphome::log_level; }
+
+// ---- ESP-IDF shims ----
+
+static BleBackend *backend = nullptr;
+
+void set_ble_backend(BleBackend *ble_backend) { backend = ble_backend; }
+
+}  // namespace host
+
+esp_err_t esp_ble_gattc_write_char(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t handle, uint16_t value_len,
+                                   uint8_t *value, esp_gatt_write_type_t write_type, esp_gatt_auth_req_t auth_req) {
+  if (host::backend == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  return host::backend->write_char(conn_id, handle, value, value_len, write_type == ESP_GATT_WRITE_TYPE_RSP);
+}
+
+esp_err_t esp_ble_gattc_register_for_notify(esp_gatt_if_t gattc_if, esp_bd_addr_t server_bda, uint16_t handle) {
+  if (host::backend == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  return host::backend->register_for_notify(server_bda, handle);
+}
+
+esp_err_t esp_ble_gattc_send_mtu_req(esp_gatt_if_t gattc_if, uint16_t conn_id) {
+  if (host::backend == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  return host::backend->send_mtu_req(conn_id);
+}
+
+esp_err_t esp_ble_gattc_cache_clean(esp_bd_addr_t remote_bda) {
+  if (host::backend == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  return host::backend->cache_clean(remote_bda);
+}
+
+esp_gatt_status_t esp_ble_gattc_get_db(esp_gatt_if_t gattc_if, uint16_t conn_id, uint16_t start_handle,
+                                       uint16_t end_handle, esp_gattc_db_elem_t *db, uint16_t *count) {
+  if (host::backend == nullptr)
+    return ESP_GATT_ERROR;
+  return host::backend->get_db(conn_id, start_handle, end_handle, db, count);
+}
+
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr) {
+  if (host::backend == nullptr)
+    return ESP_ERR_INVALID_STATE;
+  return host::backend->read_rssi(remote_addr);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+class Component;
+}
+
+namespace host {
+
+/// Simulated time behind millis() and micros(); it only moves when a test advances it.
+void set_time(uint32_t ms);
+void advance_time(uint32_t ms);
+
+/// Runs the set_timeout()/set_interval() callbacks that are due at the current time.
+void run_timers();
+/// Drops every pending timer, e.g. between two simulations in one process.
+void reset_timers();
+/// Earliest time a timer is due, or false when none is pending.
+bool next_timer(uint32_t &at);
+
+/// Runtime log filter, one of the ESPHOME_LOG_LEVEL_* values. Defaults to WARN, or to the level
+/// named in the SPHERO_LOG environment variable (e.g. SPHERO_LOG=debug).
+void set_log_level(int level);
+int get_log_level();
+
+}  // namespace host
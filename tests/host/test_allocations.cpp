@@ -0,0 +1,180 @@
+// Once READY the hub must not touch the heap (see "Memory" in DEVELOPMENT.md). malloc() and its
+// relatives are replaced for this binary and count the calls made while the simulator is inside
+// component code; the simulator's own BLE handling is not counted.
+//
+// Set ALLOC_TRACE=1 to print a backtrace for the first few counted allocations.
+
+#include "droid_rig.h"
+#include "host_runtime.h"
+#include "host_test.h"
+
+#include "esphome/core/log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <execinfo.h>
+#include <unistd.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+
+static bool counting = false;
+static bool tracing = false;
+static bool in_trace = false;
+static uint32_t allocations = 0;
+
+static void count_allocation(size_t size) {
+  if (!counting || in_trace)
+    return;
+  allocations++;
+  if (tracing && allocations <= 5) {
+    in_trace = true;
+    void *frames[32];
+    int depth = backtrace(frames, 32);
+    char line[64];
+    int len = snprintf(line, sizeof(line), "allocation %u of %zu bytes:\n", (unsigned) allocations, size);
+    write(STDERR_FILENO, line, len);
+    backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+    in_trace = false;
+  }
+}
+
+extern "C" void *malloc(size_t size) {
+  count_allocation(size);
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  count_allocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  count_allocation(size);
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) {
+  count_allocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size) {
+  count_allocation(size);
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr == nullptr ? ENOMEM : 0;
+}
+
+using namespace host;
+using namespace esphome::sphero_bb8;
+
+TEST(an_hour_in_ready_does_not_allocate) {
+  tracing = getenv("ALLOC_TRACE") != nullptr;
+  if (tracing) {
+    // The first backtrace() loads libgcc, which allocates
+    void *frame;
+    backtrace(&frame, 1);
+  }
+
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  // Every sensor that is published while READY, so each publish path is covered
+  esphome::sensor::Sensor metrics[METRIC_COUNT];
+  for (uint8_t i = 0; i < METRIC_COUNT; i++)
+    rig.hub.set_metric_sensor(static_cast<MetricSensor>(i), &metrics[i]);
+  esphome::sensor::Sensor latency[LATENCY_SENSOR_COUNT];
+  for (uint8_t i = 0; i < LATENCY_SENSOR_COUNT; i++)
+    rig.hub.set_latency_sensor(static_cast<LatencySensor>(i), &latency[i]);
+  esphome::sensor::Sensor loop_time, link_rtt, rssi, pacing, collision_speed, collision_magnitude;
+  esphome::sensor::Sensor yaw, velocity_x, velocity_y, odometry_x, odometry_y, heading, distance;
+  esphome::text_sensor::TextSensor commands_sent;
+  rig.hub.set_loop_time_sensor(&loop_time);
+  rig.hub.set_link_rtt_sensor(&link_rtt);
+  rig.hub.set_rssi_sensor(&rssi);
+  rig.hub.set_pacing_interval_sensor(&pacing);
+  rig.hub.set_collision_speed_sensor(&collision_speed);
+  rig.hub.set_collision_magnitude_sensor(&collision_magnitude);
+  rig.hub.set_commands_sent_sensor(&commands_sent);
+  rig.hub.set_stream_sensor(STREAM_YAW, &yaw);
+  rig.hub.set_stream_sensor(STREAM_VELOCITY_X, &velocity_x);
+  rig.hub.set_stream_sensor(STREAM_VELOCITY_Y, &velocity_y);
+  rig.hub.set_odometry_x_sensor(&odometry_x);
+  rig.hub.set_odometry_y_sensor(&odometry_y);
+  rig.hub.set_odometry_heading_sensor(&heading);
+  rig.hub.set_odometry_distance_sensor(&distance);
+  rig.hub.set_pacing_mode(PACING_MODE_ADAPTIVE);
+  // Pings after 20s without traffic instead of 60s, so the hour has plenty of them
+  rig.hub.set_liveness_interval(20000);
+  sim.set_component_guard([](bool inside) { counting = inside; });
+
+  sim.setup();
+  CHECK(rig.wait_ready());
+  // Settle: the firmware version is published once per connection, a few seconds after READY
+  rig.set_color(1.0f, 0.0f, 0.0f);
+  sim.run_for(10000);
+  uint32_t before = allocations;
+  uint32_t pings = rig.droid.count(0x00, 0x01);
+  uint32_t polls = rig.droid.count(0x00, 0x20);
+  uint32_t rgb = rig.droid.count(0x02, 0x20);
+  uint32_t collisions = rig.collision.get_publish_count();
+  uint32_t samples = yaw.get_publish_count();
+
+  // One hour: a burst of fades in the first 20s of every minute, the tail light toggled every
+  // 30s, a collision every 45s, a power notification every 5 minutes and 20Hz streamed samples
+  uint32_t start = esphome::millis();
+  uint32_t next_fade = start, next_tail = start, next_collision = start, next_power = start, next_sample = start;
+  int colour = 0;
+  bool tail_on = false;
+  while (esphome::millis() - start < 3600000) {
+    uint32_t now = esphome::millis();
+    if (now >= next_fade) {
+      float phase = (colour++ % 7) / 7.0f;
+      rig.set_color(phase, 1.0f - phase, 0.5f, 3000);
+      uint32_t second = (now - start) / 1000 % 60;
+      next_fade += second < 16 ? 4000 : 60000 - second * 1000;
+    }
+    if (now >= next_tail) {
+      tail_on = !tail_on;
+      rig.tail.make_call().set_state(tail_on).set_brightness(0.8f).perform();
+      next_tail += 30000;
+    }
+    if (now >= next_collision) {
+      rig.droid.send_collision(120, -80, 0, 0x01, 300, -150, 90, now);
+      next_collision += 45000;
+    }
+    if (now >= next_power) {
+      rig.droid.send_power_notification(POWER_STATE_OK);
+      next_power += 300000;
+    }
+    if (now >= next_sample) {
+      rig.droid.send_sensor_sample({static_cast<int16_t>(colour * 10 % 360), 120, -40});
+      next_sample += 50;
+    }
+    sim.step();
+  }
+
+  CHECK(rig.hub.is_ready());
+  CHECK(sim.is_connected(rig.link));
+  printf("  an hour in READY: %u pings, %u polls, %u RGB, %u collisions, %u sample publishes, %u allocations\n",
+         (unsigned) (rig.droid.count(0x00, 0x01) - pings), (unsigned) (rig.droid.count(0x00, 0x20) - polls),
+         (unsigned) (rig.droid.count(0x02, 0x20) - rgb), (unsigned) (rig.collision.get_publish_count() - collisions),
+         (unsigned) (yaw.get_publish_count() - samples), (unsigned) (allocations - before));
+  CHECK(rig.droid.count(0x00, 0x01) > pings);
+  CHECK(rig.droid.count(0x00, 0x20) > polls);
+  CHECK(rig.droid.count(0x02, 0x20) > rgb + 1000);
+  CHECK(rig.collision.get_publish_count() > collisions);
+  CHECK(yaw.get_publish_count() > samples);
+  CHECK(odometry_x.get_publish_count() > 0);
+  CHECK(!commands_sent.has_state());
+  CHECK_EQ(allocations - before, 0);
+
+  // Leaving READY publishes the command counts, which allocates; this also shows the hook works
+  sim.drop_link(rig.link);
+  sim.run_for(100);
+  CHECK(commands_sent.has_state());
+  CHECK(allocations > before);
+}
+
+TEST_MAIN()
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Codegen checks for light.py that need no ESPHome install: the esphome package is replaced by
+permissive stand-ins, so only the component's own compile and validation functions run for real.
+
+    python3 tests/host/test_codegen.py [name]
+"""
+
+import os
+import sys
+import types
+
+COMPONENTS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "components")
+
+
+class Anything:
+    """Accepts any call, attribute or decorator use, like the config schema helpers at import time."""
+
+    def __call__(self, *args, **kwargs):
+        return Anything()
+
+    def __getattr__(self, name):
+        return Anything()
+
+
+class Invalid(Exception):
+    def __init__(self, message, path=None):
+        super().__init__(message)
+        self.path = path or []
+
+
+class TimePeriod:
+    def __init__(self, milliseconds=0):
+        self.total_milliseconds = milliseconds
+
+
+def stub(name, **attrs):
+    module = types.ModuleType(name)
+    module.__dict__.update(attrs)
+    module.__getattr__ = lambda attr: attr[len("CONF_") :].lower() if attr.startswith("CONF_") else Anything()
+    sys.modules[name] = module
+    return module
+
+
+esphome = stub("esphome")
+esphome.codegen = stub("esphome.codegen")
+esphome.config_validation = stub("esphome.config_validation", Invalid=Invalid)
+esphome.const = stub("esphome.const")
+esphome.core = stub("esphome.core", TimePeriod=TimePeriod)
+esphome.automation = stub("esphome.automation")
+esphome.components = stub("esphome.components")
+for component in ("light", "ble_client", "esp32", "sensor", "binary_sensor", "text_sensor", "button", "number"):
+    setattr(esphome.components, component, stub(f"esphome.components.{component}"))
+stub("esphome.components.light.effects")
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, COMPONENTS)
+from sphero_bb8 import light  # noqa: E402
+
+FADE = {light.CONF_FADE: {"red": 1.0, "green": 0.0, "blue": 0.0, "duration": TimePeriod(500)}}
+RGB = {light.CONF_RGB: {"red": 0.0, "green": 1.0, "blue": 0.0, "delay": TimePeriod(100)}}
+BACK_LED = {light.CONF_BACK_LED: {"brightness": 1.0, "delay": TimePeriod(100)}}
+
+
+def macro(steps, repeat):
+    return {light.CONF_STEPS: steps, "repeat": repeat}
+
+
+def fits(config):
+    try:
+        light.validate_macro_size(config)
+    except Invalid:
+        return False
+    return True
+
+
+def test_repeat_loop_at_the_size_limit():
+    # 15 fades are 90 bytes; ID, flags, the repeat loop and the end marker make 96
+    config = macro([FADE] * 15, 2)
+    assert len(light.compile_macro(config)[0]) == light.MAX_MACRO_SIZE
+    assert fits(config)
+
+
+def test_repeat_loop_one_byte_over():
+    # 91 bytes of steps make 97 with the repeat loop, which the droid's payload cannot carry
+    steps = [FADE] * 13 + [RGB, RGB, BACK_LED]
+    assert len(light.compile_steps(steps)[0]) == 91
+    config = macro(steps, 2)
+    assert len(light.compile_macro(config)[0]) == light.MAX_MACRO_SIZE + 1
+    assert not fits(config)
+    # `forever` runs in a loop of 255 too
+    assert not fits(macro(steps, 0))
+
+
+def test_single_run_needs_no_repeat_loop():
+    # The same steps run once compile without the loop, to 94 bytes
+    config = macro([FADE] * 13 + [RGB, RGB, BACK_LED], 1)
+    assert len(light.compile_macro(config)[0]) == 94
+    assert fits(config)
+
+
+def test_loop_step_macro_is_not_wrapped_again():
+    # With a loop step the effect repeats the macro itself: ID, flags, 91 bytes of steps and the end
+    # marker fill the payload exactly
+    steps = [{light.CONF_LOOP: {"count": 3, "steps": [FADE] * 14}}, FADE]
+    config = macro(steps, 2)
+    assert len(light.compile_macro(config)[0]) == light.MAX_MACRO_SIZE
+    assert fits(config)
+
+
+def test_oversized_error_points_at_the_steps():
+    try:
+        light.validate_macro_size(macro([FADE] * 16, 2))
+    except Invalid as error:
+        assert error.path == [light.CONF_STEPS]
+        assert "102 bytes" in str(error)
+    else:
+        raise AssertionError("16 fades with a repeat loop were accepted")
+
+
+def main():
+    selected = sys.argv[1] if len(sys.argv) > 1 else ""
+    tests = [(name, fn) for name, fn in globals().items() if name.startswith("test_") and selected in name]
+    failed = 0
+    for name, fn in tests:
+        try:
+            fn()
+            print(f"[ OK ] {name[len('test_') :]}")
+        except AssertionError as error:
+            failed += 1
+            print(f"[FAIL] {name[len('test_') :]} {error}")
+    print(f"{len(tests)} tests, {failed} failed")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
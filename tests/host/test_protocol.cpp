@@ -0,0 +1,89 @@
+// Encoder parity: the fixed-buffer encode_packet() and Command<>::encode() must produce the same
+// bytes as the std::vector encoder they replaced (kept in legacy_encoder.h as it was in send_packet()).
+
+#include "host_test.h"
+#include "legacy_encoder.h"
+
+#include "sphero_bb8_protocol.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace esphome::sphero_bb8;
+
+template<typename Cmd> static bool command_matches(uint8_t seq, const typename Cmd::Payload &payload) {
+  typename Cmd::Packet packet;
+  Cmd::encode(packet, seq, payload);
+  std::vector<uint8_t> data(payload.begin(), payload.end());
+  std::vector<uint8_t> expected = legacy::encode(Cmd::DEVICE_ID, Cmd::COMMAND_ID, seq, data);
+  return std::vector<uint8_t>(packet.begin(), packet.end()) == expected;
+}
+
+template<typename Cmd> static void check_command(const char *name) {
+  uint32_t mismatches = 0;
+  srand(Cmd::COMMAND_ID);
+  for (uint32_t seq = 0; seq < 256; seq++) {
+    typename Cmd::Payload payload;
+    for (auto &b : payload)
+      b = rand() & 0xFF;
+    if (!command_matches<Cmd>(seq, payload))
+      mismatches++;
+  }
+  // All-0xFF payloads push the sum furthest past a byte
+  typename Cmd::Payload ones;
+  ones.fill(0xFF);
+  if (!command_matches<Cmd>(0xFF, ones))
+    mismatches++;
+  if (mismatches != 0)
+    printf("  %s: %u mismatches\n", name, (unsigned) mismatches);
+  CHECK_EQ(mismatches, 0);
+}
+
+TEST(fixed_commands_match_the_vector_encoder) {
+  check_command<CmdPing>("Ping");
+  check_command<CmdGetVersion>("GetVersion");
+  check_command<CmdGetPowerState>("GetPowerState");
+  check_command<CmdSetPowerNotify>("SetPowerNotify");
+  check_command<CmdSleep>("Sleep");
+  check_command<CmdSetInactivityTimeout>("SetInactivityTimeout");
+  check_command<CmdSetSelfLevel>("SetSelfLevel");
+  check_command<CmdSetDataStreaming>("SetDataStreaming");
+  check_command<CmdConfigCollision>("ConfigCollision");
+  check_command<CmdSetRGB>("SetRGB");
+  check_command<CmdSetBackLED>("SetBackLED");
+  check_command<CmdRoll>("Roll");
+  check_command<CmdRunMacro>("RunMacro");
+  check_command<CmdAbortMacro>("AbortMacro");
+}
+
+TEST(encode_packet_matches_the_vector_encoder_for_every_length) {
+  uint8_t out[MAX_PACKET_SIZE];
+  srand(1);
+  for (size_t len = 0; len <= MAX_PAYLOAD_SIZE; len++) {
+    for (int round = 0; round < 64; round++) {
+      uint8_t did = rand() & 0xFF, cid = rand() & 0xFF, seq = rand() & 0xFF;
+      std::vector<uint8_t> data(len);
+      for (auto &b : data)
+        b = rand() & 0xFF;
+      size_t size = encode_packet(out, did, cid, seq, data.data(), data.size());
+      CHECK(std::vector<uint8_t>(out, out + size) == legacy::encode(did, cid, seq, data));
+    }
+  }
+}
+
+TEST(known_frames) {
+  // Set RGB to (255, 0, 0) with SEQ 1, as captured from the Sphero app
+  CmdSetRGB::Packet packet;
+  CmdSetRGB::encode(packet, 0x01, {0xFF, 0x00, 0x00, 0x00});
+  const uint8_t expected[] = {0xFF, 0xFF, 0x02, 0x20, 0x01, 0x05, 0xFF, 0x00, 0x00, 0x00, 0xD8};
+  CHECK(std::equal(packet.begin(), packet.end(), expected));
+
+  CmdPing::Packet ping;
+  CmdPing::encode(ping, 0x00, {});
+  const uint8_t expected_ping[] = {0xFF, 0xFF, 0x00, 0x01, 0x00, 0x01, 0xFD};
+  CHECK(std::equal(ping.begin(), ping.end(), expected_ping));
+}
+
+TEST_MAIN()
@@ -0,0 +1,128 @@
+// RequestTable: matching, expiry and retry of in-flight requests, and what happens when the table
+// fills up with fire-and-forget LED frames whose responses are lost.
+
+#include "host_test.h"
+
+#include "sphero_bb8.h"
+#include "sphero_bb8_requests.h"
+
+using namespace esphome::sphero_bb8;
+
+/// Lends a real timeout handler; the table only checks whether a request has one.
+class PollingHub : public SpheroBB8 {
+ public:
+  static TimeoutHandler timeout_handler() { return &PollingHub::handle_readiness_probe_timeout_; }
+};
+
+static TxRequest led_frame() {
+  TxRequest request{};
+  request.did = 0x02;
+  request.cid = 0x20;
+  request.priority = TX_PRIORITY_LED;
+  return request;
+}
+
+static TxRequest poll() {
+  TxRequest request{};
+  request.did = 0x00;
+  request.cid = 0x20;
+  request.priority = TX_PRIORITY_TELEMETRY;
+  request.on_timeout = PollingHub::timeout_handler();
+  request.retries = TxScheduler::DEFAULT_RETRIES;
+  return request;
+}
+
+TEST(response_completes_its_request) {
+  RequestTable table;
+  CHECK(table.add(7, poll(), 1000));
+  PendingRequest pending;
+  CHECK(!table.complete(8, 1040, pending));
+  CHECK(table.complete(7, 1040, pending));
+  CHECK_EQ(pending.request.cid, 0x20);
+  CHECK(!table.complete(7, 1050, pending));
+  CHECK_EQ(table.get_stats(0).last_ms, 40);
+  CHECK_EQ(table.get_stats(0).responses, 1);
+}
+
+TEST(expired_request_is_retried_until_its_retries_run_out) {
+  RequestTable table;
+  uint32_t now = 0;
+  uint8_t seq = 0;
+  CHECK(table.add(seq++, poll(), now));
+  uint32_t attempts = 1;
+  PendingRequest expired;
+  for (;;) {
+    CHECK(!table.expire(now + RequestTable::DEFAULT_TIMEOUT_MS - 1, expired));
+    now += RequestTable::DEFAULT_TIMEOUT_MS;
+    CHECK(table.expire(now, expired));
+    // What SpheroBB8::retry_request_() does with it
+    if (expired.request.retries == 0)
+      break;
+    expired.request.retries--;
+    CHECK(table.add(seq++, expired.request, now));
+    attempts++;
+  }
+  CHECK_EQ(attempts, 1 + TxScheduler::DEFAULT_RETRIES);
+  CHECK_EQ(table.get_stats(0).timeouts, attempts);
+  // A late answer to the first attempt no longer matches anything
+  CHECK(!table.complete(0, now, expired));
+}
+
+TEST(wrapped_sequence_replaces_the_stale_entry) {
+  RequestTable table;
+  CHECK(table.add(3, poll(), 0));
+  CHECK(table.add(3, led_frame(), 500));
+  PendingRequest pending;
+  CHECK(table.complete(3, 520, pending));
+  CHECK_EQ(pending.request.did, 0x02);
+  CHECK(!table.complete(3, 530, pending));
+}
+
+TEST(lost_led_frames_fill_the_table) {
+  RequestTable table;
+  for (uint8_t seq = 0; seq < RequestTable::CAPACITY; seq++)
+    CHECK(table.add(seq, led_frame(), seq));
+  // Another fire-and-forget frame is simply not tracked
+  CHECK(!table.add(RequestTable::CAPACITY, led_frame(), 100));
+  CHECK_EQ(table.get_evictions(), 0);
+}
+
+TEST(awaited_request_takes_the_oldest_led_slot) {
+  RequestTable table;
+  for (uint8_t seq = 0; seq < RequestTable::CAPACITY; seq++)
+    CHECK(table.add(seq, led_frame(), 10 + seq));
+  CHECK(table.add(100, poll(), 100));
+  CHECK_EQ(table.get_evictions(), 1);
+  PendingRequest pending;
+  // The first LED frame made way; the others and the poll still match
+  CHECK(!table.complete(0, 110, pending));
+  CHECK(table.complete(1, 110, pending));
+  CHECK(table.complete(100, 110, pending));
+  CHECK_EQ(pending.request.did, 0x00);
+
+  // A traced LED frame is awaited too: two take the freed slots, the third the oldest LED slot left
+  TxRequest traced = led_frame();
+  traced.traced_at = 90;
+  CHECK(table.add(101, traced, 120));
+  CHECK(table.add(102, traced, 120));
+  CHECK_EQ(table.get_evictions(), 1);
+  CHECK(table.add(103, traced, 120));
+  CHECK_EQ(table.get_evictions(), 2);
+  CHECK(!table.complete(2, 130, pending));
+  CHECK(table.complete(3, 130, pending));
+}
+
+TEST(table_full_of_awaited_requests_refuses_more) {
+  RequestTable table;
+  for (uint8_t seq = 0; seq < RequestTable::CAPACITY; seq++)
+    CHECK(table.add(seq, poll(), seq));
+  CHECK(!table.add(RequestTable::CAPACITY, poll(), 100));
+  CHECK(!table.add(RequestTable::CAPACITY, led_frame(), 100));
+  // Nothing was dropped to make room
+  PendingRequest pending;
+  for (uint8_t seq = 0; seq < RequestTable::CAPACITY; seq++)
+    CHECK(table.complete(seq, 200, pending));
+  CHECK_EQ(table.get_evictions(), 0);
+}
+
+TEST_MAIN()
@@ -0,0 +1,425 @@
+// Connection lifecycle scenarios against the virtual droid: connect, handshake, READY traffic,
+// notifications, disconnect and reconnect, with and without link faults, and several droids
+// sharing one controller.
+
+#include "droid_rig.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <memory>
+
+using namespace host;
+using esphome::sphero_bb8::POWER_STATE_CHARGING;
+
+TEST(connect_reaches_ready) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+
+  CHECK(rig.wait_ready());
+  CHECK(rig.droid.subscribed);
+  CHECK(rig.droid.anti_dos_ok);
+  CHECK(rig.droid.awake);
+  CHECK_EQ(rig.droid.tx_power, 7);
+  CHECK(rig.status.state == "Ready");
+  CHECK(rig.handshake_time.has_state());
+  CHECK(rig.handshake_time.state < 1000.0f);
+}
+
+TEST(ready_configures_and_polls_the_droid) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+  CHECK(rig.wait_ready());
+  sim.run_for(4000);
+
+  CHECK(rig.droid.power_notify);
+  CHECK(rig.droid.collision_enabled);
+  CHECK_EQ(rig.droid.inactivity_timeout, 600);
+  CHECK(rig.droid.count(0x00, 0x20) >= 1);
+  CHECK(rig.battery.has_state());
+  CHECK(rig.charging.state == "OK");
+  CHECK(rig.version.state == "4.69.0");
+  CHECK_EQ(rig.hub.get_checksum_failures(), 0);
+}
+
+TEST(lights_follow_home_assistant) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+  CHECK(rig.wait_ready());
+
+  rig.set_color(1.0f, 0.0f, 0.5f);
+  rig.tail.make_call().set_state(true).set_brightness(0.5f).perform();
+  sim.run_for(500);
+  CHECK_EQ(rig.droid.red, 255);
+  CHECK_EQ(rig.droid.green, 0);
+  CHECK_EQ(rig.droid.blue, 128);
+  CHECK_EQ(rig.droid.back_led, 128);
+
+  rig.rgb.make_call().set_state(false).perform();
+  sim.run_for(500);
+  CHECK_EQ(rig.droid.red, 0);
+  CHECK_EQ(rig.droid.blue, 0);
+}
+
+TEST(fade_ends_on_the_final_colour) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+  CHECK(rig.wait_ready());
+  uint32_t before = rig.droid.count(0x02, 0x20);
+
+  rig.set_color(0.0f, 0.0f, 1.0f, 2000);
+  sim.run_for(2500);
+  uint32_t sent = rig.droid.count(0x02, 0x20) - before;
+  CHECK_EQ(rig.droid.blue, 255);
+  // Paced at 50ms, with imperceptible steps skipped
+  CHECK(sent >= 5);
+  CHECK(sent <= 45);
+}
+
+TEST(notifications_reach_the_sensors) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+  CHECK(rig.wait_ready());
+  sim.run_for(500);
+
+  rig.droid.send_collision(100, -20, 0, 0x01, 80, 60, 40, 12345);
+  sim.run_for(100);
+  CHECK(rig.collision.state);
+  sim.run_for(1000);
+  CHECK(!rig.collision.state);
+
+  rig.droid.send_power_notification(POWER_STATE_CHARGING);
+  sim.run_for(100);
+  CHECK(rig.charging.state == "Charging");
+}
+
+TEST(disconnect_puts_the_droid_to_sleep) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+  CHECK(rig.wait_ready());
+  rig.set_color(0.0f, 1.0f, 0.0f);
+  sim.run_for(200);
+
+  rig.hub.disconnect();
+  sim.run_for(1000);
+  CHECK_EQ(rig.droid.sleeps, 1);
+  CHECK(!rig.client.connected());
+  CHECK(!rig.hub.is_ready());
+  CHECK(rig.status.state == "Disconnected");
+  CHECK(rig.rgb.remote_values.get_state() == 0.0f);
+  // Nothing to do until a button press or GATT event
+  CHECK(!rig.hub.is_loop_enabled());
+
+  // Stays disconnected
+  sim.run_for(3000);
+  CHECK(!rig.client.connected());
+}
+
+TEST(connect_button_starts_a_disabled_hub) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  rig.hub.set_auto_connect(false);
+  sim.setup();
+  sim.run_for(1000);
+  CHECK(!rig.client.connected());
+  CHECK(rig.status.state == "Disconnected");
+
+  rig.hub.connect();
+  CHECK(rig.wait_ready());
+}
+
+TEST(reconnects_after_link_loss_and_restores_the_leds) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+  CHECK(rig.wait_ready());
+  rig.set_color(1.0f, 0.0f, 0.0f);
+  sim.run_for(300);
+  CHECK_EQ(rig.droid.red, 255);
+
+  sim.drop_link(rig.link);
+  sim.run_for(50);
+  CHECK(!rig.hub.is_ready());
+  CHECK_EQ(rig.droid.red, 0);
+
+  CHECK(rig.wait_ready());
+  CHECK_EQ(rig.droid.connections, 2);
+  // The light shows off in Home Assistant since the link dropped, so the restore keeps it dark
+  sim.run_for(500);
+  CHECK_EQ(rig.rgb.remote_values.get_state(), 0.0f);
+  CHECK_EQ(rig.droid.red, 0);
+
+  // Picking the same colour again relights it
+  rig.set_color(1.0f, 0.0f, 0.0f);
+  sim.run_for(300);
+  CHECK_EQ(rig.droid.red, 255);
+}
+
+TEST(reconnect_is_as_fast_as_the_first_connect) {
+  LinkConfig config;
+  // Writes without response take a while to complete, so some are still pending when the link drops
+  config.write_cmd_delay = 20;
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001, config);
+  sim.setup();
+  CHECK(rig.wait_ready());
+  uint32_t first = esphome::millis() - sim.get_connected_at(rig.link);
+
+  for (int drop = 0; drop < 3; drop++) {
+    // Dropped while the LED and configuration restore is going out, or mid fade
+    if (drop == 2) {
+      rig.set_color(1.0f, 0.0f, 1.0f, 1000);
+      sim.run_for(300);
+    } else {
+      sim.run_for(20);
+    }
+    sim.drop_link(rig.link);
+    CHECK(sim.run_until([&]() { return sim.is_connected(rig.link); }, 5000));
+    CHECK(rig.wait_ready(5000));
+    uint32_t again = esphome::millis() - sim.get_connected_at(rig.link);
+    // Within a couple of connection events of the first handshake, far below the 1s write timeout
+    CHECK(again <= first + 100);
+  }
+  CHECK_EQ(rig.hub.get_metrics().write_timeouts, 0);
+}
+
+TEST(handshake_survives_a_slow_lossy_fragmenting_link) {
+  LinkConfig config;
+  config.latency = 40;
+  config.jitter = 30;
+  config.loss = 0.1f;
+  config.fragment = 5;
+  config.random_fragments = true;
+  Simulator sim(7);
+  DroidRig rig(sim, 0xE8BCE1D6A001, config);
+  sim.setup();
+
+  CHECK(rig.wait_ready(10000));
+  for (int i = 0; i < 20; i++) {
+    rig.set_color(i % 2 ? 1.0f : 0.0f, 0.5f, 0.0f);
+    sim.run_for(150);
+  }
+  rig.set_color(0.0f, 0.0f, 1.0f);
+  sim.run_for(2000);
+  CHECK(rig.hub.is_ready());
+  CHECK_EQ(rig.droid.blue, 255);
+  CHECK(sim.frames_lost > 0);
+  // Split and lost frames only cost resyncs, never a frame that passed a bad checksum
+  CHECK_EQ(rig.droid.bad_frames, 0);
+}
+
+TEST(rejected_batch_is_detected_while_other_writes_complete) {
+  // A busy controller reports writes without response late, so their completions arrive while
+  // the acknowledged batch write is still outstanding
+  LinkConfig config;
+  config.mtu = 185;
+  config.write_cmd_delay = 20;
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001, config);
+  rig.hub.set_batching(true);
+  sim.setup();
+  CHECK(rig.wait_ready());
+  sim.run_for(1000);
+  uint32_t accepted = rig.droid.batched_writes;
+  CHECK(accepted > 0);
+  // e.g. after a firmware update or a reconnect through a proxy
+  rig.droid.reject_batches = true;
+
+  for (int i = 0; i < 20; i++) {
+    // One packet on its own, then two that go out as a batch on the next loop pass
+    rig.set_color(i % 2 ? 1.0f : 0.2f, 0.0f, 0.0f);
+    sim.step();
+    rig.set_color(0.0f, i % 2 ? 1.0f : 0.2f, 0.0f);
+    rig.tail.make_call().set_state(true).set_brightness(i % 2 ? 1.0f : 0.5f).perform();
+    sim.step();
+    sim.run_for(200);
+  }
+  rig.set_color(0.0f, 0.0f, 1.0f);
+  rig.tail.make_call().set_state(true).set_brightness(0.4f).perform();
+  sim.run_for(2000);
+
+  // The droid's rejection turned batching off and the state was sent again, one packet per write
+  CHECK(rig.droid.batched_writes > accepted);
+  CHECK(rig.droid.batched_writes <= accepted + 2);
+  CHECK_EQ(rig.droid.blue, 255);
+  CHECK_EQ(rig.droid.back_led, 102);
+  CHECK(rig.hub.is_ready());
+}
+
+TEST(drive_setpoints_wait_for_ready) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  sim.setup();
+  // A joystick streaming setpoints while the droid connects: refused, without queueing anything
+  for (int i = 0; i < 500 && !rig.hub.is_ready(); i++) {
+    rig.hub.drive(80, 90);
+    sim.step();
+  }
+  CHECK(rig.hub.is_ready());
+  sim.run_for(200);
+  CHECK_EQ(rig.droid.roll_speed, 0);
+
+  rig.hub.drive(80, 90);
+  sim.run_for(200);
+  CHECK_EQ(rig.droid.roll_speed, 80);
+  CHECK_EQ(rig.droid.roll_heading, 90);
+}
+
+TEST(macro_with_a_loop_step_runs_the_repeat_count) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  // `repeat: 3` around a loop step: the droid cannot nest loops, so the effect starts it 3 times
+  esphome::sphero_bb8::SpheroBB8MacroEffect effect("Blink");
+  effect.set_macro({0xFF, 0x00, 0x1E, 0x02, 0x02, 0xFF, 0x00, 0x00, 0xFA, 0x02, 0x00, 0x00, 0x00, 0xFA, 0x1F, 0x00});
+  effect.set_duration(1000);
+  effect.set_runs(3);
+  rig.rgb.add_effect(&effect);
+  sim.setup();
+  CHECK(rig.wait_ready());
+
+  rig.rgb.make_call().set_state(true).set_effect("Blink").perform();
+  sim.run_for(5000);
+  CHECK_EQ(rig.droid.count(0x02, 0x50), 3);
+  CHECK_EQ(rig.droid.count(0x02, 0x51), 1);
+}
+
+/// Four droids on one controller, connected together, each on a link with a 185 byte MTU.
+struct FourDroids {
+  explicit FourDroids(uint32_t airtime_interval) {
+    LinkConfig config;
+    config.mtu = 185;
+    for (uint8_t i = 0; i < 4; i++) {
+      this->rigs[i].reset(new DroidRig(this->sim, 0xE8BCE1D6A001 + i, config));
+      this->rigs[i]->hub.set_airtime_interval(airtime_interval);
+    }
+    this->sim.setup();
+  }
+
+  bool wait_ready() {
+    return this->sim.run_until([this]() {
+      for (auto &rig : this->rigs)
+        if (!rig->hub.is_ready())
+          return false;
+      return true;
+    }, 10000);
+  }
+
+  Simulator sim;
+  std::unique_ptr<DroidRig> rigs[4];
+};
+
+TEST(four_droids_poll_out_of_phase) {
+  FourDroids droids(10);
+  CHECK(droids.wait_ready());
+  droids.sim.run_for(2000);
+
+  // The droids become ready within 50ms of each other, but their first battery polls are spread
+  // out by the stagger. The unstaggered droid's poll waits behind its LED and configuration
+  // restore, so the first gap is shorter than the others.
+  uint32_t polled_at[4];
+  for (uint8_t i = 0; i < 4; i++) {
+    polled_at[i] = 0;
+    for (const auto &command : droids.rigs[i]->droid.commands) {
+      if (command.did == 0x00 && command.cid == 0x20) {
+        polled_at[i] = command.time;
+        break;
+      }
+    }
+    CHECK(polled_at[i] != 0);
+  }
+  std::sort(polled_at, polled_at + 4);
+  for (uint8_t i = 1; i < 4; i++)
+    CHECK(polled_at[i] - polled_at[i - 1] >= 50);
+  CHECK(polled_at[3] - polled_at[0] >= 500);
+}
+
+TEST(four_droids_share_the_radio_evenly) {
+  // Slower than four droids at 50ms want, so the arbiter has to share
+  FourDroids droids(20);
+  CHECK(droids.wait_ready());
+  droids.sim.run_for(2000);
+
+  // Simultaneous fades on all four for 20s
+  uint32_t before[4];
+  for (uint8_t i = 0; i < 4; i++)
+    before[i] = droids.rigs[i]->droid.count(0x02, 0x20);
+  for (int fade = 0; fade < 10; fade++) {
+    for (auto &rig : droids.rigs)
+      rig->set_color(fade % 2 ? 1.0f : 0.0f, 0.5f, fade % 2 ? 0.0f : 1.0f, 2000);
+    droids.sim.run_for(2000);
+  }
+  uint32_t least = UINT32_MAX, most = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    uint32_t sent = droids.rigs[i]->droid.count(0x02, 0x20) - before[i];
+    least = std::min(least, sent);
+    most = std::max(most, sent);
+  }
+  printf("  RGB updates per droid in 20s: %u to %u\n", (unsigned) least, (unsigned) most);
+  CHECK(least >= 100);
+  CHECK(least * 10 >= most * 9);
+}
+
+TEST(droid_without_tx_power_characteristic) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  rig.droid.has_tx_power = false;
+  sim.setup();
+  CHECK(rig.wait_ready());
+  CHECK_EQ(rig.droid.tx_power, 0);
+}
+
+TEST(silent_droid_still_becomes_ready) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  rig.droid.answer_commands = false;
+  sim.setup();
+  // The readiness Ping and its retries time out, then the hub carries on
+  CHECK(rig.wait_ready(6000));
+}
+
+TEST(ping_answered_with_an_error_is_retried) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  rig.droid.error_did = 0x00;
+  rig.droid.error_cid = 0x01;
+  rig.droid.error_count = 1;
+  sim.setup();
+  // The error counts as a failed attempt and the retry goes out at once, without waiting for the deadline
+  CHECK(rig.wait_ready());
+  CHECK_EQ(rig.droid.error_count, 0);
+  CHECK_EQ(rig.droid.count(0x00, 0x01), 2);
+  CHECK(rig.handshake_time.state < 1000.0f);
+}
+
+TEST(ping_always_answered_with_an_error_still_becomes_ready) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  rig.droid.error_did = 0x00;
+  rig.droid.error_cid = 0x01;
+  rig.droid.error_count = 100;
+  sim.setup();
+  // Every attempt fails, so the timeout handler carries on after the retries
+  CHECK(rig.wait_ready());
+  CHECK_EQ(rig.droid.count(0x00, 0x01), 3);
+  CHECK(rig.handshake_time.state < 1000.0f);
+}
+
+TEST(failed_battery_poll_is_retried) {
+  Simulator sim;
+  DroidRig rig(sim, 0xE8BCE1D6A001);
+  rig.droid.error_did = 0x00;
+  rig.droid.error_cid = 0x20;
+  rig.droid.error_count = 1;
+  sim.setup();
+  CHECK(rig.wait_ready());
+  sim.run_for(4000);
+  CHECK_EQ(rig.droid.error_count, 0);
+  CHECK(rig.battery.has_state());
+}
+
+TEST_MAIN()